@@ -0,0 +1,284 @@
+#include "bench.h"
+#include "runtime/atom.h"
+#include "runtime/os/thread.h"
+#include "runtime/os/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ATOM_KEY_SIZE 24
+#define ATOM_BATCH 1000
+#define ATOM_BATCH_WINDOW 64
+#define ATOM_MAX_THREADS 64
+
+typedef struct {
+    lzr_atom_table_t table;
+    char* keys;
+    size_t* key_lens;
+    size_t* order;
+    size_t num_keys;
+    size_t next_key;
+    size_t next_order;
+} atom_ctx_t;
+
+#define ATOM_KEY(ctx, i) (&(ctx)->keys[(i) * ATOM_KEY_SIZE])
+
+// hits and misses go through the keys in a random order so they aren't served by a single cache line
+void atom_find(void* ctx, size_t iters) {
+    atom_ctx_t* self = (atom_ctx_t*) ctx;
+    size_t found = 0;
+    for (size_t i = 0; i < iters; i++) {
+        size_t key = self->order[self->next_order++ % self->num_keys];
+        found += lzr_atom_table_find(&self->table, ATOM_KEY(self, key), self->key_lens[key]) != NULL;
+    }
+    bench_sink(found);
+}
+
+void atom_upsert(void* ctx, size_t iters) {
+    atom_ctx_t* self = (atom_ctx_t*) ctx;
+    size_t found = 0;
+    for (size_t i = 0; i < iters; i++) {
+        size_t key = self->order[self->next_order++ % self->num_keys];
+        found += (size_t) lzr_atom_table_upsert(&self->table, ATOM_KEY(self, key), self->key_lens[key]);
+    }
+    bench_sink(found);
+}
+
+// every upsert inserts a key which was never seen before
+void atom_upsert_new(void* ctx, size_t iters) {
+    atom_ctx_t* self = (atom_ctx_t*) ctx;
+    size_t found = 0;
+    for (size_t i = 0; i < iters; i++) {
+        size_t key = self->next_key++;
+        found += (size_t) lzr_atom_table_upsert(&self->table, ATOM_KEY(self, key), self->key_lens[key]);
+    }
+    bench_sink(found);
+}
+
+// the batched versions go through the same keys as the ones above, a window of them per call.
+// The window's key pointers are gathered in the loop just like the scalar loop looks them up.
+void atom_find_batch(void* ctx, size_t iters) {
+    atom_ctx_t* self = (atom_ctx_t*) ctx;
+    const char* keys[ATOM_BATCH_WINDOW];
+    size_t key_lens[ATOM_BATCH_WINDOW];
+    lzr_atom_t* atoms[ATOM_BATCH_WINDOW];
+    size_t found = 0;
+    for (size_t i = 0; i < iters; i += ATOM_BATCH_WINDOW) {
+        size_t count = iters - i < ATOM_BATCH_WINDOW ? iters - i : ATOM_BATCH_WINDOW;
+        for (size_t j = 0; j < count; j++) {
+            size_t key = self->order[self->next_order++ % self->num_keys];
+            keys[j] = ATOM_KEY(self, key);
+            key_lens[j] = self->key_lens[key];
+        }
+        lzr_atom_table_find_batch(&self->table, keys, key_lens, atoms, count);
+        for (size_t j = 0; j < count; j++)
+            found += atoms[j] != NULL;
+    }
+    bench_sink(found);
+}
+
+void atom_upsert_batch(void* ctx, size_t iters) {
+    atom_ctx_t* self = (atom_ctx_t*) ctx;
+    const char* keys[ATOM_BATCH_WINDOW];
+    size_t key_lens[ATOM_BATCH_WINDOW];
+    lzr_atom_t* atoms[ATOM_BATCH_WINDOW];
+    size_t found = 0;
+    for (size_t i = 0; i < iters; i += ATOM_BATCH_WINDOW) {
+        size_t count = iters - i < ATOM_BATCH_WINDOW ? iters - i : ATOM_BATCH_WINDOW;
+        for (size_t j = 0; j < count; j++) {
+            size_t key = self->order[self->next_order++ % self->num_keys];
+            keys[j] = ATOM_KEY(self, key);
+            key_lens[j] = self->key_lens[key];
+        }
+        lzr_atom_table_upsert_batch(&self->table, keys, key_lens, atoms, count);
+        for (size_t j = 0; j < count; j++)
+            found += (size_t) atoms[j];
+    }
+    bench_sink(found);
+}
+
+void atom_upsert_new_batch(void* ctx, size_t iters) {
+    atom_ctx_t* self = (atom_ctx_t*) ctx;
+    const char* keys[ATOM_BATCH_WINDOW];
+    lzr_atom_t* atoms[ATOM_BATCH_WINDOW];
+    size_t found = 0;
+    for (size_t i = 0; i < iters; i += ATOM_BATCH_WINDOW) {
+        size_t count = iters - i < ATOM_BATCH_WINDOW ? iters - i : ATOM_BATCH_WINDOW;
+        for (size_t j = 0; j < count; j++)
+            keys[j] = ATOM_KEY(self, self->next_key + j);
+        lzr_atom_table_upsert_batch(&self->table, keys, &self->key_lens[self->next_key], atoms, count);
+        self->next_key += count;
+        for (size_t j = 0; j < count; j++)
+            found += (size_t) atoms[j];
+    }
+    bench_sink(found);
+}
+
+typedef struct {
+    lzr_thread_t thread;
+    atom_ctx_t* ctx;
+    uint32_t* ready;
+    size_t num_threads;
+    size_t first;
+    size_t found;
+    double* samples;
+} atom_worker_t;
+
+// every thread finds hits in the same random order but starting at a different spot in it,
+// timing its own batches once all of them are ready to go
+void atom_find_worker(void* arg) {
+    atom_worker_t* worker = (atom_worker_t*) arg;
+    atom_ctx_t* self = worker->ctx;
+
+    __atomic_fetch_add(worker->ready, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(worker->ready, __ATOMIC_ACQUIRE) != worker->num_threads)
+        lzr_cpu_relax();
+
+    size_t next = worker->first;
+    for (size_t sample = 0; sample < bench_samples(); sample++) {
+        uint64_t start = lzr_time_now();
+        for (size_t i = 0; i < ATOM_BATCH; i++) {
+            size_t key = self->order[next++ % self->num_keys];
+            worker->found += lzr_atom_table_find(&self->table, ATOM_KEY(self, key), self->key_lens[key]) != NULL;
+        }
+        worker->samples[sample] = (double) (lzr_time_now() - start) / ATOM_BATCH;
+    }
+}
+
+// 1, 2, 4, ... threads up to one per cpu, returning how many counts there are
+size_t atom_thread_counts(size_t* counts) {
+    size_t max_threads = lzr_thread_cpu_count();
+    if (max_threads > ATOM_MAX_THREADS)
+        max_threads = ATOM_MAX_THREADS;
+
+    size_t num_counts = 0;
+    for (size_t num_threads = 1; num_threads < max_threads; num_threads *= 2)
+        counts[num_counts++] = num_threads;
+    counts[num_counts++] = max_threads;
+    return num_counts;
+}
+
+void atom_find_threads_name(char* name, size_t num_atoms, size_t num_threads) {
+    snprintf(name, 64, "find_hit/atoms=%zu/threads=%zu", num_atoms, num_threads);
+}
+
+// finds never write to the table so the finds per second should scale with the threads
+void atom_find_threads(atom_ctx_t* self, size_t num_atoms, size_t num_threads) {
+    char name[64];
+    atom_find_threads_name(name, num_atoms, num_threads);
+    if (!bench_enabled("atom", name))
+        return;
+
+    static atom_worker_t workers[ATOM_MAX_THREADS];
+    uint32_t ready = 0;
+    size_t count = bench_samples();
+    double* samples = (double*) malloc(num_threads * count * sizeof(double));
+
+    uint64_t start = lzr_time_now();
+    for (size_t i = 0; i < num_threads; i++) {
+        workers[i].ctx = self;
+        workers[i].ready = &ready;
+        workers[i].num_threads = num_threads;
+        workers[i].first = (i * self->num_keys) / num_threads;
+        workers[i].found = 0;
+        workers[i].samples = &samples[i * count];
+        lzr_thread_spawn(&workers[i].thread, atom_find_worker, &workers[i]);
+    }
+
+    size_t found = 0;
+    for (size_t i = 0; i < num_threads; i++) {
+        lzr_thread_join(&workers[i].thread);
+        found += workers[i].found;
+    }
+    double elapsed = (double) (lzr_time_now() - start);
+
+    // ns/op is per thread, per_sec is the finds of all of them together
+    uint64_t ops = (uint64_t) (num_threads * count * ATOM_BATCH);
+    bench_sink(found);
+    bench_report_rate("atom", name, samples, num_threads * count, ops, (double) ops * 1e9 / elapsed);
+    free(samples);
+}
+
+void atom_keys(atom_ctx_t* self, const char* prefix, size_t first, size_t count) {
+    for (size_t i = first; i < first + count; i++)
+        self->key_lens[i] = (size_t) snprintf(ATOM_KEY(self, i), ATOM_KEY_SIZE, "%s_%zu", prefix, i);
+}
+
+// run every benchmark on a table holding `num_atoms` atoms. There's only one atom heap
+// so each table reuses it from the start, leaving the previous table unusable.
+void bench_atom_table(size_t num_atoms) {
+    static atom_ctx_t ctx;
+    char names[7][64];
+    snprintf(names[0], sizeof(names[0]), "find_hit/atoms=%zu", num_atoms);
+    snprintf(names[1], sizeof(names[1]), "upsert_hit/atoms=%zu", num_atoms);
+    snprintf(names[2], sizeof(names[2]), "find_miss/atoms=%zu", num_atoms);
+    snprintf(names[3], sizeof(names[3]), "upsert_miss/atoms=%zu", num_atoms);
+    snprintf(names[4], sizeof(names[4]), "find_hit_batch/atoms=%zu", num_atoms);
+    snprintf(names[5], sizeof(names[5]), "upsert_hit_batch/atoms=%zu", num_atoms);
+    snprintf(names[6], sizeof(names[6]), "upsert_miss_batch/atoms=%zu", num_atoms);
+
+    // filling the bigger tables takes a while so skip it when nothing would use them
+    size_t thread_counts[16];
+    size_t num_thread_counts = atom_thread_counts(thread_counts);
+    bool enabled = false;
+    for (size_t i = 0; i < 7; i++)
+        enabled |= bench_enabled("atom", names[i]);
+    for (size_t i = 0; i < num_thread_counts; i++) {
+        char name[64];
+        atom_find_threads_name(name, num_atoms, thread_counts[i]);
+        enabled |= bench_enabled("atom", name);
+    }
+    if (!enabled)
+        return;
+
+    // new keys for both the scalar and the batched upserts of them
+    const size_t num_new = 2 * ATOM_BATCH * (bench_samples() + 1);
+    const size_t total_keys = (2 * num_atoms) + num_new;
+
+    ctx.keys = (char*) malloc(total_keys * ATOM_KEY_SIZE);
+    ctx.key_lens = (size_t*) malloc(total_keys * sizeof(size_t));
+    ctx.order = (size_t*) malloc(num_atoms * sizeof(size_t));
+    atom_keys(&ctx, "bench_atom", 0, num_atoms);
+    atom_keys(&ctx, "bench_miss", num_atoms, num_atoms);
+    atom_keys(&ctx, "bench_new", 2 * num_atoms, num_new);
+
+    lzr_atom_table_init(&ctx.table, num_atoms + num_new);
+    for (size_t i = 0; i < num_atoms; i++)
+        lzr_atom_table_upsert(&ctx.table, ATOM_KEY(&ctx, i), ctx.key_lens[i]);
+
+    uint64_t seed = 0x2545f4914f6cdd1dULL;
+    for (size_t i = 0; i < num_atoms; i++)
+        ctx.order[i] = i;
+    for (size_t i = num_atoms - 1; i > 0; i--) {
+        size_t j = bench_random(&seed) % (i + 1);
+        size_t swap = ctx.order[i];
+        ctx.order[i] = ctx.order[j];
+        ctx.order[j] = swap;
+    }
+
+    ctx.num_keys = num_atoms;
+    bench_run("atom", names[0], atom_find, &ctx, ATOM_BATCH);
+    bench_run("atom", names[1], atom_upsert, &ctx, ATOM_BATCH);
+    bench_run("atom", names[4], atom_find_batch, &ctx, ATOM_BATCH);
+    bench_run("atom", names[5], atom_upsert_batch, &ctx, ATOM_BATCH);
+    for (size_t i = 0; i < num_thread_counts; i++)
+        atom_find_threads(&ctx, num_atoms, thread_counts[i]);
+
+    // the misses are the same random order shifted onto the keys which were never inserted
+    for (size_t i = 0; i < num_atoms; i++)
+        ctx.order[i] += num_atoms;
+    bench_run("atom", names[2], atom_find, &ctx, ATOM_BATCH);
+
+    ctx.next_key = 2 * num_atoms;
+    bench_run("atom", names[3], atom_upsert_new, &ctx, ATOM_BATCH);
+    bench_run("atom", names[6], atom_upsert_new_batch, &ctx, ATOM_BATCH);
+
+    free(ctx.keys);
+    free(ctx.key_lens);
+    free(ctx.order);
+}
+
+void bench_atom() {
+    bench_atom_table(1000);
+    bench_atom_table(100 * 1000);
+    bench_atom_table(1000 * 1000);
+}
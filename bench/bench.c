@@ -0,0 +1,178 @@
+#include "bench.h"
+#include "runtime/os/heap.h"
+#include "runtime/os/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Runs the runtime's microbenchmarks and prints one JSON object per line:
+
+    {"group":"hash","name":"len=8","samples":200,"ops":...,"mean":...,"min":...,"p50":...,"p90":...,"p99":...,"max":...}
+
+Every statistic is in nanoseconds per operation. Operations are timed in batches as the
+clock is too coarse (and too slow) to time a single one, so the percentiles are over batches.
+Benchmarks measuring throughput as well add the operations completed per second as "per_sec".
+Memory benchmarks print "entries", "bytes" and "bytes_per_entry" instead of the statistics.
+
+usage: lazer_bench [filter] [samples]
+where only benchmarks whose "group/name" contain `filter` are run.
+*/
+#define BENCH_DEFAULT_SAMPLES 200
+
+// enough for the keys of the biggest map benchmark (see bench/map.c) and then some
+#define BENCH_ATOMS (2 * 1000 * 1000)
+
+static const char* bench_filter = NULL;
+static size_t bench_num_samples = BENCH_DEFAULT_SAMPLES;
+static volatile uint64_t bench_sink_value;
+static lzr_atom_table_t bench_atom_table;
+
+void bench_sink(uint64_t value) {
+    bench_sink_value += value;
+}
+
+uint64_t bench_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+size_t bench_samples() {
+    return bench_num_samples;
+}
+
+lzr_atom_table_t* bench_atoms() {
+    return &bench_atom_table;
+}
+
+bool bench_enabled(const char* group, const char* name) {
+    if (bench_filter == NULL)
+        return true;
+
+    char full_name[256];
+    snprintf(full_name, sizeof(full_name), "%s/%s", group, name);
+    return strstr(full_name, bench_filter) != NULL;
+}
+
+int bench_compare(const void* left, const void* right) {
+    double a = *(const double*) left;
+    double b = *(const double*) right;
+    return (a > b) - (a < b);
+}
+
+double bench_percentile(const double* sorted, size_t count, size_t percent) {
+    return sorted[((count - 1) * percent) / 100];
+}
+
+// print the samples' percentiles, leaving the JSON object open for more fields
+void bench_report_samples(const char* group, const char* name, double* samples, size_t count, uint64_t ops) {
+    double mean = 0;
+    for (size_t i = 0; i < count; i++)
+        mean += samples[i];
+    mean /= (double) count;
+
+    qsort(samples, count, sizeof(double), bench_compare);
+    printf("{\"group\":\"%s\",\"name\":\"%s\",\"samples\":%zu,\"ops\":%llu,"
+           "\"mean\":%.2f,\"min\":%.2f,\"p50\":%.2f,\"p90\":%.2f,\"p99\":%.2f,\"max\":%.2f",
+        group, name, count, (unsigned long long) ops,
+        mean, samples[0], bench_percentile(samples, count, 50), bench_percentile(samples, count, 90),
+        bench_percentile(samples, count, 99), samples[count - 1]);
+}
+
+// the samples' percentiles with an extra `field` (if not NULL) measured alongside them
+void bench_report_with(const char* group, const char* name, double* samples, size_t count, uint64_t ops, const char* field, double value) {
+    bench_report_samples(group, name, samples, count, ops);
+    if (field != NULL)
+        printf(",\"%s\":%.0f", field, value);
+    printf("}\n");
+    fflush(stdout);
+}
+
+void bench_report(const char* group, const char* name, double* samples, size_t count, uint64_t ops) {
+    bench_report_with(group, name, samples, count, ops, NULL, 0);
+}
+
+void bench_report_rate(const char* group, const char* name, double* samples, size_t count, uint64_t ops, double per_sec) {
+    bench_report_with(group, name, samples, count, ops, "per_sec", per_sec);
+}
+
+void bench_report_bandwidth(const char* group, const char* name, double* samples, size_t count, uint64_t ops, double mb_per_sec) {
+    bench_report_with(group, name, samples, count, ops, "mb_per_sec", mb_per_sec);
+}
+
+void bench_report_fairness(const char* group, const char* name, double* samples, size_t count, uint64_t ops, double per_sec, uint64_t min_acquired, uint64_t max_acquired) {
+    bench_report_samples(group, name, samples, count, ops);
+    printf(",\"per_sec\":%.0f,\"min_acquired\":%llu,\"max_acquired\":%llu,\"fairness\":%.3f}\n",
+        per_sec, (unsigned long long) min_acquired, (unsigned long long) max_acquired,
+        max_acquired != 0 ? (double) min_acquired / (double) max_acquired : 1.0);
+    fflush(stdout);
+}
+
+void bench_report_memory(const char* group, const char* name, size_t entries, size_t bytes) {
+    printf("{\"group\":\"%s\",\"name\":\"%s\",\"entries\":%zu,\"bytes\":%zu,\"bytes_per_entry\":%.2f}\n",
+        group, name, entries, bytes, (double) bytes / (double) entries);
+    fflush(stdout);
+}
+
+void bench_report_fragmentation(const char* group, const char* name, size_t live_chunks, size_t top_chunks, size_t free_runs, double fragmentation) {
+    printf("{\"group\":\"%s\",\"name\":\"%s\",\"live_chunks\":%zu,\"top_chunks\":%zu,\"top_per_live\":%.2f,"
+           "\"free_runs\":%zu,\"fragmentation\":%.3f}\n",
+        group, name, live_chunks, top_chunks, (double) top_chunks / (double) live_chunks, free_runs, fragmentation);
+    fflush(stdout);
+}
+
+void bench_report_quality(const char* group, const char* name, size_t keys, double group_chi2, double ctrl_chi2, double avalanche_bias, double mean_probe, size_t max_probe) {
+    printf("{\"group\":\"%s\",\"name\":\"%s\",\"keys\":%zu,\"group_chi2\":%.3f,\"ctrl_chi2\":%.3f,"
+           "\"avalanche_bias\":%.4f,\"mean_probe\":%.3f,\"max_probe\":%zu}\n",
+        group, name, keys, group_chi2, ctrl_chi2, avalanche_bias, mean_probe, max_probe);
+    fflush(stdout);
+}
+
+void bench_run(const char* group, const char* name, bench_fn fn, void* ctx, size_t batch) {
+    if (!bench_enabled(group, name))
+        return;
+
+    // one untimed batch to warm up the caches & branch predictors
+    fn(ctx, batch);
+
+    size_t count = bench_num_samples;
+    double* samples = (double*) malloc(count * sizeof(double));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t start = lzr_time_now();
+        fn(ctx, batch);
+        samples[i] = (double) (lzr_time_now() - start) / (double) batch;
+    }
+
+    bench_report(group, name, samples, count, (uint64_t) count * batch);
+    free(samples);
+}
+
+int main(int argc, const char* argv[]) {
+    if (argc > 1 && argv[1][0] != '\0')
+        bench_filter = argv[1];
+    if (argc > 2 && atoi(argv[2]) > 0)
+        bench_num_samples = (size_t) atoi(argv[2]);
+
+    // atom tables reserve their cells so they all have to be set up before the heap is committed.
+    // there's only one atom heap so the table everything else shares comes after bench_atom's.
+    lzr_heap_init();
+    bench_hash();
+    bench_atom();
+    lzr_atom_table_init(&bench_atom_table, BENCH_ATOMS);
+    lzr_heap_commit();
+    bench_heap();
+    bench_lock();
+    bench_sched();
+    bench_mailbox();
+    bench_registry();
+    bench_binary();
+    bench_io();
+    bench_timer();
+    bench_term();
+    bench_map();
+    bench_etf();
+    return 0;
+}
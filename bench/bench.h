@@ -0,0 +1,65 @@
+#ifndef LZR_BENCH_H
+#define LZR_BENCH_H
+
+#include "runtime/atom.h"
+
+// perform `iters` operations of whatever is being measured
+typedef void (*bench_fn)(void* ctx, size_t iters);
+
+// time `samples` batches of `batch` operations each and report the ns/op of the batches
+// as a single JSON line on stdout. Skipped if `group/name` doesn't match the filter.
+void bench_run(const char* group, const char* name, bench_fn fn, void* ctx, size_t batch);
+
+// report ns/op samples which were measured elsewhere (like across several threads)
+void bench_report(const char* group, const char* name, double* samples, size_t count, uint64_t ops);
+
+// same but with the operations per second measured alongside the samples
+void bench_report_rate(const char* group, const char* name, double* samples, size_t count, uint64_t ops, double per_sec);
+
+// same but with the megabytes per second of a decoder or the like
+void bench_report_bandwidth(const char* group, const char* name, double* samples, size_t count, uint64_t ops, double mb_per_sec);
+
+// same but for a lock: with how many times the threads which got it the least and the most
+// got it while all of them wanted it, and the ratio of the two as how fair it was (1.0 is fair)
+void bench_report_fairness(const char* group, const char* name, double* samples, size_t count, uint64_t ops, double per_sec, uint64_t min_acquired, uint64_t max_acquired);
+
+bool bench_enabled(const char* group, const char* name);
+
+size_t bench_samples();
+
+// stops the compiler from optimizing away the result of an operation
+void bench_sink(uint64_t value);
+
+// deterministic xorshift so runs are comparable
+uint64_t bench_random(uint64_t* state);
+
+// the atom table shared by the benchmarks which run after the heap is committed
+lzr_atom_table_t* bench_atoms();
+
+// report the memory used by a data structure holding `entries` entries
+void bench_report_memory(const char* group, const char* name, size_t entries, size_t bytes);
+
+// report how many chunks the heap's top grew to hold `live_chunks` live chunks, and the free
+// runs and fragmentation (1 - largest free run / free chunks) of its free lists afterwards
+void bench_report_fragmentation(const char* group, const char* name, size_t live_chunks, size_t top_chunks, size_t free_runs, double fragmentation);
+
+// report how well a hash spreads `keys` keys: the chi-squared of the group and control
+// byte buckets over its expected value (~1.0 for a random function), the worst output bit's
+// avalanche bias away from 0.5, and the groups probed per insert into the atom table's layout
+void bench_report_quality(const char* group, const char* name, size_t keys, double group_chi2, double ctrl_chi2, double avalanche_bias, double mean_probe, size_t max_probe);
+
+void bench_hash();
+void bench_atom();
+void bench_heap();
+void bench_lock();
+void bench_sched();
+void bench_mailbox();
+void bench_registry();
+void bench_binary();
+void bench_io();
+void bench_timer();
+void bench_term();
+void bench_map();
+void bench_etf();
+
+#endif // LZR_BENCH_H
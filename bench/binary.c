@@ -0,0 +1,94 @@
+#include "bench.h"
+#include "runtime/binary.h"
+#include "runtime/slab.h"
+#include "runtime/sched/sched.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BINARY_SIZE (1024 * 1024)
+#define BINARY_CHAIN 16
+#define BINARY_PEEK 64
+
+typedef struct {
+    lzr_message_t header;
+    uint32_t binary;
+} binary_message_t;
+
+typedef struct {
+    lzr_actor_t* chain[BINARY_CHAIN];
+    lzr_binary_t* source;
+    bool copy;
+    uint64_t peeked;
+} binary_ctx_t;
+
+static binary_ctx_t binary;
+
+// each actor in the chain looks at the start of the binary through a term on its own
+// heap (like matching on a header) and then passes the message on to the next one.
+// with copy semantics every hop gets its own copy of the bytes instead of a reference.
+void binary_hop(lzr_actor_t* actor, lzr_message_t* message) {
+    binary_message_t* msg = (binary_message_t*) message;
+    lzr_binary_t* received = (lzr_binary_t*) LZR_PTR_UNZIP(msg->binary);
+
+    if (binary.copy) {
+        lzr_binary_t* copy = lzr_binary_new(received->size);
+        memcpy(lzr_binary_bytes(copy), lzr_binary_bytes(received), received->size);
+        lzr_binary_unref(received);
+        received = copy;
+        msg->binary = LZR_PTR_ZIP(copy);
+    }
+
+    lzr_term_t term = lzr_binary_term(&actor->heap, received, 0, BINARY_PEEK);
+    if (term == LZR_NIL) {
+        lzr_arena_collect(&actor->heap, NULL, 0, sizeof(lzr_object_t) + sizeof(lzr_sub_binary_t));
+        term = lzr_binary_term(&actor->heap, received, 0, BINARY_PEEK);
+    }
+
+    uint64_t peeked = 0;
+    for (size_t i = 0; i < BINARY_PEEK; i++)
+        peeked += lzr_binary_term_bytes(term)[i];
+    bench_sink(peeked);
+
+    // the message's reference moves along with it
+    lzr_actor_t* next = (lzr_actor_t*) actor->state;
+    if (next != NULL) {
+        lzr_actor_send(next, message);
+    } else {
+        lzr_binary_unref(received);
+        lzr_slab_free((void*) message);
+    }
+}
+
+void binary_forward(void* ctx, size_t iters) {
+    for (size_t i = 0; i < iters; i++) {
+        binary_message_t* msg = (binary_message_t*) lzr_slab_alloc(sizeof(binary_message_t));
+        lzr_binary_ref(binary.source);
+        msg->binary = LZR_PTR_ZIP(binary.source);
+        lzr_actor_send(binary.chain[0], &msg->header);
+    }
+    lzr_sched_run(0);
+}
+
+// forward a 1mb binary through a chain of actors by reference vs by copying it at every hop
+void bench_binary() {
+    binary.source = lzr_binary_new(BINARY_SIZE);
+    memset(lzr_binary_bytes(binary.source), 0x5a, BINARY_SIZE);
+    for (size_t i = BINARY_CHAIN; i-- > 0;)
+        binary.chain[i] = lzr_actor_spawn(binary_hop, i + 1 < BINARY_CHAIN ? binary.chain[i + 1] : NULL);
+
+    char name[64];
+    snprintf(name, sizeof(name), "forward_ref/actors=%d", BINARY_CHAIN);
+    binary.copy = false;
+    if (bench_enabled("binary", name))
+        bench_run("binary", name, binary_forward, NULL, 4);
+
+    snprintf(name, sizeof(name), "forward_copy/actors=%d", BINARY_CHAIN);
+    binary.copy = true;
+    if (bench_enabled("binary", name))
+        bench_run("binary", name, binary_forward, NULL, 4);
+
+    for (size_t i = 0; i < BINARY_CHAIN; i++)
+        lzr_actor_free(binary.chain[i]);
+    assert(binary.source->refs == 1);
+    lzr_binary_unref(binary.source);
+}
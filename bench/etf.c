@@ -0,0 +1,255 @@
+#include "bench.h"
+#include "runtime/etf.h"
+#include "runtime/os/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ETF_MESSAGES 4096
+#define ETF_USERS 64
+#define ETF_PAYLOAD_BINARY 64
+
+/*
+Decoding a stream of distribution messages like a connection from another node would send:
+a `{2, '', bench_server}` send control message followed by a
+`{'$gen_cast', {update, user_N, #{name => <<64 bytes>>, count => N, status => active, tags => [...]}}}`
+payload. The `cache` stream refers to every atom through the distribution header's atom cache
+(only sending each one's text the first time), the `inline` stream spells them all out as
+SMALL_ATOM_UTF8_EXT like a connection without the atom cache would. The stream is fed to the
+decoder in pieces the size of a TCP segment and of a big read.
+*/
+typedef struct {
+    uint8_t* bytes;
+    size_t len;
+    size_t capacity;
+} etf_buffer_t;
+
+static const char* etf_atoms[] = { "", "bench_server", "$gen_cast", "update", "name", "count", "status", "active", "tags" };
+#define ETF_NUM_ATOMS (sizeof(etf_atoms) / sizeof(etf_atoms[0]))
+
+void etf_put(etf_buffer_t* buffer, const void* bytes, size_t len) {
+    if (buffer->len + len > buffer->capacity) {
+        buffer->capacity = (buffer->len + len) * 2;
+        buffer->bytes = (uint8_t*) realloc(buffer->bytes, buffer->capacity);
+    }
+    memcpy(buffer->bytes + buffer->len, bytes, len);
+    buffer->len += len;
+}
+
+void etf_put_u8(etf_buffer_t* buffer, uint8_t value) {
+    etf_put(buffer, &value, 1);
+}
+
+void etf_put_u32(etf_buffer_t* buffer, uint32_t value) {
+    uint8_t bytes[] = { (uint8_t) (value >> 24), (uint8_t) (value >> 16), (uint8_t) (value >> 8), (uint8_t) value };
+    etf_put(buffer, bytes, sizeof(bytes));
+}
+
+// an atom as a reference to the header's `ref` when caching, otherwise spelled out
+void etf_put_atom(etf_buffer_t* buffer, bool cache, size_t ref, const char* text) {
+    if (cache) {
+        etf_put_u8(buffer, 82);
+        etf_put_u8(buffer, (uint8_t) ref);
+    } else {
+        etf_put_u8(buffer, 119);
+        etf_put_u8(buffer, (uint8_t) strlen(text));
+        etf_put(buffer, text, strlen(text));
+    }
+}
+
+// the header refers to the fixed atoms by their index and then to the message's user,
+// all in the first segment of the cache with the users after the fixed atoms
+void etf_put_header(etf_buffer_t* buffer, size_t message, const char* user) {
+    size_t num_refs = ETF_NUM_ATOMS + 1;
+    uint8_t flags[(ETF_NUM_ATOMS + 1) / 2 + 1] = { 0 };
+    for (size_t i = 0; i < num_refs; i++) {
+        bool is_new = i < ETF_NUM_ATOMS ? message == 0 : message < ETF_USERS;
+        flags[i / 2] |= (uint8_t) ((is_new ? 0x8 : 0) << (4 * (i & 1)));
+    }
+
+    uint8_t start[] = { 131, 68, (uint8_t) num_refs };
+    etf_put(buffer, start, sizeof(start));
+    etf_put(buffer, flags, sizeof(flags));
+    for (size_t i = 0; i < num_refs; i++) {
+        const char* text = i < ETF_NUM_ATOMS ? etf_atoms[i] : user;
+        etf_put_u8(buffer, (uint8_t) (i < ETF_NUM_ATOMS ? i : ETF_NUM_ATOMS + message % ETF_USERS));
+        if (flags[i / 2] & (0x8 << (4 * (i & 1)))) {
+            etf_put_u8(buffer, (uint8_t) strlen(text));
+            etf_put(buffer, text, strlen(text));
+        }
+    }
+}
+
+void etf_put_message(etf_buffer_t* buffer, bool cache, size_t message) {
+    char user[16];
+    snprintf(user, sizeof(user), "user_%zu", message % ETF_USERS);
+    if (cache)
+        etf_put_header(buffer, message, user);
+
+    // {2, '', bench_server}
+    if (!cache)
+        etf_put_u8(buffer, 131);
+    uint8_t control[] = { 104, 3, 97, 2 };
+    etf_put(buffer, control, sizeof(control));
+    etf_put_atom(buffer, cache, 0, etf_atoms[0]);
+    etf_put_atom(buffer, cache, 1, etf_atoms[1]);
+
+    if (!cache)
+        etf_put_u8(buffer, 131);
+    etf_put_u8(buffer, 104);
+    etf_put_u8(buffer, 2);
+    etf_put_atom(buffer, cache, 2, etf_atoms[2]);
+    etf_put_u8(buffer, 104);
+    etf_put_u8(buffer, 3);
+    etf_put_atom(buffer, cache, 3, etf_atoms[3]);
+    etf_put_atom(buffer, cache, ETF_NUM_ATOMS, user);
+
+    etf_put_u8(buffer, 116);
+    etf_put_u32(buffer, 4);
+    etf_put_atom(buffer, cache, 4, etf_atoms[4]);
+    etf_put_u8(buffer, 109);
+    etf_put_u32(buffer, ETF_PAYLOAD_BINARY);
+    for (size_t i = 0; i < ETF_PAYLOAD_BINARY; i++)
+        etf_put_u8(buffer, (uint8_t) (message + i));
+    etf_put_atom(buffer, cache, 5, etf_atoms[5]);
+    etf_put_u8(buffer, 98);
+    etf_put_u32(buffer, (uint32_t) message);
+    etf_put_atom(buffer, cache, 6, etf_atoms[6]);
+    etf_put_atom(buffer, cache, 7, etf_atoms[7]);
+    etf_put_atom(buffer, cache, 8, etf_atoms[8]);
+    etf_put_u8(buffer, 108);
+    etf_put_u32(buffer, 8);
+    for (size_t i = 0; i < 8; i++) {
+        etf_put_u8(buffer, 97);
+        etf_put_u8(buffer, (uint8_t) (message + i));
+    }
+    etf_put_u8(buffer, 106);
+}
+
+// decode the whole stream `chunk` bytes at a time, returning how many terms were in it
+size_t etf_decode(lzr_etf_decoder_t* decoder, lzr_arena_t* arena, etf_buffer_t* stream, size_t chunk) {
+    size_t terms = 0;
+    for (size_t at = 0; at < stream->len;) {
+        size_t len = stream->len - at < chunk ? stream->len - at : chunk;
+        size_t consumed = 0;
+        while (consumed < len) {
+            size_t used;
+            lzr_term_t term;
+            int status = lzr_etf_decode(decoder, stream->bytes + at + consumed, len - consumed, &used, &term);
+            consumed += used;
+            assert(status != LZR_ETF_ERROR);
+            if (status == LZR_ETF_TERM) {
+                terms++;
+                bench_sink(term);
+            } else if (status == LZR_ETF_FULL) {
+                uint32_t* roots[LZR_ETF_MAX_ROOTS];
+                size_t num_roots = lzr_etf_roots(decoder, roots);
+                bool collected = lzr_arena_collect(arena, roots, num_roots, decoder->reserve);
+                assert(collected);
+                (void) collected;
+            }
+        }
+        at += len;
+    }
+    return terms;
+}
+
+void etf_bench(const char* stream_name, etf_buffer_t* stream, size_t chunk) {
+    char name[64];
+    snprintf(name, sizeof(name), "decode/%s/chunk=%zu", stream_name, chunk);
+    if (!bench_enabled("etf", name))
+        return;
+
+    lzr_arena_t arena;
+    lzr_arena_init(&arena);
+    lzr_etf_decoder_t* decoder = (lzr_etf_decoder_t*) malloc(sizeof(lzr_etf_decoder_t));
+
+    // a pass is a new connection so its atom cache starts out empty. ns/op is per message
+    size_t count = bench_samples();
+    double* samples = (double*) malloc(count * sizeof(double));
+    double elapsed = 0;
+    for (size_t i = 0; i <= count; i++) {
+        lzr_etf_decoder_init(decoder, bench_atoms(), &arena);
+        uint64_t start = lzr_time_now();
+        size_t terms = etf_decode(decoder, &arena, stream, chunk);
+        uint64_t end = lzr_time_now();
+        assert(terms == 2 * ETF_MESSAGES);
+        (void) terms;
+        lzr_etf_decoder_destroy(decoder);
+
+        // the first pass is untimed to warm up the caches & intern the atoms
+        if (i > 0) {
+            samples[i - 1] = (double) (end - start) / (double) ETF_MESSAGES;
+            elapsed += (double) (end - start);
+        }
+    }
+
+    double mb = (double) stream->len * (double) count / (1024.0 * 1024.0);
+    bench_report_bandwidth("etf", name, samples, count, (uint64_t) count * ETF_MESSAGES, mb * 1e9 / elapsed);
+    free(samples);
+    free(decoder);
+    lzr_arena_destroy(&arena);
+}
+
+// decode `len` bytes in one go with a fresh decoder, checking the last status it returned
+void etf_check(lzr_etf_decoder_t* decoder, lzr_arena_t* arena, const uint8_t* bytes, size_t len, size_t max_binary, int expected) {
+    lzr_etf_decoder_init(decoder, bench_atoms(), arena);
+    decoder->max_binary = max_binary;
+    int status = LZR_ETF_MORE;
+    for (size_t at = 0; (at < len || status == LZR_ETF_FULL) && status != LZR_ETF_ERROR;) {
+        size_t used;
+        lzr_term_t term;
+        status = lzr_etf_decode(decoder, bytes + at, len - at, &used, &term);
+        at += used;
+        if (status == LZR_ETF_FULL) {
+            uint32_t* roots[LZR_ETF_MAX_ROOTS];
+            if (!lzr_arena_collect(arena, roots, lzr_etf_roots(decoder, roots), decoder->reserve))
+                break;
+        }
+    }
+    lzr_etf_decoder_destroy(decoder);
+    assert(status == expected);
+}
+
+// what a peer mustn't get away with: a binary length header asking for 4gb (or just more than
+// `max_binary`) and referring to the atom cache of a message whose header no longer applies
+void etf_check_limits() {
+    lzr_arena_t arena;
+    lzr_arena_init(&arena);
+    lzr_etf_decoder_t* decoder = (lzr_etf_decoder_t*) malloc(sizeof(lzr_etf_decoder_t));
+
+    uint8_t huge[] = { 131, 109, 0xff, 0xff, 0xff, 0xff };
+    etf_check(decoder, &arena, huge, sizeof(huge), LZR_ETF_MAX_BINARY, LZR_ETF_ERROR);
+
+    uint8_t binary[] = { 131, 109, 0, 0, 0, 4, 1, 2, 3, 4 };
+    etf_check(decoder, &arena, binary, sizeof(binary), 4, LZR_ETF_TERM);
+    etf_check(decoder, &arena, binary, sizeof(binary), 3, LZR_ETF_ERROR);
+
+    // a header caching 'a', a control message & payload using it, then a third term trying to
+    uint8_t stale[] = { 131, 68, 1, 0x08, 0, 1, 'a', 82, 0, 82, 0, 82, 0 };
+    etf_check(decoder, &arena, stale, sizeof(stale) - 2, LZR_ETF_MAX_BINARY, LZR_ETF_TERM);
+    etf_check(decoder, &arena, stale, sizeof(stale), LZR_ETF_MAX_BINARY, LZR_ETF_ERROR);
+
+    free(decoder);
+    lzr_arena_destroy(&arena);
+}
+
+void bench_etf() {
+    etf_check_limits();
+
+    etf_buffer_t cached = { NULL, 0, 0 };
+    etf_buffer_t inlined = { NULL, 0, 0 };
+    for (size_t i = 0; i < ETF_MESSAGES; i++) {
+        etf_put_message(&cached, true, i);
+        etf_put_message(&inlined, false, i);
+    }
+
+    size_t chunks[] = { 1460, 64 * 1024 };
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        etf_bench("cache", &cached, chunks[i]);
+        etf_bench("inline", &inlined, chunks[i]);
+    }
+
+    free(cached.bytes);
+    free(inlined.bytes);
+}
@@ -0,0 +1,217 @@
+#include "bench.h"
+#include "runtime/hash.h"
+#include "runtime/os/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HASH_MAX_LEN 1024
+#define HASH_BATCH 10000
+#define HASH_KEY_SIZE 32
+#define HASH_AVALANCHE_KEYS 4096
+
+// the atom table's layout: 16 cells per group, the low 7 bits of the hash as the control
+// byte, the bits above them picking the group, and growing at 94% load
+#define HASH_GROUP_SIZE 16
+#define HASH_GROUP_SHIFT 7
+#define HASH_CTRL_BUCKETS 128
+#define HASH_LOAD_FACTOR 94
+
+typedef struct {
+    char bytes[HASH_MAX_LEN];
+    size_t len;
+} hash_ctx_t;
+
+typedef struct {
+    char* keys;
+    size_t* lens;
+    size_t count;
+} hash_corpus_t;
+
+// the hash of each key changes the next key a bit so the calls can't be overlapped or hoisted
+void hash_bytes(void* ctx, size_t iters) {
+    hash_ctx_t* self = (hash_ctx_t*) ctx;
+    uint32_t hash = 0;
+    for (size_t i = 0; i < iters; i++) {
+        self->bytes[0] = (char) hash;
+        hash = lzr_hash_bytes(self->bytes, self->len);
+    }
+    bench_sink(hash);
+}
+
+// bench_run() but with the megabytes hashed per second alongside the ns/op
+void hash_bandwidth(hash_ctx_t* ctx) {
+    char name[32];
+    snprintf(name, sizeof(name), "len=%zu", ctx->len);
+    if (!bench_enabled("hash", name))
+        return;
+
+    hash_bytes(ctx, HASH_BATCH);
+    size_t count = bench_samples();
+    double* samples = (double*) malloc(count * sizeof(double));
+    double elapsed = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t start = lzr_time_now();
+        hash_bytes(ctx, HASH_BATCH);
+        uint64_t end = lzr_time_now();
+        samples[i] = (double) (end - start) / (double) HASH_BATCH;
+        elapsed += (double) (end - start);
+    }
+
+    uint64_t ops = (uint64_t) count * HASH_BATCH;
+    double mb = (double) ops * (double) ctx->len / (1024.0 * 1024.0);
+    bench_report_bandwidth("hash", name, samples, count, ops, mb * 1e9 / elapsed);
+    free(samples);
+}
+
+#define HASH_KEY(corpus, i) (&(corpus)->keys[(i) * HASH_KEY_SIZE])
+
+void hash_corpus_init(hash_corpus_t* self, size_t count) {
+    self->keys = (char*) malloc(count * HASH_KEY_SIZE);
+    self->lens = (size_t*) malloc(count * sizeof(size_t));
+    self->count = count;
+}
+
+void hash_corpus_destroy(hash_corpus_t* self) {
+    free(self->keys);
+    free(self->lens);
+}
+
+// chi-squared of `count` keys over `num_buckets` buckets, divided by its expected value
+// (the degrees of freedom) so that a random function comes out around 1.0
+double hash_chi_squared(const uint32_t* hashes, size_t count, size_t shift, size_t num_buckets) {
+    size_t* buckets = (size_t*) calloc(num_buckets, sizeof(size_t));
+    for (size_t i = 0; i < count; i++)
+        buckets[(hashes[i] >> shift) & (num_buckets - 1)]++;
+
+    double expected = (double) count / (double) num_buckets;
+    double chi_squared = 0;
+    for (size_t i = 0; i < num_buckets; i++) {
+        double diff = (double) buckets[i] - expected;
+        chi_squared += (diff * diff) / expected;
+    }
+    free(buckets);
+    return chi_squared / (double) (num_buckets - 1);
+}
+
+// flip every bit of the first keys one at a time and return how far the output bit which
+// flips least or most evenly strays from flipping half the time
+double hash_avalanche(const hash_corpus_t* self) {
+    uint64_t flips[32] = { 0 };
+    uint64_t trials = 0;
+    size_t count = self->count < HASH_AVALANCHE_KEYS ? self->count : HASH_AVALANCHE_KEYS;
+    for (size_t i = 0; i < count; i++) {
+        char key[HASH_KEY_SIZE];
+        size_t len = self->lens[i];
+        memcpy(key, HASH_KEY(self, i), len);
+        uint32_t hash = lzr_hash_bytes(key, len);
+
+        for (size_t bit = 0; bit < len * 8; bit++) {
+            key[bit / 8] ^= (char) (1 << (bit % 8));
+            uint32_t diff = hash ^ lzr_hash_bytes(key, len);
+            key[bit / 8] ^= (char) (1 << (bit % 8));
+            for (size_t out = 0; out < 32; out++)
+                flips[out] += (diff >> out) & 1;
+            trials++;
+        }
+    }
+
+    double worst = 0;
+    for (size_t out = 0; out < 32; out++) {
+        double bias = (double) flips[out] / (double) trials - 0.5;
+        bias = bias < 0 ? -bias : bias;
+        worst = bias > worst ? bias : worst;
+    }
+    return worst;
+}
+
+// insert the keys into group occupancy counts the way the atom table's quadratic probing
+// would at the capacity it would have grown to, tracking how many groups each one visited
+void hash_probes(const uint32_t* hashes, size_t count, double* mean_probe, size_t* max_probe) {
+    size_t num_cells = HASH_GROUP_SIZE;
+    while (count >= (HASH_LOAD_FACTOR * num_cells) / 100)
+        num_cells *= 2;
+
+    size_t group_mask = (num_cells / HASH_GROUP_SIZE) - 1;
+    uint8_t* groups = (uint8_t*) calloc(group_mask + 1, sizeof(uint8_t));
+    uint64_t total = 0;
+    *max_probe = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t group = (hashes[i] >> HASH_GROUP_SHIFT) & group_mask;
+        size_t stride = 1;
+        while (groups[group] == HASH_GROUP_SIZE)
+            group = (group + stride++) & group_mask;
+        groups[group]++;
+        total += stride;
+        *max_probe = stride > *max_probe ? stride : *max_probe;
+    }
+
+    *mean_probe = (double) total / (double) count;
+    free(groups);
+}
+
+void hash_quality(const char* corpus_name, hash_corpus_t* corpus) {
+    char name[64];
+    snprintf(name, sizeof(name), "quality/%s", corpus_name);
+    if (!bench_enabled("hash", name))
+        return;
+
+    uint32_t* hashes = (uint32_t*) malloc(corpus->count * sizeof(uint32_t));
+    for (size_t i = 0; i < corpus->count; i++)
+        hashes[i] = lzr_hash_bytes(HASH_KEY(corpus, i), corpus->lens[i]);
+
+    // aim for 8 keys per group bucket so the chi-squared is meaningful
+    size_t num_groups = 1;
+    while (num_groups * 8 < corpus->count)
+        num_groups *= 2;
+
+    double mean_probe;
+    size_t max_probe;
+    hash_probes(hashes, corpus->count, &mean_probe, &max_probe);
+    bench_report_quality("hash", name, corpus->count,
+        hash_chi_squared(hashes, corpus->count, HASH_GROUP_SHIFT, num_groups),
+        hash_chi_squared(hashes, corpus->count, 0, HASH_CTRL_BUCKETS),
+        hash_avalanche(corpus), mean_probe, max_probe);
+    free(hashes);
+}
+
+void bench_hash() {
+    static const size_t lens[] = { 1, 4, 8, 12, 16, 24, 32, 64, 128, 255, 512, 1024 };
+    static hash_ctx_t ctx;
+
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < HASH_MAX_LEN; i++)
+        ctx.bytes[i] = (char) bench_random(&seed);
+
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        ctx.len = lens[i];
+        hash_bandwidth(&ctx);
+    }
+
+    // keys like the atoms a program makes: numbered ones like the atom benchmarks use,
+    // module names which share a long prefix and suffix, and every short name up to 3 letters
+    hash_corpus_t corpus;
+    size_t num_keys = 1000 * 1000;
+    hash_corpus_init(&corpus, num_keys);
+    for (size_t i = 0; i < num_keys; i++)
+        corpus.lens[i] = (size_t) snprintf(HASH_KEY(&corpus, i), HASH_KEY_SIZE, "atom_%zu", i);
+    hash_quality("numbered", &corpus);
+
+    for (size_t i = 0; i < num_keys; i++)
+        corpus.lens[i] = (size_t) snprintf(HASH_KEY(&corpus, i), HASH_KEY_SIZE, "Elixir.App.M%zu.Worker", i);
+    hash_quality("module", &corpus);
+
+    corpus.count = 0;
+    for (size_t len = 1; len <= 3; len++) {
+        size_t combos = len == 1 ? 26 : (len == 2 ? 26 * 26 : 26 * 26 * 26);
+        for (size_t n = 0; n < combos; n++) {
+            char* key = HASH_KEY(&corpus, corpus.count);
+            for (size_t c = 0, rest = n; c < len; c++, rest /= 26)
+                key[c] = (char) ('a' + rest % 26);
+            corpus.lens[corpus.count++] = len;
+        }
+    }
+    hash_quality("short", &corpus);
+    hash_corpus_destroy(&corpus);
+}
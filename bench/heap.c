@@ -0,0 +1,185 @@
+#include "bench.h"
+#include "runtime/os/heap.h"
+#include "runtime/os/lock.h"
+#include "runtime/os/thread.h"
+#include "runtime/os/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HEAP_LIVE 64
+#define HEAP_BATCH 1000
+#define HEAP_MAX_THREADS 64
+#define HEAP_FRAGMENT_OPS (100 * 1000)
+#define HEAP_FRAGMENT_BATCH 100
+
+typedef struct {
+    uint16_t max_chunks;
+    bool random;
+    uint64_t seed;
+    void* live[HEAP_LIVE];
+    uint16_t sizes[HEAP_LIVE];
+} heap_ctx_t;
+
+// an op is freeing one of HEAP_LIVE live runs and allocating another in its place.
+// with `random` set both the slot and the size (up to max_chunks) are random
+// which fragments the heap, otherwise it's a LIFO of max_chunks sized runs.
+void heap_churn(void* ctx, size_t iters) {
+    heap_ctx_t* self = (heap_ctx_t*) ctx;
+    for (size_t i = 0; i < iters; i++) {
+        size_t slot = self->random ? bench_random(&self->seed) % HEAP_LIVE : i % HEAP_LIVE;
+        uint16_t size = self->random ? 1 + (uint16_t) (bench_random(&self->seed) % self->max_chunks) : self->max_chunks;
+        lzr_heap_free(self->live[slot]);
+        self->live[slot] = lzr_heap_alloc(size);
+        self->sizes[slot] = size;
+    }
+}
+
+void heap_bench(const char* name, uint16_t max_chunks, bool random) {
+    if (!bench_enabled("heap", name))
+        return;
+
+    static heap_ctx_t ctx;
+    ctx.max_chunks = max_chunks;
+    ctx.random = random;
+    ctx.seed = 0x853c49e6748fea9bULL;
+    for (size_t i = 0; i < HEAP_LIVE; i++) {
+        ctx.live[i] = lzr_heap_alloc(max_chunks);
+        ctx.sizes[i] = max_chunks;
+    }
+
+    bench_run("heap", name, heap_churn, &ctx, HEAP_BATCH);
+
+    for (size_t i = 0; i < HEAP_LIVE; i++)
+        lzr_heap_free(ctx.live[i]);
+    lzr_heap_cache_flush();
+}
+
+// Untimed: churn random sizes and check how far the top of the heap had to grow past where it
+// started compared to the chunks actually live, sampling the top every HEAP_FRAGMENT_BATCH ops.
+// Anything above the live chunks is free runs too small or badly placed to be reused.
+void heap_fragmentation(const char* name, uint16_t max_chunks) {
+    if (!bench_enabled("heap", name))
+        return;
+
+    lzr_stats_heap_t stats;
+    lzr_heap_stats(&stats);
+    uint64_t base = stats.top_chunks;
+    uint64_t peak = base;
+
+    static heap_ctx_t ctx;
+    ctx.max_chunks = max_chunks;
+    ctx.random = true;
+    ctx.seed = 0x853c49e6748fea9bULL;
+    for (size_t i = 0; i < HEAP_LIVE; i++) {
+        ctx.sizes[i] = 1 + (uint16_t) (bench_random(&ctx.seed) % max_chunks);
+        ctx.live[i] = lzr_heap_alloc(ctx.sizes[i]);
+    }
+
+    for (size_t i = 0; i < HEAP_FRAGMENT_OPS; i += HEAP_FRAGMENT_BATCH) {
+        heap_churn(&ctx, HEAP_FRAGMENT_BATCH);
+        lzr_heap_stats(&stats);
+        peak = stats.top_chunks > peak ? stats.top_chunks : peak;
+    }
+
+    size_t live = 0;
+    for (size_t i = 0; i < HEAP_LIVE; i++)
+        live += ctx.sizes[i];
+    lzr_heap_cache_flush();
+    lzr_heap_stats(&stats);
+    bench_report_fragmentation("heap", name, live, (size_t) (peak - base), (size_t) stats.free_runs, stats.fragmentation);
+
+    for (size_t i = 0; i < HEAP_LIVE; i++)
+        lzr_heap_free(ctx.live[i]);
+    lzr_heap_cache_flush();
+}
+
+typedef struct {
+    lzr_thread_t thread;
+    heap_ctx_t ctx;
+    uint32_t* ready;
+    size_t num_threads;
+    double* samples;
+} heap_worker_t;
+
+// every thread churns its own live runs with its own cache, contending on the global heap
+// lock whenever the cache can't serve it. the cache is flushed before exiting like a scheduler would
+void heap_worker(void* arg) {
+    heap_worker_t* worker = (heap_worker_t*) arg;
+    heap_ctx_t* ctx = &worker->ctx;
+    for (size_t i = 0; i < HEAP_LIVE; i++)
+        ctx->live[i] = lzr_heap_alloc(ctx->max_chunks);
+
+    __atomic_fetch_add(worker->ready, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(worker->ready, __ATOMIC_ACQUIRE) != worker->num_threads)
+        lzr_cpu_relax();
+
+    for (size_t sample = 0; sample < bench_samples(); sample++) {
+        uint64_t start = lzr_time_now();
+        heap_churn(ctx, HEAP_BATCH);
+        worker->samples[sample] = (double) (lzr_time_now() - start) / HEAP_BATCH;
+    }
+
+    for (size_t i = 0; i < HEAP_LIVE; i++)
+        lzr_heap_free(ctx->live[i]);
+    lzr_heap_cache_flush();
+}
+
+void heap_threads(const char* prefix, uint16_t max_chunks, bool random, size_t num_threads) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s/threads=%zu", prefix, num_threads);
+    if (!bench_enabled("heap", name))
+        return;
+
+    static heap_worker_t workers[HEAP_MAX_THREADS];
+    size_t count = bench_samples();
+    double* samples = (double*) malloc(num_threads * count * sizeof(double));
+    uint32_t ready = 0;
+
+    for (size_t i = 0; i < num_threads; i++) {
+        workers[i].ctx.max_chunks = max_chunks;
+        workers[i].ctx.random = random;
+        workers[i].ctx.seed = 0x853c49e6748fea9bULL + i;
+        workers[i].ready = &ready;
+        workers[i].num_threads = num_threads;
+        workers[i].samples = &samples[i * count];
+        lzr_thread_spawn(&workers[i].thread, heap_worker, &workers[i]);
+    }
+    for (size_t i = 0; i < num_threads; i++)
+        lzr_thread_join(&workers[i].thread);
+
+    // ns/op is per thread, per_sec is the alloc/free pairs of all of them together
+    // over the time the slowest thread spent in its timed batches
+    double elapsed = 0;
+    for (size_t i = 0; i < num_threads; i++) {
+        double spent = 0;
+        for (size_t sample = 0; sample < count; sample++)
+            spent += samples[i * count + sample] * HEAP_BATCH;
+        elapsed = spent > elapsed ? spent : elapsed;
+    }
+    uint64_t ops = (uint64_t) (num_threads * count * HEAP_BATCH);
+    bench_report_rate("heap", name, samples, num_threads * count, ops, (double) ops * 1e9 / elapsed);
+    free(samples);
+}
+
+void bench_heap() {
+    // served by the thread's cache
+    heap_bench("churn_fixed/chunks=1", 1, false);
+    heap_bench("churn_fixed/chunks=8", 8, false);
+    // bigger than the cache so every op goes through the segregated free lists
+    heap_bench("churn_fixed/chunks=16", 16, false);
+    heap_bench("churn_random/chunks=1-4", 4, true);
+    heap_bench("churn_random/chunks=1-32", 32, true);
+    heap_fragmentation("fragmentation/chunks=1-4", 4);
+    heap_fragmentation("fragmentation/chunks=1-32", 32);
+
+    // the same churn from 1, 2, 4.. threads up to a thread per core
+    size_t max_threads = lzr_thread_cpu_count();
+    if (max_threads > HEAP_MAX_THREADS)
+        max_threads = HEAP_MAX_THREADS;
+    for (size_t num_threads = 1;; num_threads = num_threads * 2 < max_threads ? num_threads * 2 : max_threads) {
+        heap_threads("churn_fixed/chunks=1", 1, false, num_threads);
+        heap_threads("churn_random/chunks=1-4", 4, true, num_threads);
+        if (num_threads == max_threads)
+            break;
+    }
+}
@@ -0,0 +1,149 @@
+#include "bench.h"
+#include "runtime/slab.h"
+#include "runtime/sched/sched.h"
+#include "runtime/os/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ECHO_REQUEST_SIZE 64
+#define ECHO_REQUESTS 20000
+#define ECHO_MAX_CONNS 64
+
+#if defined(LZR_LINUX)
+    #include <unistd.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+
+    // one end of a connection: the client sends a request and waits for it to come back,
+    // the server sends back each request it receives. both stop after `requests`.
+    typedef struct {
+        lzr_io_t io;
+        bool client;
+        bool writing;
+        size_t offset;
+        size_t requests;
+        size_t completed;
+        uint64_t started;
+        double* latencies;
+        uint8_t buffer[ECHO_REQUEST_SIZE];
+    } echo_conn_t;
+
+    // the message is only ever a wakeup so it's handed back to the next wait
+    void echo_behavior(lzr_actor_t* actor, lzr_message_t* message) {
+        echo_conn_t* conn = (echo_conn_t*) actor->state;
+
+        while (conn->completed < conn->requests) {
+            if (conn->client && conn->writing && conn->offset == 0)
+                conn->started = lzr_time_now();
+
+            intptr_t transferred = conn->writing
+                ? lzr_io_write(&conn->io, conn->buffer + conn->offset, ECHO_REQUEST_SIZE - conn->offset)
+                : lzr_io_read(&conn->io, conn->buffer + conn->offset, ECHO_REQUEST_SIZE - conn->offset);
+            if (transferred == LZR_IO_AGAIN) {
+                lzr_io_wait(&conn->io, actor, conn->writing ? LZR_POLL_WRITE : LZR_POLL_READ, message);
+                return;
+            }
+
+            assert(transferred > 0);
+            conn->offset += (size_t) transferred;
+            if (conn->offset < ECHO_REQUEST_SIZE)
+                continue;
+
+            // a client's request is done once it's read back, a server's once it's written back
+            conn->offset = 0;
+            conn->writing = !conn->writing;
+            if (conn->client == conn->writing) {
+                if (conn->client)
+                    conn->latencies[conn->completed] = (double) (lzr_time_now() - conn->started);
+                conn->completed++;
+            }
+        }
+
+        lzr_slab_free((void*) message);
+    }
+
+    void echo_socket_pair(int listener, int* client, int* server) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        getsockname(listener, (struct sockaddr*) &addr, &addr_len);
+
+        // the listen backlog lets the connect finish before it's accepted
+        *client = socket(AF_INET, SOCK_STREAM, 0);
+        int connected = connect(*client, (struct sockaddr*) &addr, addr_len);
+        assert(connected == 0);
+        (void) connected;
+        *server = accept(listener, NULL, NULL);
+        assert(*server >= 0);
+
+        int nodelay = 1;
+        setsockopt(*client, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        setsockopt(*server, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+
+    void echo_bench(size_t num_conns) {
+        char name[32];
+        snprintf(name, sizeof(name), "echo/conns=%zu", num_conns);
+        if (!bench_enabled("io", name))
+            return;
+
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+        int bound = bind(listener, (struct sockaddr*) &addr, sizeof(addr));
+        assert(bound == 0);
+        (void) bound;
+        listen(listener, ECHO_MAX_CONNS);
+
+        size_t requests = ECHO_REQUESTS / num_conns;
+        double* latencies = (double*) malloc(num_conns * requests * sizeof(double));
+        echo_conn_t* conns = (echo_conn_t*) calloc(num_conns * 2, sizeof(echo_conn_t));
+        lzr_actor_t* actors[ECHO_MAX_CONNS * 2];
+
+        for (size_t i = 0; i < num_conns; i++) {
+            int client, server;
+            echo_socket_pair(listener, &client, &server);
+
+            echo_conn_t* conn = &conns[i * 2];
+            lzr_io_init(&conn[0].io, client);
+            conn[0].client = true;
+            conn[0].writing = true;
+            conn[0].latencies = &latencies[i * requests];
+            lzr_io_init(&conn[1].io, server);
+            conn[1].client = false;
+            conn[1].writing = false;
+
+            for (size_t end = 0; end < 2; end++) {
+                conn[end].requests = requests;
+                actors[i * 2 + end] = lzr_actor_spawn(echo_behavior, &conn[end]);
+                lzr_actor_send(actors[i * 2 + end], (lzr_message_t*) lzr_slab_alloc(sizeof(lzr_message_t)));
+            }
+        }
+
+        uint64_t start = lzr_time_now();
+        lzr_sched_run(0);
+        double elapsed = (double) (lzr_time_now() - start);
+
+        // ns/op is the round trip latency of one request, per_sec is across all connections
+        for (size_t i = 0; i < num_conns * 2; i++) {
+            assert(conns[i].completed == requests);
+            lzr_io_close(&conns[i].io);
+            lzr_actor_free(actors[i]);
+        }
+        close(listener);
+
+        size_t total = num_conns * requests;
+        bench_report_rate("io", name, latencies, total, total, (double) total * 1e9 / elapsed);
+        free(conns);
+        free(latencies);
+    }
+
+    void bench_io() {
+        for (size_t num_conns = 1; num_conns <= ECHO_MAX_CONNS; num_conns *= 4)
+            echo_bench(num_conns);
+    }
+
+#else
+    // sockets are only polled on linux (see os/poll.c)
+    void bench_io() {}
+
+#endif
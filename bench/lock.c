@@ -0,0 +1,109 @@
+#include "bench.h"
+#include "runtime/os/lock.h"
+#include "runtime/os/thread.h"
+#include "runtime/os/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LOCK_BATCH 1000
+#define LOCK_MAX_THREADS 64
+
+typedef struct {
+    lzr_mutex_t mutex;
+    uint64_t counter;
+    uint32_t ready;
+    uint32_t done;
+    size_t num_threads;
+    size_t samples;
+    double* results;
+} lock_ctx_t;
+
+typedef struct {
+    lzr_thread_t thread;
+    lock_ctx_t* ctx;
+    size_t index;
+    uint64_t acquired;
+} lock_worker_t;
+
+// each thread times its own batches of lock/increment/unlock, starting all at once.
+// it also counts its acquisitions until the first thread is done with all of its batches,
+// as until then every thread wants the lock and an unfair lock shows up as uneven counts
+void lock_worker(void* arg) {
+    lock_worker_t* worker = (lock_worker_t*) arg;
+    lock_ctx_t* ctx = worker->ctx;
+
+    __atomic_fetch_add(&ctx->ready, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&ctx->ready, __ATOMIC_ACQUIRE) != ctx->num_threads)
+        lzr_cpu_relax();
+
+    uint64_t acquired = 0;
+    double* samples = &ctx->results[worker->index * ctx->samples];
+    for (size_t sample = 0; sample < ctx->samples; sample++) {
+        uint64_t start = lzr_time_now();
+        for (size_t i = 0; i < LOCK_BATCH; i++) {
+            lzr_mutex_lock(&ctx->mutex);
+            ctx->counter++;
+            lzr_mutex_unlock(&ctx->mutex);
+            acquired += __atomic_load_n(&ctx->done, __ATOMIC_RELAXED) == 0;
+        }
+        samples[sample] = (double) (lzr_time_now() - start) / LOCK_BATCH;
+    }
+
+    __atomic_store_n(&ctx->done, 1, __ATOMIC_RELAXED);
+    worker->acquired = acquired;
+}
+
+void lock_bench(size_t num_threads) {
+    char name[32];
+    snprintf(name, sizeof(name), "mutex/threads=%zu", num_threads);
+    if (!bench_enabled("lock", name))
+        return;
+
+    static lock_ctx_t ctx;
+    static lock_worker_t workers[LOCK_MAX_THREADS];
+    lzr_mutex_init(&ctx.mutex);
+    ctx.counter = 0;
+    ctx.ready = 0;
+    ctx.done = 0;
+    ctx.num_threads = num_threads;
+    ctx.samples = bench_samples();
+    ctx.results = (double*) malloc(num_threads * ctx.samples * sizeof(double));
+
+    for (size_t i = 0; i < num_threads; i++) {
+        workers[i].ctx = &ctx;
+        workers[i].index = i;
+        lzr_thread_spawn(&workers[i].thread, lock_worker, &workers[i]);
+    }
+    for (size_t i = 0; i < num_threads; i++)
+        lzr_thread_join(&workers[i].thread);
+
+    // the slowest thread's time spent in its batches, before the samples get sorted
+    double elapsed = 0;
+    uint64_t min_acquired = UINT64_MAX;
+    uint64_t max_acquired = 0;
+    for (size_t i = 0; i < num_threads; i++) {
+        double spent = 0;
+        for (size_t sample = 0; sample < ctx.samples; sample++)
+            spent += ctx.results[i * ctx.samples + sample] * LOCK_BATCH;
+        elapsed = spent > elapsed ? spent : elapsed;
+        min_acquired = workers[i].acquired < min_acquired ? workers[i].acquired : min_acquired;
+        max_acquired = workers[i].acquired > max_acquired ? workers[i].acquired : max_acquired;
+    }
+
+    // ns/op is per thread: the time one thread waits for its lock/unlock to complete.
+    // per_sec is all of them together and fairness the fewest acquisitions over the most
+    assert(ctx.counter == num_threads * ctx.samples * LOCK_BATCH);
+    bench_report_fairness("lock", name, ctx.results, num_threads * ctx.samples, ctx.counter,
+        (double) ctx.counter * 1e9 / elapsed, min_acquired, max_acquired);
+    free(ctx.results);
+}
+
+void bench_lock() {
+    size_t max_threads = lzr_thread_cpu_count();
+    if (max_threads > LOCK_MAX_THREADS)
+        max_threads = LOCK_MAX_THREADS;
+
+    for (size_t num_threads = 1; num_threads < max_threads; num_threads *= 2)
+        lock_bench(num_threads);
+    lock_bench(max_threads);
+}
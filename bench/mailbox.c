@@ -0,0 +1,120 @@
+#include "bench.h"
+#include "runtime/slab.h"
+#include "runtime/sched/mailbox.h"
+#include "runtime/os/lock.h"
+#include "runtime/os/thread.h"
+#include "runtime/os/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAILBOX_MESSAGES (256 * 1024)
+#define MAILBOX_MAX_SENDERS 64
+
+/*
+1, 2, 4.. sender threads (up to one per core) pushing into a single mailbox drained by a
+receiver thread, without the schedulers. Senders allocate their messages before they all
+start at once and stamp each one right before pushing it. The samples are each message's
+latency from before its push to after the receiver popped it, per_sec is messages received.
+*/
+typedef struct {
+    lzr_message_t header;
+    uint64_t sent;
+} mailbox_message_t;
+
+typedef struct {
+    lzr_mailbox_t* mailbox;
+    uint32_t ready;
+    size_t num_threads;
+    size_t messages;
+    double* latencies;
+    double elapsed;
+} mailbox_ctx_t;
+
+typedef struct {
+    lzr_thread_t thread;
+    mailbox_ctx_t* ctx;
+    size_t messages;
+} mailbox_worker_t;
+
+void mailbox_start(mailbox_ctx_t* ctx) {
+    __atomic_fetch_add(&ctx->ready, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&ctx->ready, __ATOMIC_ACQUIRE) != ctx->num_threads)
+        lzr_cpu_relax();
+}
+
+void mailbox_sender(void* arg) {
+    mailbox_worker_t* worker = (mailbox_worker_t*) arg;
+    mailbox_message_t** messages = (mailbox_message_t**) malloc(worker->messages * sizeof(mailbox_message_t*));
+    for (size_t i = 0; i < worker->messages; i++)
+        messages[i] = (mailbox_message_t*) lzr_slab_alloc(sizeof(mailbox_message_t));
+
+    mailbox_start(worker->ctx);
+    for (size_t i = 0; i < worker->messages; i++) {
+        messages[i]->sent = lzr_time_now();
+        lzr_mailbox_push(worker->ctx->mailbox, &messages[i]->header);
+    }
+
+    free(messages);
+    lzr_slab_thread_flush();
+}
+
+void mailbox_receiver(void* arg) {
+    mailbox_worker_t* worker = (mailbox_worker_t*) arg;
+    mailbox_ctx_t* ctx = worker->ctx;
+
+    mailbox_start(ctx);
+    uint64_t start = lzr_time_now();
+    for (size_t received = 0; received < ctx->messages;) {
+        mailbox_message_t* message = (mailbox_message_t*) lzr_mailbox_pop(ctx->mailbox);
+        if (message == NULL) {
+            lzr_cpu_relax();
+            continue;
+        }
+        ctx->latencies[received++] = (double) (lzr_time_now() - message->sent);
+        lzr_slab_free((void*) message);
+    }
+
+    ctx->elapsed = (double) (lzr_time_now() - start);
+    lzr_slab_thread_flush();
+}
+
+void mailbox_bench(size_t num_senders) {
+    char name[32];
+    snprintf(name, sizeof(name), "push_pop/senders=%zu", num_senders);
+    if (!bench_enabled("mailbox", name))
+        return;
+
+    static mailbox_ctx_t ctx;
+    static mailbox_worker_t workers[MAILBOX_MAX_SENDERS + 1];
+    ctx.mailbox = (lzr_mailbox_t*) lzr_slab_alloc(sizeof(lzr_mailbox_t));
+    lzr_mailbox_init(ctx.mailbox);
+    ctx.ready = 0;
+    ctx.num_threads = num_senders + 1;
+    ctx.messages = (MAILBOX_MESSAGES / num_senders) * num_senders;
+    ctx.latencies = (double*) malloc(ctx.messages * sizeof(double));
+
+    workers[0].ctx = &ctx;
+    lzr_thread_spawn(&workers[0].thread, mailbox_receiver, &workers[0]);
+    for (size_t i = 1; i <= num_senders; i++) {
+        workers[i].ctx = &ctx;
+        workers[i].messages = ctx.messages / num_senders;
+        lzr_thread_spawn(&workers[i].thread, mailbox_sender, &workers[i]);
+    }
+    for (size_t i = 0; i <= num_senders; i++)
+        lzr_thread_join(&workers[i].thread);
+
+    assert(lzr_mailbox_empty(ctx.mailbox));
+    bench_report_rate("mailbox", name, ctx.latencies, ctx.messages, ctx.messages, (double) ctx.messages * 1e9 / ctx.elapsed);
+    free(ctx.latencies);
+    lzr_slab_free((void*) ctx.mailbox);
+}
+
+void bench_mailbox() {
+    size_t max_senders = lzr_thread_cpu_count();
+    if (max_senders > MAILBOX_MAX_SENDERS)
+        max_senders = MAILBOX_MAX_SENDERS;
+
+    for (size_t num_senders = 1; num_senders < max_senders; num_senders *= 2)
+        mailbox_bench(num_senders);
+    mailbox_bench(max_senders);
+}
@@ -0,0 +1,204 @@
+#include "bench.h"
+#include "runtime/map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAP_MAX_KEYS (1000 * 1000)
+#define MAP_NEW_KEYS 4096
+#define MAP_BATCH 1000
+#define MAP_KEY_SIZE 32
+
+/*
+Lazer's maps against the simplest immutable map: a sorted array of keys and one of values,
+found by binary search and copied whole on every put. Both are keyed by atoms. Puts are
+persistent, each one going into the same map of `keys` keys and the result thrown away.
+*/
+typedef struct {
+    lzr_term_t* keys;
+    lzr_term_t* new_keys;
+    size_t* order;
+    size_t num_keys;
+    size_t next_key;
+    lzr_arena_t arena;
+    lzr_term_t map;
+    lzr_term_t* array_keys;
+    lzr_term_t* array_values;
+} map_ctx_t;
+
+static map_ctx_t map;
+
+lzr_term_t map_key(const char* prefix, size_t index) {
+    char key[MAP_KEY_SIZE];
+    size_t key_len = (size_t) snprintf(key, sizeof(key), "%s_%zu", prefix, index);
+    return lzr_term_from_atom(lzr_atom_table_upsert(bench_atoms(), key, key_len));
+}
+
+int map_compare(const void* left, const void* right) {
+    lzr_term_t a = *(const lzr_term_t*) left;
+    lzr_term_t b = *(const lzr_term_t*) right;
+    return (a > b) - (a < b);
+}
+
+// puts which ran out of arena collect with the map as the only root and try again
+lzr_term_t map_put(lzr_term_t key, lzr_term_t value) {
+    lzr_term_t result = lzr_map_put(&map.arena, map.map, key, value);
+    if (result == LZR_NIL) {
+        uint32_t* roots[] = { &map.map };
+        lzr_arena_collect(&map.arena, roots, 1, LZR_MAP_PUT_RESERVE);
+        result = lzr_map_put(&map.arena, map.map, key, value);
+        assert(result != LZR_NIL);
+    }
+    return result;
+}
+
+size_t array_search(lzr_term_t key) {
+    size_t low = 0;
+    size_t high = map.num_keys;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (map.array_keys[mid] < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+void map_find(void* ctx, size_t iters) {
+    uint64_t found = 0;
+    for (size_t i = 0; i < iters; i++) {
+        lzr_term_t value = LZR_NIL;
+        lzr_map_find(map.map, map.keys[map.order[i % map.num_keys]], &value);
+        found += value;
+    }
+    bench_sink(found);
+}
+
+void array_find(void* ctx, size_t iters) {
+    uint64_t found = 0;
+    for (size_t i = 0; i < iters; i++) {
+        size_t index = array_search(map.keys[map.order[i % map.num_keys]]);
+        found += map.array_values[index];
+    }
+    bench_sink(found);
+}
+
+void map_insert(void* ctx, size_t iters) {
+    uint64_t puts = 0;
+    for (size_t i = 0; i < iters; i++) {
+        lzr_term_t key = map.new_keys[map.next_key++ % MAP_NEW_KEYS];
+        puts += map_put(key, lzr_term_from_small(i));
+    }
+    bench_sink(puts);
+}
+
+void array_insert(void* ctx, size_t iters) {
+    uint64_t puts = 0;
+    for (size_t i = 0; i < iters; i++) {
+        lzr_term_t key = map.new_keys[map.next_key++ % MAP_NEW_KEYS];
+        size_t index = array_search(key);
+        size_t count = map.num_keys;
+
+        lzr_term_t* keys = (lzr_term_t*) malloc((count + 1) * sizeof(lzr_term_t));
+        lzr_term_t* values = (lzr_term_t*) malloc((count + 1) * sizeof(lzr_term_t));
+        memcpy(keys, map.array_keys, index * sizeof(lzr_term_t));
+        memcpy(values, map.array_values, index * sizeof(lzr_term_t));
+        keys[index] = key;
+        values[index] = lzr_term_from_small(i);
+        memcpy(keys + index + 1, map.array_keys + index, (count - index) * sizeof(lzr_term_t));
+        memcpy(values + index + 1, map.array_values + index, (count - index) * sizeof(lzr_term_t));
+
+        puts += keys[count];
+        free(keys);
+        free(values);
+    }
+    bench_sink(puts);
+}
+
+// returns whether any of them are enabled
+bool map_bench_names(size_t num_keys, char full_names[6][64]) {
+    const char* names[] = { "find", "find_array", "put", "put_array", "memory", "memory_array" };
+    bool enabled = false;
+    for (size_t i = 0; i < 6; i++) {
+        snprintf(full_names[i], 64, "%s/keys=%zu", names[i], num_keys);
+        enabled |= bench_enabled("map", full_names[i]);
+    }
+    return enabled;
+}
+
+void map_bench(size_t num_keys) {
+    char full_names[6][64];
+    if (!map_bench_names(num_keys, full_names))
+        return;
+
+    map.num_keys = num_keys;
+    lzr_arena_init(&map.arena);
+    map.map = lzr_map_new(&map.arena);
+    if (map.map == LZR_NIL) {
+        lzr_arena_collect(&map.arena, NULL, 0, LZR_MAP_PUT_RESERVE);
+        map.map = lzr_map_new(&map.arena);
+    }
+    for (size_t i = 0; i < num_keys; i++)
+        map.map = map_put(map.keys[i], lzr_term_from_small(i));
+    assert(lzr_map_size(map.map) == num_keys);
+
+    // a collection with just the map as a root leaves exactly the map behind
+    uint32_t* roots[] = { &map.map };
+    lzr_arena_collect(&map.arena, roots, 1, LZR_MAP_PUT_RESERVE);
+    bench_report_memory("map", full_names[4], num_keys, map.arena.live);
+    bench_report_memory("map", full_names[5], num_keys, 2 * num_keys * sizeof(lzr_term_t));
+
+    for (size_t i = 0; i < num_keys; i++) {
+        map.array_keys[i] = map.keys[i];
+        map.order[i] = i;
+    }
+    qsort(map.array_keys, num_keys, sizeof(lzr_term_t), map_compare);
+    for (size_t i = 0; i < num_keys; i++)
+        map.array_values[i] = lzr_term_from_small(i);
+
+    uint64_t seed = 0x2545f4914f6cdd1dULL;
+    for (size_t i = num_keys - 1; i > 0; i--) {
+        size_t j = bench_random(&seed) % (i + 1);
+        size_t swap = map.order[i];
+        map.order[i] = map.order[j];
+        map.order[j] = swap;
+    }
+
+    // copying the whole array on every put gets slow quickly, so put fewer
+    size_t array_batch = num_keys >= 100 * 1000 ? 1 : MAP_BATCH / 10;
+    bench_run("map", full_names[0], map_find, NULL, MAP_BATCH);
+    bench_run("map", full_names[1], array_find, NULL, MAP_BATCH);
+    bench_run("map", full_names[2], map_insert, NULL, MAP_BATCH);
+    bench_run("map", full_names[3], array_insert, NULL, array_batch);
+    lzr_arena_destroy(&map.arena);
+}
+
+void bench_map() {
+    map.keys = (lzr_term_t*) malloc(MAP_MAX_KEYS * sizeof(lzr_term_t));
+    map.new_keys = (lzr_term_t*) malloc(MAP_NEW_KEYS * sizeof(lzr_term_t));
+    map.order = (size_t*) malloc(MAP_MAX_KEYS * sizeof(size_t));
+    map.array_keys = (lzr_term_t*) malloc(MAP_MAX_KEYS * sizeof(lzr_term_t));
+    map.array_values = (lzr_term_t*) malloc(MAP_MAX_KEYS * sizeof(lzr_term_t));
+
+    // every size shares the same keys so only the biggest one has to intern them all
+    size_t max_keys = 0;
+    char full_names[6][64];
+    for (size_t num_keys = 10; num_keys <= MAP_MAX_KEYS; num_keys *= 10)
+        if (map_bench_names(num_keys, full_names))
+            max_keys = num_keys;
+    for (size_t i = 0; i < max_keys; i++)
+        map.keys[i] = map_key("bench_map", i);
+    for (size_t i = 0; i < MAP_NEW_KEYS; i++)
+        map.new_keys[i] = map_key("bench_map_new", i);
+
+    for (size_t num_keys = 10; num_keys <= max_keys; num_keys *= 10)
+        map_bench(num_keys);
+
+    free(map.keys);
+    free(map.new_keys);
+    free(map.order);
+    free(map.array_keys);
+    free(map.array_values);
+}
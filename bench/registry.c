@@ -0,0 +1,100 @@
+#include "bench.h"
+#include "runtime/slab.h"
+#include "runtime/sched/sched.h"
+#include <stdio.h>
+
+#define REGISTRY_MAX_NAMES 16
+#define REGISTRY_CLIENTS 256
+#define REGISTRY_SENDS 64
+#define REGISTRY_KEY_SIZE 32
+
+typedef struct {
+    char keys[REGISTRY_MAX_NAMES][REGISTRY_KEY_SIZE];
+    size_t key_lens[REGISTRY_MAX_NAMES];
+    lzr_actor_t* servers[REGISTRY_MAX_NAMES];
+    lzr_actor_t* clients[REGISTRY_CLIENTS];
+    size_t num_names;
+    size_t sends;
+    bool named;
+} registry_ctx_t;
+
+static registry_ctx_t registry;
+
+void registry_server(lzr_actor_t* actor, lzr_message_t* message) {
+    (*(uint64_t*) actor->state)++;
+    lzr_slab_free((void*) message);
+}
+
+// every send resolves the name from its text like a send to a registered name would
+void registry_client(lzr_actor_t* actor, lzr_message_t* message) {
+    size_t client = (size_t) actor->state;
+    lzr_slab_free((void*) message);
+
+    for (size_t i = 0; i < registry.sends; i++) {
+        size_t name = (client + i) % registry.num_names;
+        lzr_actor_t* server = registry.servers[name];
+        if (registry.named) {
+            lzr_atom_t* atom = lzr_atom_table_find(bench_atoms(), registry.keys[name], registry.key_lens[name]);
+            server = lzr_actor_whereis(atom);
+        }
+        lzr_actor_send(server, (lzr_message_t*) lzr_slab_alloc(sizeof(lzr_message_t)));
+    }
+}
+
+// kick off every client and run the schedulers until all their messages were received
+void registry_send(void* ctx, size_t iters) {
+    registry.sends = iters / REGISTRY_CLIENTS;
+    for (size_t i = 0; i < REGISTRY_CLIENTS; i++)
+        lzr_actor_send(registry.clients[i], (lzr_message_t*) lzr_slab_alloc(sizeof(lzr_message_t)));
+    lzr_sched_run(0);
+}
+
+void registry_whereis(void* ctx, size_t iters) {
+    size_t found = 0;
+    for (size_t i = 0; i < iters; i++) {
+        size_t name = i % registry.num_names;
+        lzr_atom_t* atom = lzr_atom_table_find(bench_atoms(), registry.keys[name], registry.key_lens[name]);
+        found += (size_t) lzr_actor_whereis(atom);
+    }
+    bench_sink(found);
+}
+
+void registry_bench(size_t num_names, bool named) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s/names=%zu", named ? "send_named" : "send_direct", num_names);
+    if (!bench_enabled("registry", name))
+        return;
+
+    registry.num_names = num_names;
+    registry.named = named;
+    bench_run("registry", name, registry_send, NULL, REGISTRY_CLIENTS * REGISTRY_SENDS);
+}
+
+void bench_registry() {
+    static uint64_t received[REGISTRY_MAX_NAMES];
+    for (size_t i = 0; i < REGISTRY_MAX_NAMES; i++) {
+        registry.key_lens[i] = (size_t) snprintf(registry.keys[i], REGISTRY_KEY_SIZE, "bench_server_%zu", i);
+        registry.servers[i] = lzr_actor_spawn(registry_server, &received[i]);
+        lzr_atom_t* atom = lzr_atom_table_upsert(bench_atoms(), registry.keys[i], registry.key_lens[i]);
+        bool registered = lzr_actor_register(atom, registry.servers[i]);
+        assert(registered);
+        (void) registered;
+    }
+    for (size_t i = 0; i < REGISTRY_CLIENTS; i++)
+        registry.clients[i] = lzr_actor_spawn(registry_client, (void*) i);
+
+    registry.num_names = 4;
+    if (bench_enabled("registry", "whereis/names=4"))
+        bench_run("registry", "whereis/names=4", registry_whereis, NULL, 10000);
+
+    // a single name is the worst case: every client sends to the same mailbox
+    registry_bench(1, true);
+    registry_bench(4, true);
+    registry_bench(16, true);
+    registry_bench(4, false);
+
+    for (size_t i = 0; i < REGISTRY_CLIENTS; i++)
+        lzr_actor_free(registry.clients[i]);
+    for (size_t i = 0; i < REGISTRY_MAX_NAMES; i++)
+        lzr_actor_free(registry.servers[i]);
+}
@@ -0,0 +1,135 @@
+#include "bench.h"
+#include "runtime/slab.h"
+#include "runtime/sched/sched.h"
+#include "runtime/os/thread.h"
+#include "runtime/os/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SCHED_MESSAGES (64 * 1024)
+#define SCHED_RING 64
+#define SCHED_TOKENS 16
+#define SCHED_FANOUT 64
+#define SCHED_MAX_THREADS 64
+
+/*
+Message passing through the schedulers at 1, 2, 4.. of them up to one per core.
+`ping_ring` passes SCHED_TOKENS tokens around a ring of SCHED_RING actors at once so several
+actors are runnable and the schedulers have something to steal. `fan_out` has one actor send
+to SCHED_FANOUT others which all reply to it, starting the next round once every reply is in,
+so the schedulers keep going idle and getting woken up. Each run is SCHED_MESSAGES messages.
+*/
+typedef struct {
+    lzr_message_t header;
+    uint32_t hops;
+} sched_message_t;
+
+typedef struct {
+    lzr_actor_t* ring[SCHED_RING];
+    lzr_actor_t* root;
+    lzr_actor_t* leaves[SCHED_FANOUT];
+    size_t rounds;
+    size_t replies;
+} sched_ctx_t;
+
+static sched_ctx_t sched_bench_ctx;
+
+sched_message_t* sched_message(uint32_t hops) {
+    sched_message_t* msg = (sched_message_t*) lzr_slab_alloc(sizeof(sched_message_t));
+    msg->hops = hops;
+    return msg;
+}
+
+// pass the token on to the next actor in the ring until it's out of hops
+void sched_ring_hop(lzr_actor_t* actor, lzr_message_t* message) {
+    sched_message_t* msg = (sched_message_t*) message;
+    if (--msg->hops == 0) {
+        lzr_slab_free((void*) message);
+        return;
+    }
+    size_t next = ((size_t) actor->state + 1) % SCHED_RING;
+    lzr_actor_send(sched_bench_ctx.ring[next], message);
+}
+
+void sched_ping_ring() {
+    for (size_t i = 0; i < SCHED_TOKENS; i++) {
+        size_t start = (i * SCHED_RING) / SCHED_TOKENS;
+        lzr_actor_send(sched_bench_ctx.ring[start], &sched_message(SCHED_MESSAGES / SCHED_TOKENS)->header);
+    }
+}
+
+// a round is a message to every leaf and one back from each
+void sched_fan_round() {
+    sched_bench_ctx.rounds--;
+    sched_bench_ctx.replies = 0;
+    for (size_t i = 0; i < SCHED_FANOUT; i++)
+        lzr_actor_send(sched_bench_ctx.leaves[i], &sched_message(0)->header);
+}
+
+void sched_fan_root(lzr_actor_t* actor, lzr_message_t* message) {
+    lzr_slab_free((void*) message);
+    if (++sched_bench_ctx.replies == SCHED_FANOUT && sched_bench_ctx.rounds > 0)
+        sched_fan_round();
+}
+
+void sched_fan_leaf(lzr_actor_t* actor, lzr_message_t* message) {
+    lzr_actor_send(sched_bench_ctx.root, message);
+}
+
+// the first round is sent from outside the schedulers, the root starts all the others
+void sched_fan_out() {
+    sched_bench_ctx.rounds = SCHED_MESSAGES / (2 * SCHED_FANOUT);
+    sched_fan_round();
+}
+
+void sched_bench(const char* prefix, void (*kick)(), size_t num_threads) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s/threads=%zu", prefix, num_threads);
+    if (!bench_enabled("sched", name))
+        return;
+
+    // one untimed run to warm up the slabs and the schedulers' threads
+    kick();
+    lzr_sched_run(num_threads);
+
+    size_t count = bench_samples();
+    double* samples = (double*) malloc(count * sizeof(double));
+    double elapsed = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t start = lzr_time_now();
+        kick();
+        lzr_sched_run(num_threads);
+        uint64_t end = lzr_time_now();
+        samples[i] = (double) (end - start) / SCHED_MESSAGES;
+        elapsed += (double) (end - start);
+    }
+
+    // ns/op is per message including starting & stopping the schedulers, per_sec is messages
+    uint64_t ops = (uint64_t) count * SCHED_MESSAGES;
+    bench_report_rate("sched", name, samples, count, ops, (double) ops * 1e9 / elapsed);
+    free(samples);
+}
+
+void bench_sched() {
+    for (size_t i = 0; i < SCHED_RING; i++)
+        sched_bench_ctx.ring[i] = lzr_actor_spawn(sched_ring_hop, (void*) i);
+    sched_bench_ctx.root = lzr_actor_spawn(sched_fan_root, NULL);
+    for (size_t i = 0; i < SCHED_FANOUT; i++)
+        sched_bench_ctx.leaves[i] = lzr_actor_spawn(sched_fan_leaf, NULL);
+
+    size_t max_threads = lzr_thread_cpu_count();
+    if (max_threads > SCHED_MAX_THREADS)
+        max_threads = SCHED_MAX_THREADS;
+    for (size_t num_threads = 1;; num_threads = num_threads * 2 < max_threads ? num_threads * 2 : max_threads) {
+        sched_bench("ping_ring", sched_ping_ring, num_threads);
+        sched_bench("fan_out", sched_fan_out, num_threads);
+        if (num_threads == max_threads)
+            break;
+    }
+
+    for (size_t i = 0; i < SCHED_RING; i++)
+        lzr_actor_free(sched_bench_ctx.ring[i]);
+    lzr_actor_free(sched_bench_ctx.root);
+    for (size_t i = 0; i < SCHED_FANOUT; i++)
+        lzr_actor_free(sched_bench_ctx.leaves[i]);
+}
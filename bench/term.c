@@ -0,0 +1,235 @@
+#include "bench.h"
+#include "runtime/term.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TERM_LIST_LEN 1000
+#define TERM_TUPLES 1000
+#define TERM_ARITY 4
+#define TERM_NAIVE_SIZE (1024 * 1024)
+#define TERM_RESERVE (256 * 1024)
+
+/*
+Lazer's 32-bit terms against the same objects with 64-bit pointer terms: an 8-byte header
+(size, refs & type like lzr_object_t) followed by 8-byte fields, 16-byte aligned and bump
+allocated from a buffer. Lists are TERM_LIST_LEN small integers, tuples are TERM_TUPLES
+{N, N, N, N} tuples. An op is building or reading one element or one tuple.
+Lazer's builds include collecting the arena whenever it fills up, which moves to fresh space
+each time, while the naive builds keep reusing the same buffer. The reads compare the layouts.
+*/
+typedef struct {
+    uint32_t size;
+    uint16_t refs;
+    uint16_t type;
+    uint64_t fields[];
+} naive_object_t;
+
+typedef struct {
+    lzr_arena_t arena;
+    lzr_term_t root;
+    lzr_term_t tuples[TERM_TUPLES];
+    char* naive;
+    char* naive_top;
+    uint64_t naive_root;
+    uint64_t naive_tuples[TERM_TUPLES];
+} term_ctx_t;
+
+static term_ctx_t term;
+
+#define NAIVE_SMALL(value) ((((uint64_t) (value)) << 1) | 1)
+#define NAIVE_NIL ((uint64_t) 0)
+
+naive_object_t* naive_alloc(size_t num_fields, uint16_t type) {
+    size_t size = (sizeof(naive_object_t) + num_fields * sizeof(uint64_t) + 15) & ~((size_t) 15);
+    naive_object_t* object = (naive_object_t*) term.naive_top;
+    term.naive_top += size;
+    assert(term.naive_top <= term.naive + TERM_NAIVE_SIZE);
+    object->size = (uint32_t) size;
+    object->refs = (uint16_t) num_fields;
+    object->type = type;
+    return object;
+}
+
+// the arena is collected with nothing live whenever it runs out, so building starts over
+lzr_term_t term_cons(lzr_term_t head, lzr_term_t tail) {
+    lzr_term_t cons = lzr_cons_new(&term.arena, head, tail);
+    if (cons == LZR_NIL) {
+        lzr_term_t* roots[] = { &tail };
+        lzr_arena_collect(&term.arena, roots, 1, TERM_RESERVE);
+        cons = lzr_cons_new(&term.arena, head, tail);
+        assert(cons != LZR_NIL);
+    }
+    return cons;
+}
+
+lzr_term_t term_tuple() {
+    lzr_term_t tuple = lzr_tuple_new(&term.arena, TERM_ARITY);
+    if (tuple == LZR_NIL) {
+        lzr_arena_collect(&term.arena, NULL, 0, TERM_RESERVE);
+        tuple = lzr_tuple_new(&term.arena, TERM_ARITY);
+        assert(tuple != LZR_NIL);
+    }
+    return tuple;
+}
+
+void term_list_build(void* ctx, size_t iters) {
+    lzr_term_t list = LZR_NIL;
+    for (size_t i = 0; i < iters; i++)
+        list = term_cons(lzr_term_from_small(i % TERM_LIST_LEN), i % TERM_LIST_LEN == 0 ? LZR_NIL : list);
+    bench_sink(list);
+}
+
+void naive_list_build(void* ctx, size_t iters) {
+    uint64_t list = NAIVE_NIL;
+    for (size_t i = 0; i < iters; i++) {
+        if (i % TERM_LIST_LEN == 0) {
+            term.naive_top = term.naive;
+            list = NAIVE_NIL;
+        }
+        naive_object_t* cons = naive_alloc(2, LZR_TYPE_CONS);
+        cons->fields[0] = NAIVE_SMALL(i % TERM_LIST_LEN);
+        cons->fields[1] = list;
+        list = (uint64_t) cons;
+    }
+    bench_sink(list);
+}
+
+void term_list_sum(void* ctx, size_t iters) {
+    int64_t sum = 0;
+    lzr_term_t list = term.root;
+    for (size_t i = 0; i < iters; i++) {
+        if (lzr_term_is_nil(list))
+            list = term.root;
+        sum += lzr_term_to_small(lzr_cons_head(list));
+        list = lzr_cons_tail(list);
+    }
+    bench_sink((uint64_t) sum);
+}
+
+void naive_list_sum(void* ctx, size_t iters) {
+    int64_t sum = 0;
+    uint64_t list = term.naive_root;
+    for (size_t i = 0; i < iters; i++) {
+        if (list == NAIVE_NIL)
+            list = term.naive_root;
+        naive_object_t* cons = (naive_object_t*) list;
+        sum += ((int64_t) cons->fields[0]) >> 1;
+        list = cons->fields[1];
+    }
+    bench_sink((uint64_t) sum);
+}
+
+void term_tuple_build(void* ctx, size_t iters) {
+    lzr_term_t tuple = LZR_NIL;
+    for (size_t i = 0; i < iters; i++) {
+        tuple = term_tuple();
+        for (size_t field = 0; field < TERM_ARITY; field++)
+            lzr_tuple_elements(tuple)[field] = lzr_term_from_small(i);
+    }
+    bench_sink(tuple);
+}
+
+void naive_tuple_build(void* ctx, size_t iters) {
+    naive_object_t* tuple = NULL;
+    for (size_t i = 0; i < iters; i++) {
+        if (i % TERM_TUPLES == 0)
+            term.naive_top = term.naive;
+        tuple = naive_alloc(TERM_ARITY, LZR_TYPE_TUPLE);
+        for (size_t field = 0; field < TERM_ARITY; field++)
+            tuple->fields[field] = NAIVE_SMALL(i);
+    }
+    bench_sink((uint64_t) tuple);
+}
+
+void term_tuple_read(void* ctx, size_t iters) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < iters; i++) {
+        lzr_term_t* elements = lzr_tuple_elements(term.tuples[i % TERM_TUPLES]);
+        for (size_t field = 0; field < TERM_ARITY; field++)
+            sum += lzr_term_to_small(elements[field]);
+    }
+    bench_sink((uint64_t) sum);
+}
+
+void naive_tuple_read(void* ctx, size_t iters) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < iters; i++) {
+        naive_object_t* tuple = (naive_object_t*) term.naive_tuples[i % TERM_TUPLES];
+        for (size_t field = 0; field < TERM_ARITY; field++)
+            sum += ((int64_t) tuple->fields[field]) >> 1;
+    }
+    bench_sink((uint64_t) sum);
+}
+
+// build the list & tuples the read benchmarks walk with both layouts, from empty spaces so
+// how far each bump pointer moved is the memory they take
+void term_build() {
+    lzr_arena_collect(&term.arena, NULL, 0, TERM_RESERVE);
+    char* top = term.arena.top;
+    term.root = LZR_NIL;
+    for (size_t i = TERM_LIST_LEN; i-- > 0;)
+        term.root = lzr_cons_new(&term.arena, lzr_term_from_small(i), term.root);
+    size_t list_bytes = (size_t) (term.arena.top - top);
+
+    top = term.arena.top;
+    for (size_t i = 0; i < TERM_TUPLES; i++) {
+        term.tuples[i] = lzr_tuple_new(&term.arena, TERM_ARITY);
+        for (size_t field = 0; field < TERM_ARITY; field++)
+            lzr_tuple_elements(term.tuples[i])[field] = lzr_term_from_small(i + field);
+    }
+    size_t tuple_bytes = (size_t) (term.arena.top - top);
+    assert(term.root != LZR_NIL && term.tuples[TERM_TUPLES - 1] != LZR_NIL);
+
+    term.naive_top = term.naive;
+    term.naive_root = NAIVE_NIL;
+    for (size_t i = TERM_LIST_LEN; i-- > 0;) {
+        naive_object_t* cons = naive_alloc(2, LZR_TYPE_CONS);
+        cons->fields[0] = NAIVE_SMALL(i);
+        cons->fields[1] = term.naive_root;
+        term.naive_root = (uint64_t) cons;
+    }
+    size_t naive_list_bytes = (size_t) (term.naive_top - term.naive);
+
+    // the tuples go after the list so the list stays valid
+    char* naive_top = term.naive_top;
+    for (size_t i = 0; i < TERM_TUPLES; i++) {
+        naive_object_t* tuple = naive_alloc(TERM_ARITY, LZR_TYPE_TUPLE);
+        for (size_t field = 0; field < TERM_ARITY; field++)
+            tuple->fields[field] = NAIVE_SMALL(i + field);
+        term.naive_tuples[i] = (uint64_t) tuple;
+    }
+    size_t naive_tuple_bytes = (size_t) (term.naive_top - naive_top);
+
+    char name[64];
+    snprintf(name, sizeof(name), "memory/list/len=%d", TERM_LIST_LEN);
+    if (bench_enabled("term", name))
+        bench_report_memory("term", name, TERM_LIST_LEN, list_bytes);
+    snprintf(name, sizeof(name), "memory/list_naive64/len=%d", TERM_LIST_LEN);
+    if (bench_enabled("term", name))
+        bench_report_memory("term", name, TERM_LIST_LEN, naive_list_bytes);
+    snprintf(name, sizeof(name), "memory/tuple/arity=%d", TERM_ARITY);
+    if (bench_enabled("term", name))
+        bench_report_memory("term", name, TERM_TUPLES, tuple_bytes);
+    snprintf(name, sizeof(name), "memory/tuple_naive64/arity=%d", TERM_ARITY);
+    if (bench_enabled("term", name))
+        bench_report_memory("term", name, TERM_TUPLES, naive_tuple_bytes);
+}
+
+void bench_term() {
+    lzr_arena_init(&term.arena);
+    term.naive = (char*) aligned_alloc(16, TERM_NAIVE_SIZE);
+    term_build();
+
+    // the naive build benchmarks bump from the start of the buffer again, after the reads
+    bench_run("term", "list_sum", term_list_sum, NULL, 10000);
+    bench_run("term", "list_sum_naive64", naive_list_sum, NULL, 10000);
+    bench_run("term", "tuple_read", term_tuple_read, NULL, 10000);
+    bench_run("term", "tuple_read_naive64", naive_tuple_read, NULL, 10000);
+    bench_run("term", "list_build", term_list_build, NULL, 10000);
+    bench_run("term", "list_build_naive64", naive_list_build, NULL, 10000);
+    bench_run("term", "tuple_build", term_tuple_build, NULL, 10000);
+    bench_run("term", "tuple_build_naive64", naive_tuple_build, NULL, 10000);
+
+    lzr_arena_destroy(&term.arena);
+    free(term.naive);
+}
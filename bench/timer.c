@@ -0,0 +1,75 @@
+#include "bench.h"
+#include "runtime/slab.h"
+#include "runtime/sched/sched.h"
+#include "runtime/os/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TIMER_BATCH 1000
+#define TIMER_DELAY (50ULL * 1000 * 1000)
+#define TIMER_TIMEOUT (3600ULL * 1000 * 1000 * 1000)
+
+typedef struct {
+    size_t armed;
+    size_t samples;
+    double* results;
+    lzr_timer_t** background;
+} timer_ctx_t;
+
+// like a `receive ... after 50` which gets its message in time: arm the timeout and cancel it.
+// `armed` other timers are kept on the wheel throughout to show that neither depends on how many there are.
+void timer_arm_cancel(lzr_actor_t* actor, lzr_message_t* message) {
+    timer_ctx_t* ctx = (timer_ctx_t*) actor->state;
+    lzr_message_t* timeout = (lzr_message_t*) lzr_slab_alloc(sizeof(lzr_message_t));
+
+    for (size_t i = 0; i < ctx->armed; i++)
+        ctx->background[i] = lzr_timer_send_after(actor, timeout, TIMER_TIMEOUT + i * 1000);
+
+    for (size_t sample = 0; sample < ctx->samples; sample++) {
+        uint64_t start = lzr_time_now();
+        for (size_t i = 0; i < TIMER_BATCH; i++) {
+            lzr_timer_t* timer = lzr_timer_send_after(actor, timeout, TIMER_DELAY);
+            bool cancelled = lzr_timer_cancel(timer, &timeout);
+            assert(cancelled);
+            (void) cancelled;
+        }
+        ctx->results[sample] = (double) (lzr_time_now() - start) / TIMER_BATCH;
+    }
+
+    for (size_t i = 0; i < ctx->armed; i++)
+        lzr_timer_cancel(ctx->background[i], NULL);
+    lzr_slab_free((void*) timeout);
+    lzr_slab_free((void*) message);
+}
+
+void timer_bench(size_t armed) {
+    char name[64];
+    snprintf(name, sizeof(name), "arm_cancel/armed=%zu", armed);
+    if (!bench_enabled("timer", name))
+        return;
+
+    timer_ctx_t ctx;
+    ctx.armed = armed;
+    ctx.samples = bench_samples();
+    ctx.results = (double*) malloc(ctx.samples * sizeof(double));
+    ctx.background = (lzr_timer_t**) malloc((armed + 1) * sizeof(lzr_timer_t*));
+
+    lzr_actor_t* actor = lzr_actor_spawn(timer_arm_cancel, &ctx);
+    lzr_actor_send(actor, (lzr_message_t*) lzr_slab_alloc(sizeof(lzr_message_t)));
+    lzr_sched_run(1);
+    lzr_actor_free(actor);
+
+    // per_sec is how many timers one scheduler can arm and cancel a second
+    double mean = 0;
+    for (size_t i = 0; i < ctx.samples; i++)
+        mean += ctx.results[i];
+    mean /= (double) ctx.samples;
+    bench_report_rate("timer", name, ctx.results, ctx.samples, ctx.samples * TIMER_BATCH, 1e9 / mean);
+    free(ctx.background);
+    free(ctx.results);
+}
+
+void bench_timer() {
+    timer_bench(0);
+    timer_bench(100000);
+}
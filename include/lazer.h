@@ -5,4 +5,60 @@
 #include <stddef.h>
 #include <stdbool.h>
 
-#endif // LAZER_H
\ No newline at end of file
+/*
+Runtime statistics. The event counters (allocations, lookups, probe lengths, commits)
+are kept per thread and summed on read, and are only collected when built with
+LAZER_STATS (which defines LZR_STATS). Otherwise they always read as zero.
+Everything else is computed when the snapshot is taken so it's always available.
+*/
+
+// histograms bucket by powers of two: [1], [2,3], [4,7], ... with the last one open ended
+#define LZR_STATS_BUCKETS 8
+
+typedef struct {
+    uint64_t acquired;
+    uint64_t contended;
+    uint64_t parked;
+} lzr_stats_lock_t;
+
+typedef struct {
+    uint64_t committed_bytes;
+    uint64_t top_chunks;
+    uint64_t free_chunks;
+    uint64_t free_runs;
+    uint64_t largest_free_run;
+    uint64_t retained_chunks;
+    double fragmentation; // 1 - largest_free_run / free_chunks
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t cache_hits;
+    lzr_stats_lock_t lock;
+} lzr_stats_heap_t;
+
+typedef struct {
+    uint64_t atoms;
+    uint64_t cells;
+    uint64_t capacity;
+    uint64_t heap_bytes;
+    double load_factor;
+    uint64_t finds;
+    uint64_t inserts;
+    uint64_t probe_groups[LZR_STATS_BUCKETS]; // groups scanned per probe
+    uint64_t displacement[LZR_STATS_BUCKETS]; // groups from each atom's home group, plus one
+    lzr_stats_lock_t lock;
+} lzr_stats_atoms_t;
+
+typedef struct {
+    lzr_stats_heap_t heap;
+    lzr_stats_atoms_t atoms;
+} lzr_stats_t;
+
+// take a snapshot of the runtime's statistics. Safe to call from any thread at any time
+// though the atom table's displacement is computed with its writer lock held.
+void lzr_stats_snapshot(lzr_stats_t* stats);
+
+// format a snapshot as text or as a JSON object into `buffer`, snprintf style:
+// it's always NUL terminated and the length it needed (without the NUL) is returned.
+size_t lzr_stats_dump(const lzr_stats_t* stats, char* buffer, size_t size, bool json);
+
+#endif // LAZER_H
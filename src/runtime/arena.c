@@ -0,0 +1,181 @@
+#include "arena.h"
+#include "slab.h"
+#include "binary.h"
+#include "os/time.h"
+#include <string.h>
+
+#define ARENA_MIN_SIZE 256
+#define ARENA_PAGE_SIZE 4096
+
+// spaces above the slab limit are backed by heap chunks, which are the only ones
+// which can shrink so never let them shrink into the size range of slab spaces.
+#define ARENA_CHUNK_MIN_SIZE (2 * LZR_SLAB_MAX_SIZE)
+
+#define ARENA_ALIGN_UP(value, alignment) (((value) + ((alignment) - 1)) & ~((size_t) (alignment) - 1))
+#define NEXT_POW_2(value) ((value) <= 1 ? 1 : (1ULL << (64 - __builtin_clzl((value) - 1))))
+
+// a space of `size` bytes, or NULL if the heap is out of room. slab classes are 16-byte
+// aligned at powers of two.
+char* arena_space_alloc(size_t size) {
+    if (size <= LZR_SLAB_MAX_SIZE)
+        return (char*) lzr_slab_alloc(size);
+
+    size_t num_chunks = ARENA_ALIGN_UP(size, LZR_HEAP_CHUNK_SIZE) / LZR_HEAP_CHUNK_SIZE;
+    char* space = (char*) lzr_heap_alloc((uint16_t) num_chunks);
+    if (space != NULL)
+        lzr_memory_commit((void*) space, size);
+    return space;
+}
+
+void arena_space_free(char* space, size_t size) {
+    if (size <= LZR_SLAB_MAX_SIZE) {
+        lzr_slab_free((void*) space);
+    } else {
+        lzr_memory_decommit((void*) space, size);
+        lzr_heap_free((void*) space);
+    }
+}
+
+void lzr_arena_init(lzr_arena_t* self) {
+    self->start = NULL;
+    self->top = NULL;
+    self->end = NULL;
+    self->off_heap = 0;
+    self->live = 0;
+    self->collections = 0;
+    self->gc_time = 0;
+    self->gc_max_pause = 0;
+}
+
+void lzr_arena_destroy(lzr_arena_t* self) {
+    for (uint32_t ref = self->off_heap; ref != 0; ) {
+        lzr_off_heap_t* off_heap = (lzr_off_heap_t*) lzr_object_body((lzr_object_t*) LZR_PTR_UNZIP(ref));
+        ref = off_heap->next;
+        lzr_binary_unref((lzr_binary_t*) LZR_PTR_UNZIP(off_heap->ref));
+    }
+
+    if (self->start != NULL)
+        arena_space_free(self->start, lzr_arena_footprint(self));
+    lzr_arena_init(self);
+}
+
+size_t lzr_arena_footprint(lzr_arena_t* self) {
+    return (size_t) (self->end - self->start);
+}
+
+lzr_object_t* lzr_arena_alloc(lzr_arena_t* self, size_t size, uint16_t refs, uint16_t type) {
+    size_t object_size = ARENA_ALIGN_UP(sizeof(lzr_object_t) + size, LZR_ARENA_ALIGN);
+    if (object_size > (size_t) (self->end - self->top))
+        return NULL;
+
+    lzr_object_t* object = (lzr_object_t*) self->top;
+    self->top += object_size;
+    object->size = (uint32_t) object_size;
+    object->refs = refs;
+    object->type = type;
+    return object;
+}
+
+void lzr_arena_track(lzr_arena_t* self, lzr_object_t* object) {
+    assert(object->refs == 0);
+    ((lzr_off_heap_t*) lzr_object_body(object))->next = self->off_heap;
+    self->off_heap = LZR_PTR_ZIP(object);
+}
+
+// relink the off heap objects which were evacuated and drop the references of the rest.
+// the bodies of moved objects are still intact in the old space, only their header was forwarded.
+void arena_sweep_off_heap(lzr_arena_t* self) {
+    uint32_t survivors = 0;
+    for (uint32_t ref = self->off_heap; ref != 0; ) {
+        lzr_object_t* object = (lzr_object_t*) LZR_PTR_UNZIP(ref);
+        lzr_off_heap_t* off_heap = (lzr_off_heap_t*) lzr_object_body(object);
+        ref = off_heap->next;
+
+        if (object->size == 0) {
+            lzr_object_t* copy = (lzr_object_t*) LZR_PTR_UNZIP(object->forward);
+            ((lzr_off_heap_t*) lzr_object_body(copy))->next = survivors;
+            survivors = LZR_PTR_ZIP(copy);
+        } else {
+            lzr_binary_unref((lzr_binary_t*) LZR_PTR_UNZIP(off_heap->ref));
+        }
+    }
+    self->off_heap = survivors;
+}
+
+// evacuate the object `ref` points to if it lives in [from, from_end) returning its new location.
+// `to` is the allocation cursor of the new space.
+uint32_t arena_copy(uint32_t ref, char* from, char* from_end, char** to) {
+    if (ref == 0 || (ref & 1))
+        return ref;
+
+    lzr_object_t* object = (lzr_object_t*) LZR_PTR_UNZIP(ref);
+    if ((char*) object < from || (char*) object >= from_end)
+        return ref;
+    if (object->size == 0)
+        return object->forward;
+
+    lzr_object_t* copy = (lzr_object_t*) *to;
+    memcpy((void*) copy, (void*) object, object->size);
+    *to += object->size;
+
+    object->size = 0;
+    object->forward = LZR_PTR_ZIP(copy);
+    return object->forward;
+}
+
+bool lzr_arena_collect(lzr_arena_t* self, uint32_t* const* roots, size_t num_roots, size_t reserve) {
+    uint64_t started = lzr_time_now();
+    reserve = ARENA_ALIGN_UP(reserve, LZR_ARENA_ALIGN);
+
+    // in the worst case everything is live so size the new space for that
+    char* from = self->start;
+    char* from_end = self->top;
+    size_t from_size = lzr_arena_footprint(self);
+    size_t used = (size_t) (from_end - from);
+    size_t to_size = NEXT_POW_2(used + reserve);
+    if (to_size < ARENA_MIN_SIZE)
+        to_size = ARENA_MIN_SIZE;
+    char* to = arena_space_alloc(to_size);
+    if (to == NULL)
+        return false;
+
+    // roots first, then scan the new space breadth-first until it catches up with the copies
+    char* free = to;
+    for (size_t i = 0; i < num_roots; i++)
+        *roots[i] = arena_copy(*roots[i], from, from_end, &free);
+
+    for (char* scan = to; scan < free; ) {
+        lzr_object_t* object = (lzr_object_t*) scan;
+        uint32_t* fields = lzr_object_fields(object);
+        for (uint16_t i = 0; i < object->refs; i++)
+            fields[i] = arena_copy(fields[i], from, from_end, &free);
+        scan += object->size;
+    }
+
+    arena_sweep_off_heap(self);
+    if (from != NULL)
+        arena_space_free(from, from_size);
+
+    // leave room for the live data to double before the next collection.
+    // chunk backed spaces give back the pages beyond that.
+    size_t live = (size_t) (free - to);
+    size_t want_size = ARENA_ALIGN_UP(2 * live + reserve, ARENA_PAGE_SIZE);
+    if (want_size < ARENA_CHUNK_MIN_SIZE)
+        want_size = ARENA_CHUNK_MIN_SIZE;
+    if (to_size > LZR_SLAB_MAX_SIZE && want_size < to_size) {
+        lzr_memory_decommit((void*) (to + want_size), to_size - want_size);
+        to_size = want_size;
+    }
+
+    self->start = to;
+    self->top = free;
+    self->end = to + to_size;
+    self->live = (uint32_t) live;
+    self->collections++;
+
+    uint64_t pause = lzr_time_now() - started;
+    self->gc_time += pause;
+    if (pause > self->gc_max_pause)
+        self->gc_max_pause = pause;
+    return true;
+}
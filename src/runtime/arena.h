@@ -0,0 +1,77 @@
+#ifndef LZR_ARENA_H
+#define LZR_ARENA_H
+
+#include "os/heap.h"
+
+/*
+An arena is a private bump allocated heap (e.g. one per actor) collected by copying.
+Like the atom table's cells and remap, a collection evacuates everything reachable into
+a fresh space (Cheney style, no recursion) and then throws the old space away whole,
+so collecting an arena only ever touches that arena and never stops anyone else.
+
+Small spaces come from the slab allocator and larger ones from heap chunks, committing
+only what's used and decommitting the old space after every collection.
+
+Objects are 16-byte aligned and start with a header. The first `refs` 32-bit fields of
+the body are traced: a field is a reference if it's non-zero with the low bit clear, in
+which case it's a compressed pointer (see LZR_PTR_ZIP) to an object header. Anything it
+points to outside of the arena (atoms, other arenas, ...) is left alone.
+
+Objects holding a reference to something outside of every arena (currently only shared
+binaries) have no traced fields and start their body with an lzr_off_heap_t. They're linked
+into the arena's `off_heap` list so that a collection can drop the references of the ones
+which didn't survive, as does destroying the arena.
+*/
+#define LZR_ARENA_ALIGN 16
+
+typedef struct {
+    uint32_t size; // in bytes, including the header. zero once moved
+    union {
+        struct {
+            uint16_t refs;
+            uint16_t type;
+        };
+        uint32_t forward; // where it was moved to (compressed)
+    };
+} lzr_object_t;
+
+typedef struct {
+    uint32_t next; // the next off heap object in the arena (compressed)
+    uint32_t ref;  // the lzr_binary_t referenced (compressed)
+} lzr_off_heap_t;
+
+#define lzr_object_body(object) ((void*) ((object) + 1))
+#define lzr_object_fields(object) ((uint32_t*) ((object) + 1))
+
+typedef struct {
+    char* start;
+    char* top;
+    char* end;
+    uint32_t off_heap;      // list of off heap objects (compressed)
+    uint32_t live;          // bytes which survived the last collection
+    uint32_t collections;
+    uint64_t gc_time;       // total nanoseconds spent collecting
+    uint64_t gc_max_pause;  // longest single collection in nanoseconds
+} lzr_arena_t;
+
+// arenas start out empty and don't use any memory until the first collection
+void lzr_arena_init(lzr_arena_t* self);
+
+void lzr_arena_destroy(lzr_arena_t* self);
+
+// bump allocate an object with `size` bytes of body. This never collects so returns NULL
+// when the arena is full, in which case the caller should lzr_arena_collect() and retry.
+lzr_object_t* lzr_arena_alloc(lzr_arena_t* self, size_t size, uint16_t refs, uint16_t type);
+
+// link an object whose body starts with an lzr_off_heap_t into the arena's off heap list
+void lzr_arena_track(lzr_arena_t* self, lzr_object_t* object);
+
+// copy everything reachable from `roots` (pointers to reference fields, updated in place)
+// into a new space with at least `reserve` bytes free afterwards, then release the old one.
+// Returns false, leaving the arena untouched, if the heap has no room for the new space.
+bool lzr_arena_collect(lzr_arena_t* self, uint32_t* const* roots, size_t num_roots, size_t reserve);
+
+// bytes of memory currently backing the arena
+size_t lzr_arena_footprint(lzr_arena_t* self);
+
+#endif // LZR_ARENA_H
@@ -1,49 +1,70 @@
 #include "atom.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "os/heap.h"
-
-#define MAX_ATOM_TE
-
-typedef struct {
-    uint32_t displacement;
-    uint32_t atom_ptr;
-} atom_cell_t;
-
-typedef struct {
-    lzr_atom_t* heap;
-    size_t commit_at;
-} atom_heap_t;
-
-struct lzr_atom_table_t {
-    size_t size;
-    size_t mask;
-    size_t capacity;
-    atom_cell_t* cells;
-    atom_cell_t* remap;
-    atom_heap_t atom_heap;
-};
-
-#define ATOM_CELL_LOAD_FACTOR 90
+#include "os/lock.h"
+#include "os/file.h"
+#include "stats.h"
+
+#if defined(LZR_X86)
+    #include <emmintrin.h>
+#elif defined(LZR_ARM)
+    #include <arm_neon.h>
+#endif
+
+/*
+The cell tables are laid out swiss-table style: a control byte per cell and, at a fixed
+offset of `capacity` bytes after them, a parallel array of compressed atom pointers.
+A control byte is either ATOM_CTRL_EMPTY or ATOM_CTRL_FULL | the low 7 bits of the atom's hash.
+Probing scans a whole group of control bytes at a time using SIMD and only dereferences
+the atom in the atom heap when its hash fragment matches. Atoms are never removed so
+there are no tombstones, and freshly committed (zeroed) memory is an empty table.
+*/
+#define ATOM_CTRL_EMPTY 0x00
+#define ATOM_CTRL_FULL 0x80
+#define ATOM_CTRL_HASH(hash) (ATOM_CTRL_FULL | ((hash) & 0x7f))
+#define ATOM_GROUP_SIZE 16
+
+#define ATOM_CELL_LOAD_FACTOR 94
 #define ATOM_CELL_COMMIT_DEFAULT 1024
+#define ATOM_CELL_MIGRATE_BATCH 16
+#define ATOM_BATCH_SIZE 32
 #define ATOM_HEAP_COMMIT_SIZE (1 * 1024 * 1024)
 
+// snapshot sections are aligned to the largest page size (and windows' allocation
+// granularity) so they can be mapped straight from the file on any platform.
+#define ATOM_SNAPSHOT_ALIGN (64 * 1024)
+#define ATOM_SNAPSHOT_VERSION 2
+#define ATOM_SNAPSHOT_BUFFER (16 * 1024)
+
+// atoms are 16-byte aligned so their compressed pointers have the low bit clear (see term.h)
+#define ATOM_ALIGN 16
+
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define NEXT_POW_2(value) (1ULL << (64 - __builtin_clzl((value) - 1)))
-#define ALIGN(value, alignment) ((value) + ((alignment) - (((value) % (alignment)))))
+#define ALIGN(value, alignment) ((((value) + (alignment) - 1) / (alignment)) * (alignment))
+
+// the atom heap is hot so when running with huge pages, fault it in ahead of time
+void atom_heap_commit(void* addr, size_t bytes) {
+    #if defined(LZR_HUGEPAGES)
+        lzr_memory_prefault(addr, bytes);
+    #else
+        lzr_memory_commit(addr, bytes);
+    #endif
+}
 
-void atom_heap_init(atom_heap_t* self, size_t max_atoms) {
-    const size_t heap_size = ALIGN(MAX_ATOM_SIZE * max_atoms, LZR_HEAP_CHUNK_SIZE);
-    self->heap = (lzr_atom_t*) lzr_heap_reserve(heap_size / LZR_HEAP_CHUNK_SIZE);
+// there can only be one table (see atom_heap_init) which lzr_stats_snapshot() reports on
+static lzr_atom_table_t* atom_table = NULL;
 
-    self->commit_at = ((size_t) self->heap) + ATOM_HEAP_COMMIT_SIZE;
-    lzr_memory_commit((void*) self->heap, ATOM_HEAP_COMMIT_SIZE);
-}
+_Static_assert(sizeof(lzr_atom_t) == LZR_ATOM_BUILTIN_HEADER_SIZE, "tools/atomgen.c lays out atoms with a different header");
+_Static_assert(ATOM_ALIGN == LZR_ATOM_BUILTIN_ALIGN, "tools/atomgen.c aligns atoms differently");
 
 lzr_atom_t* atom_heap_alloc(atom_heap_t* self, uint32_t hash, const char* text, size_t len) {
-    const size_t atom_size = ALIGN(sizeof(lzr_atom_t) + 1 + len, 8);
+    const size_t atom_size = ALIGN(sizeof(lzr_atom_t) + 1 + len, ATOM_ALIGN);
     if (((size_t) self->heap) + atom_size > self->commit_at) {
-        lzr_memory_commit((void*) self->commit_at, ATOM_HEAP_COMMIT_SIZE);
+        atom_heap_commit((void*) self->commit_at, ATOM_HEAP_COMMIT_SIZE);
         self->commit_at += ATOM_HEAP_COMMIT_SIZE;
     }
 
@@ -58,6 +79,32 @@ lzr_atom_t* atom_heap_alloc(atom_heap_t* self, uint32_t hash, const char* text,
     return atom;
 }
 
+// the atom heap lives in the fixed range the lazer heap sets aside for it,
+// so there can only be one atom table per process. The first atom is placed after
+// a bit of padding as an atom at the very start would have a compressed pointer of 0.
+// The built-in atoms come first, at the addresses their LZR_ATOM_* constants were generated with.
+void atom_heap_init(atom_heap_t* self, size_t max_atoms) {
+    assert(LZR_ATOM_BUILTIN_HEAP_BYTES + ALIGN(MAX_ATOM_SIZE, ATOM_ALIGN) * max_atoms <= LZR_ATOM_HEAP_SIZE);
+    self->commit_at = LZR_ATOM_HEAP_BEGIN + ATOM_HEAP_COMMIT_SIZE;
+    atom_heap_commit((void*) LZR_ATOM_HEAP_BEGIN, ATOM_HEAP_COMMIT_SIZE);
+    self->heap = (lzr_atom_t*) (LZR_ATOM_HEAP_BEGIN + ATOM_ALIGN);
+
+    // the generator hashed them on the build machine so make sure this one agrees, in release
+    // builds too: otherwise lookups would miss the built-ins and intern second copies of them
+    lzr_atom_t* atom;
+    bool matches = true;
+    #define ATOM_BUILTIN_ALLOC(name, text, hash) \
+        atom = atom_heap_alloc(self, hash, text, sizeof(text) - 1); \
+        matches &= LZR_PTR_ZIP(atom) == LZR_ATOM_##name && lzr_hash_bytes(text, sizeof(text) - 1) == hash;
+    LZR_ATOM_BUILTINS(ATOM_BUILTIN_ALLOC)
+    #undef ATOM_BUILTIN_ALLOC
+    matches &= ((size_t) self->heap) - LZR_ATOM_HEAP_BEGIN == LZR_ATOM_BUILTIN_HEAP_BYTES;
+    if (!matches) {
+        fprintf(stderr, "lazer: the built-in atoms don't match lazer_atoms.h, it was generated for another target\n");
+        abort();
+    }
+}
+
 bool table_compare_eq(uint32_t atom_ptr, uint32_t hash, const char* text, size_t len) {
     lzr_atom_t* atom = (lzr_atom_t*) LZR_PTR_UNZIP(atom_ptr);
 
@@ -66,108 +113,602 @@ bool table_compare_eq(uint32_t atom_ptr, uint32_t hash, const char* text, size_t
            memcmp(lzr_atom_text_ptr(atom), text, len) == 0;
 }
 
-atom_cell_t* table_find(lzr_atom_table_t* self, uint32_t hash, const char* text, size_t len) {
-    uint32_t displacement = 0;
-    size_t index = hash & self->mask;
+/*
+The built-in atoms never go into the cells. They're looked up with a perfect hash generated
+along with their addresses by tools/atomgen.c: a multiply and a shift lands on the only slot the
+name could be in, whose hash is compared before ever touching the atom itself. The table is
+at most half full and only 8 bytes a slot so it stays hot, and a miss is a single load.
+*/
+typedef struct {
+    uint32_t hash;
+    uint32_t atom;
+} atom_builtin_t;
 
-    while (true) {
-        atom_cell_t* cell = &self->cells[index];
-        if (cell->atom_ptr == 0 || displacement > cell->displacement)
-            return NULL;
-        if (table_compare_eq(cell->atom_ptr, hash, text, len))
-            return cell;
+static const atom_builtin_t atom_builtins[LZR_ATOM_BUILTIN_SLOTS] = { LZR_ATOM_BUILTIN_TABLE };
 
-        displacement++;
-        index = (index + 1) & self->mask;
+uint32_t table_find_builtin(uint32_t hash, const char* text, size_t len) {
+    const atom_builtin_t* builtin = &atom_builtins[(uint32_t) (hash * LZR_ATOM_BUILTIN_SEED) >> LZR_ATOM_BUILTIN_SHIFT];
+    if (builtin->hash == hash && builtin->atom != 0 && table_compare_eq(builtin->atom, hash, text, len))
+        return builtin->atom;
+    return 0;
+}
+
+// a bitmask with one bit per matching control byte in the group.
+// (neon has no movemask so it uses the narrowing shift trick which yields 4 bits per byte)
+#if defined(LZR_X86)
+    #define GROUP_INDEX_SHIFT 0
+
+    uint64_t group_match(const atom_cell_t* group, uint8_t ctrl) {
+        __m128i ctrl_bytes = _mm_loadu_si128((const __m128i*) group);
+        return (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_bytes, _mm_set1_epi8((char) ctrl)));
     }
+
+#elif defined(LZR_ARM)
+    #define GROUP_INDEX_SHIFT 2
+
+    uint64_t group_match(const atom_cell_t* group, uint8_t ctrl) {
+        uint8x16_t matches = vceqq_u8(vld1q_u8(group), vdupq_n_u8(ctrl));
+        uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+        return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888ULL;
+    }
+#endif
+
+#define group_next_match(matches) (__builtin_ctzll(matches) >> GROUP_INDEX_SHIFT)
+
+uint32_t* table_slots(lzr_atom_table_t* self, atom_cell_t* cells) {
+    return (uint32_t*) (cells + self->capacity);
+}
+
+// writers (inserts & table_grow) bump `seq` to odd while they modify the cells
+// and back to even when done. readers use it to detect that their probe raced with one.
+void table_write_begin(lzr_atom_table_t* self) {
+    __atomic_store_n(&self->seq, self->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void table_write_end(lzr_atom_table_t* self) {
+    __atomic_store_n(&self->seq, self->seq + 1, __ATOMIC_RELEASE);
 }
 
-atom_cell_t* table_insert(lzr_atom_table_t* self, uint32_t atom_ptr) {
-    size_t index = ((lzr_atom_t*) LZR_PTR_UNZIP(atom_ptr))->hash & self->mask;
-    atom_cell_t *inserted_cell = NULL;
-    atom_cell_t current_cell;
+// Probe a single cell table using quadratic probing over groups (visits every group
+// since the group count is a power of two). Shared by writers holding the lock and
+// lock-free readers: for the latter, `cells` and `mask` may be torn across a table_grow
+// but every cell table is reserved at full capacity so probing is still in bounds.
+// Readers may also race with the control bytes being written which is harmless as the
+// slot is what's actually loaded with acquire and a missing slot is treated as a miss.
+uint32_t table_probe(lzr_atom_table_t* self, atom_cell_t* cells, size_t mask, uint32_t hash, const char* text, size_t len) {
+    uint32_t* slots = table_slots(self, cells);
+    size_t group_mask = mask / ATOM_GROUP_SIZE;
+    size_t group = (hash >> 7) & group_mask;
+
+    for (size_t stride = 1; stride <= group_mask + 1; stride++) {
+        atom_cell_t* group_cells = &cells[group * ATOM_GROUP_SIZE];
+        uint64_t matches = group_match(group_cells, ATOM_CTRL_HASH(hash));
+
+        while (matches != 0) {
+            size_t index = (group * ATOM_GROUP_SIZE) + group_next_match(matches);
+            uint32_t atom_ptr = __atomic_load_n(&slots[index], __ATOMIC_ACQUIRE);
+            if (atom_ptr != 0 && table_compare_eq(atom_ptr, hash, text, len)) {
+                LZR_STAT_ADD(LZR_STAT_ATOM_PROBE + lzr_stat_bucket(stride), 1);
+                return atom_ptr;
+            }
+            matches &= matches - 1;
+        }
 
-    current_cell.displacement = 0;
-    current_cell.atom_ptr = atom_ptr;
+        if (group_match(group_cells, ATOM_CTRL_EMPTY) != 0) {
+            LZR_STAT_ADD(LZR_STAT_ATOM_PROBE + lzr_stat_bucket(stride), 1);
+            return 0;
+        }
+        group = (group + stride) & group_mask;
+    }
+
+    LZR_STAT_ADD(LZR_STAT_ATOM_PROBE + lzr_stat_bucket(group_mask + 1), 1);
+    return 0;
+}
+
+// while a migration is in progress an atom may still only live in the old cells.
+// only called by writers with the lock held.
+uint32_t table_find(lzr_atom_table_t* self, uint32_t hash, const char* text, size_t len) {
+    uint32_t atom_ptr = table_probe(self, self->cells, self->mask, hash, text, len);
+    if (atom_ptr == 0 && self->migrate != NULL)
+        atom_ptr = table_probe(self, self->migrate, self->migrate_mask, hash, text, len);
+    return atom_ptr;
+}
+
+// the lock-free version of table_find(), which every find and upsert goes through first so
+// it's also where the built-in atoms are caught. A hit is always valid (atoms are never
+// moved or freed) so probing goes ahead even while a writer is busy, and never waits on it.
+// Only a miss has to be confirmed: by no writer having been active while probing.
+lzr_atom_t* table_find_shared(lzr_atom_table_t* self, uint32_t hash, const char* text, size_t len) {
+    LZR_STAT_ADD(LZR_STAT_ATOM_FIND, 1);
+    uint32_t builtin_ptr = table_find_builtin(hash, text, len);
+    if (builtin_ptr != 0)
+        return (lzr_atom_t*) LZR_PTR_UNZIP(builtin_ptr);
 
     while (true) {
-        atom_cell_t* cell = &self->cells[index];
-        if (cell->atom_ptr == 0) {
-            self->size++;
-            *cell = current_cell;
-            return inserted_cell != NULL ? inserted_cell : cell;
-
-        } else if (cell->displacement < current_cell.displacement) {
-            if (current_cell.atom_ptr == atom_ptr)
-                inserted_cell = cell;
-            atom_cell_t temp = current_cell;
-            current_cell = *cell;
-            *cell = temp;
+        size_t seq = __atomic_load_n(&self->seq, __ATOMIC_ACQUIRE);
+
+        atom_cell_t* cells = __atomic_load_n(&self->cells, __ATOMIC_RELAXED);
+        size_t mask = __atomic_load_n(&self->mask, __ATOMIC_RELAXED);
+        uint32_t atom_ptr = table_probe(self, cells, mask, hash, text, len);
+
+        atom_cell_t* migrate = __atomic_load_n(&self->migrate, __ATOMIC_RELAXED);
+        if (atom_ptr == 0 && migrate != NULL) {
+            size_t migrate_mask = __atomic_load_n(&self->migrate_mask, __ATOMIC_RELAXED);
+            atom_ptr = table_probe(self, migrate, migrate_mask, hash, text, len);
         }
 
-        current_cell.displacement++;
-        index = (index + 1) & self->mask;
+        if (atom_ptr != 0)
+            return (lzr_atom_t*) LZR_PTR_UNZIP(atom_ptr);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ((seq & 1) == 0 && __atomic_load_n(&self->seq, __ATOMIC_RELAXED) == seq)
+            return NULL;
+        lzr_cpu_relax();
     }
 }
 
-void table_grow(lzr_atom_table_t* self) {
-    atom_cell_t* old_cells = self->cells;
-    size_t old_capacity = self->mask + 1;
-    size_t new_capacity = old_capacity << 1;
-    assert(new_capacity <= self->capacity);
+// atoms are never removed so inserting just claims the first empty cell in the probe sequence.
+// The slot is released before the control byte so a reader never sees a matching control byte
+// whose atom isn't visible yet.
+void table_insert(lzr_atom_table_t* self, uint32_t atom_ptr) {
+    uint32_t hash = ((lzr_atom_t*) LZR_PTR_UNZIP(atom_ptr))->hash;
+    size_t group_mask = self->mask / ATOM_GROUP_SIZE;
+    size_t group = (hash >> 7) & group_mask;
+
+    for (size_t stride = 1; true; stride++) {
+        uint64_t empty = group_match(&self->cells[group * ATOM_GROUP_SIZE], ATOM_CTRL_EMPTY);
+        if (empty != 0) {
+            size_t index = (group * ATOM_GROUP_SIZE) + group_next_match(empty);
+            __atomic_store_n(&table_slots(self, self->cells)[index], atom_ptr, __ATOMIC_RELEASE);
+            __atomic_store_n(&self->cells[index], ATOM_CTRL_HASH(hash), __ATOMIC_RELEASE);
+            return;
+        }
 
-    self->size = 0;
-    self->cells = self->remap;
-    self->mask = new_capacity - 1;
-    lzr_memory_commit((void*) self->cells, new_capacity * sizeof(atom_cell_t));
+        assert(stride <= group_mask);
+        group = (group + stride) & group_mask;
+    }
+}
+
+// cells mapped in from a snapshot would just fault the file contents back in
+// if decommitted, so they're replaced with fresh anonymous memory instead.
+void table_decommit(lzr_atom_table_t* self, atom_cell_t* cells, size_t capacity) {
+    if (cells == self->mapped) {
+        lzr_file_unmap((void*) cells, ALIGN(capacity * sizeof(atom_cell_t), ATOM_SNAPSHOT_ALIGN));
+        lzr_file_unmap((void*) table_slots(self, cells), ALIGN(capacity * sizeof(uint32_t), ATOM_SNAPSHOT_ALIGN));
+        self->mapped = NULL;
+        return;
+    }
 
-    for (size_t cell_index = 0; cell_index < old_capacity; cell_index++) {
-        uint32_t atom_ptr = old_cells[cell_index].atom_ptr;
+    lzr_memory_decommit((void*) cells, capacity * sizeof(atom_cell_t));
+    lzr_memory_decommit((void*) table_slots(self, cells), capacity * sizeof(uint32_t));
+}
+
+// move up to `max_cells` cells from the old table into the current one.
+// once the old table is drained, it's discarded and becomes the next remap space.
+void table_migrate(lzr_atom_table_t* self, size_t max_cells) {
+    if (self->migrate == NULL)
+        return;
+
+    uint32_t* slots = table_slots(self, self->migrate);
+    size_t old_capacity = self->migrate_mask + 1;
+    size_t migrate_end = MIN(self->migrate_at + max_cells, old_capacity);
+    for (; self->migrate_at < migrate_end; self->migrate_at++) {
+        uint32_t atom_ptr = slots[self->migrate_at];
         if (atom_ptr != 0)
             table_insert(self, atom_ptr);
     }
-    
-    lzr_memory_decommit((void*) self->remap, old_capacity * sizeof(atom_cell_t));
-    self->remap = old_cells;
+
+    // readers which are still probing the old cells will read an empty table after
+    // the decommit and retry once they notice that `seq` changed.
+    if (self->migrate_at == old_capacity) {
+        self->remap = self->migrate;
+        __atomic_store_n(&self->migrate, NULL, __ATOMIC_RELAXED);
+        table_decommit(self, self->remap, old_capacity);
+    }
+}
+
+// rather than rehashing every cell into the remap space while the caller waits,
+// swap the tables and let each following insert migrate a few old cells over.
+// lookups consult both tables until the old one is drained.
+void table_grow(lzr_atom_table_t* self) {
+    // a grow only triggers after twice as many inserts as it takes to
+    // drain the previous migration, but make sure of it regardless.
+    table_migrate(self, self->migrate_mask + 1);
+
+    size_t old_capacity = self->mask + 1;
+    size_t new_capacity = old_capacity << 1;
+    assert(new_capacity <= self->capacity);
+    lzr_memory_commit((void*) self->remap, new_capacity * sizeof(atom_cell_t));
+    lzr_memory_commit((void*) table_slots(self, self->remap), new_capacity * sizeof(uint32_t));
+
+    self->migrate_at = 0;
+    __atomic_store_n(&self->migrate_mask, self->mask, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->migrate, self->cells, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->cells, self->remap, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->mask, new_capacity - 1, __ATOMIC_RELAXED);
+    self->remap = NULL;
 }
 
 void lzr_atom_table_init(lzr_atom_table_t* self, size_t max_atoms) {
     // allocate the cell tables for both the main cells and the remap cells
     // the remap are used as a copying-gc like space when resizing
-    const size_t cell_size = NEXT_POW_2(MAX(max_atoms, ATOM_CELL_COMMIT_DEFAULT));
-    const size_t cell_heap_size = ALIGN(cell_size, LZR_HEAP_CHUNK_SIZE) / LZR_HEAP_CHUNK_SIZE;
+    // the cells grow once they're ATOM_CELL_LOAD_FACTOR% full so max_atoms has to fit under that
+    const size_t min_cells = ((max_atoms + 1) * 100 + ATOM_CELL_LOAD_FACTOR - 1) / ATOM_CELL_LOAD_FACTOR;
+    const size_t cell_size = NEXT_POW_2(MAX(min_cells, ATOM_CELL_COMMIT_DEFAULT));
+    const size_t cell_bytes = cell_size * (sizeof(atom_cell_t) + sizeof(uint32_t));
+    const size_t cell_heap_size = ALIGN(cell_bytes, LZR_HEAP_CHUNK_SIZE) / LZR_HEAP_CHUNK_SIZE;
     self->cells = (atom_cell_t*) lzr_heap_reserve(cell_heap_size);
     self->remap = (atom_cell_t*) lzr_heap_reserve(cell_heap_size);
+    self->capacity = cell_size;
 
-    const size_t cells_to_commit = MIN(cell_size, ATOM_CELL_COMMIT_DEFAULT * sizeof(atom_cell_t));
-    lzr_memory_commit((void*) self->cells, cells_to_commit);
+    const size_t cells_to_commit = MIN(cell_size, ATOM_CELL_COMMIT_DEFAULT);
+    lzr_memory_commit((void*) self->cells, cells_to_commit * sizeof(atom_cell_t));
+    lzr_memory_commit((void*) table_slots(self, self->cells), cells_to_commit * sizeof(uint32_t));
     
     atom_heap_init(&self->atom_heap, max_atoms);
+    lzr_mutex_init(&self->lock);
     self->mask = cells_to_commit - 1;
-    self->capacity = cell_size;
     self->size = 0;
+    self->seq = 0;
+    self->migrate = NULL;
+    self->migrate_mask = 0;
+    self->migrate_at = 0;
+    self->mapped = NULL;
+    atom_table = self;
 }
 
-lzr_atom_t* lzr_atom_table_find(lzr_atom_table_t* self, const char* key, size_t key_len) {
-    // TODO: Add read-lock here
+// start pulling in the control bytes and slots of the group where `hash` would be probed first
+void table_prefetch(lzr_atom_table_t* self, uint32_t hash) {
+    atom_cell_t* cells = __atomic_load_n(&self->cells, __ATOMIC_RELAXED);
+    size_t mask = __atomic_load_n(&self->mask, __ATOMIC_RELAXED);
+    size_t index = ((hash >> 7) & (mask / ATOM_GROUP_SIZE)) * ATOM_GROUP_SIZE;
+
+    __builtin_prefetch(&cells[index]);
+    __builtin_prefetch(&table_slots(self, cells)[index]);
+}
+
+// find or insert an atom which wasn't found by the lock-free path. assumes the lock is held.
+lzr_atom_t* table_upsert_locked(lzr_atom_table_t* self, uint32_t hash, const char* key, size_t key_len) {
+    // another writer could have inserted it while we were waiting on the lock
+    uint32_t atom_ptr = table_find(self, hash, key, key_len);
+    if (atom_ptr != 0)
+        return (lzr_atom_t*) LZR_PTR_UNZIP(atom_ptr);
+
+    LZR_STAT_ADD(LZR_STAT_ATOM_INSERT, 1);
+    table_write_begin(self);
+    if (++self->size >= (ATOM_CELL_LOAD_FACTOR * (self->mask + 1)) / 100)
+        table_grow(self);
+    table_migrate(self, ATOM_CELL_MIGRATE_BATCH);
+    lzr_atom_t* atom = atom_heap_alloc(&self->atom_heap, hash, key, key_len);
+    table_insert(self, LZR_PTR_ZIP(atom));
+    table_write_end(self);
+    return atom;
+}
 
+// never takes the lock or writes to the table so any number of threads can find concurrently
+lzr_atom_t* lzr_atom_table_find(lzr_atom_table_t* self, const char* key, size_t key_len) {
     uint32_t hash = lzr_hash_bytes(key, key_len);
-    atom_cell_t* cell = table_find(self, hash, key, key_len);
-    return (lzr_atom_t*) (cell != NULL ? LZR_PTR_UNZIP(cell->atom_ptr) : NULL);
+    return table_find_shared(self, hash, key, key_len);
 }
 
+// most upserts are for atoms which already exist so try the lock-free path first.
+// only actually inserting a new atom serializes with other writers.
 lzr_atom_t* lzr_atom_table_upsert(lzr_atom_table_t* self, const char* key, size_t key_len) {
-    // TODO: Add write-lock here
-
     uint32_t hash = lzr_hash_bytes(key, key_len);
-    atom_cell_t* cell = table_find(self, hash, key, key_len);
+    lzr_atom_t* atom = table_find_shared(self, hash, key, key_len);
+    if (atom != NULL)
+        return atom;
+
+    lzr_mutex_lock(&self->lock);
+    atom = table_upsert_locked(self, hash, key, key_len);
+    lzr_mutex_unlock(&self->lock);
+    return atom;
+}
+
+// software-pipelined in windows of ATOM_BATCH_SIZE: hash every key and prefetch
+// its home group first, then resolve them once their cells are (hopefully) cached.
+void lzr_atom_table_find_batch(lzr_atom_table_t* self, const char* const* keys, const size_t* key_lens, lzr_atom_t** atoms, size_t count) {
+    uint32_t hashes[ATOM_BATCH_SIZE];
+
+    for (size_t batch = 0; batch < count; batch += ATOM_BATCH_SIZE) {
+        size_t batch_size = MIN(count - batch, ATOM_BATCH_SIZE);
+        for (size_t i = 0; i < batch_size; i++) {
+            hashes[i] = lzr_hash_bytes(keys[batch + i], key_lens[batch + i]);
+            table_prefetch(self, hashes[i]);
+        }
+
+        for (size_t i = 0; i < batch_size; i++)
+            atoms[batch + i] = table_find_shared(self, hashes[i], keys[batch + i], key_lens[batch + i]);
+    }
+}
+
+// same pipelining as lzr_atom_table_find_batch() but any misses in a window
+// are inserted together under a single acquisition of the writer lock.
+void lzr_atom_table_upsert_batch(lzr_atom_table_t* self, const char* const* keys, const size_t* key_lens, lzr_atom_t** atoms, size_t count) {
+    uint32_t hashes[ATOM_BATCH_SIZE];
+
+    for (size_t batch = 0; batch < count; batch += ATOM_BATCH_SIZE) {
+        size_t batch_size = MIN(count - batch, ATOM_BATCH_SIZE);
+        for (size_t i = 0; i < batch_size; i++) {
+            hashes[i] = lzr_hash_bytes(keys[batch + i], key_lens[batch + i]);
+            table_prefetch(self, hashes[i]);
+        }
+
+        size_t misses = 0;
+        for (size_t i = 0; i < batch_size; i++) {
+            lzr_atom_t* atom = table_find_shared(self, hashes[i], keys[batch + i], key_lens[batch + i]);
+            atoms[batch + i] = atom;
+            misses += (atom == NULL);
+        }
+
+        if (misses == 0)
+            continue;
+
+        lzr_mutex_lock(&self->lock);
+        for (size_t i = 0; i < batch_size; i++)
+            if (atoms[batch + i] == NULL)
+                atoms[batch + i] = table_upsert_locked(self, hashes[i], keys[batch + i], key_lens[batch + i]);
+        lzr_mutex_unlock(&self->lock);
+    }
+}
+
+
+/*
+A snapshot is the atom heap and the current cells written out as-is, each section
+at an ATOM_SNAPSHOT_ALIGN'd file offset right after the header:
+
+    [header][atom heap: LZR_ATOM_HEAP_BEGIN..heap][control bytes][slots]
+
+Both live at fixed addresses in the lazer heap and only reference each other through
+compressed pointers, so loading is mapping the sections back copy-on-write where they were,
+without any rehashing. Only the pages which are actually touched are ever read in.
+*/
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t hash_check;
+    uint64_t heap_begin;
+    uint64_t capacity;
+    uint64_t cells;
+    uint64_t mask;
+    uint64_t size;
+    uint64_t heap_bytes;
+} atom_snapshot_t;
+
+static const char ATOM_SNAPSHOT_MAGIC[8] = "LZRATOMS";
+
+// catches snapshots from a build where lzr_hash_bytes() (and thus every probe sequence)
+// or the built-in atoms at the start of the saved atom heap differ
+uint32_t snapshot_hash_check() {
+    return lzr_hash_bytes("lazer atom snapshot", sizeof("lazer atom snapshot") - 1) ^ LZR_ATOM_BUILTIN_CHECK;
+}
+
+// the atom's `data` and `actor` refer to runtime state which won't exist in the next process
+// so they're written out cleared, going through a small buffer to avoid a write per atom.
+bool snapshot_write_heap(lzr_atom_table_t* self, lzr_file_t* file, uint64_t offset) {
+    char buffer[ATOM_SNAPSHOT_BUFFER];
+    memset(buffer, 0, ATOM_ALIGN);
+    size_t buffered = ATOM_ALIGN;
+
+    size_t atom_at = LZR_ATOM_HEAP_BEGIN + ATOM_ALIGN;
+    while (atom_at < (size_t) self->atom_heap.heap) {
+        lzr_atom_t* atom = (lzr_atom_t*) atom_at;
+        const size_t atom_size = ALIGN(sizeof(lzr_atom_t) + 1 + lzr_atom_len(atom), ATOM_ALIGN);
+        if (buffered + atom_size > sizeof(buffer)) {
+            if (!lzr_file_write(file, buffer, buffered, offset))
+                return false;
+            offset += buffered;
+            buffered = 0;
+        }
+
+        lzr_atom_t* copy = (lzr_atom_t*) &buffer[buffered];
+        memcpy(copy, atom, atom_size);
+        copy->data = 0;
+        copy->actor = 0;
+        buffered += atom_size;
+        atom_at += atom_size;
+    }
+
+    return lzr_file_write(file, buffer, buffered, offset);
+}
+
+bool lzr_atom_table_save(lzr_atom_table_t* self, const char* path) {
+    lzr_file_t file;
+    if (!lzr_file_open(&file, path, true))
+        return false;
+
+    // finish any migration so that the current cells are the only ones to save.
+    // readers can keep going but other writers wait until the snapshot is written.
+    lzr_mutex_lock(&self->lock);
+    table_write_begin(self);
+    table_migrate(self, self->migrate_mask + 1);
+    table_write_end(self);
+
+    atom_snapshot_t header = { 0 };
+    memcpy(header.magic, ATOM_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = ATOM_SNAPSHOT_VERSION;
+    header.hash_check = snapshot_hash_check();
+    header.heap_begin = LZR_HEAP_BEGIN;
+    header.capacity = self->capacity;
+    header.cells = (uint64_t) self->cells;
+    header.mask = self->mask;
+    header.size = self->size;
+    header.heap_bytes = ((size_t) self->atom_heap.heap) - LZR_ATOM_HEAP_BEGIN;
+
+    const size_t cells = header.mask + 1;
+    const uint64_t heap_offset = ALIGN(sizeof(header), ATOM_SNAPSHOT_ALIGN);
+    const uint64_t ctrl_offset = heap_offset + ALIGN(header.heap_bytes, ATOM_SNAPSHOT_ALIGN);
+    const uint64_t slots_offset = ctrl_offset + ALIGN(cells * sizeof(atom_cell_t), ATOM_SNAPSHOT_ALIGN);
+    const uint64_t snapshot_end = slots_offset + ALIGN(cells * sizeof(uint32_t), ATOM_SNAPSHOT_ALIGN);
+
+    // the header goes last so that a partially written snapshot never loads.
+    // writing the final padding byte extends the file over the last mapped page.
+    const char padding = 0;
+    bool saved = snapshot_write_heap(self, &file, heap_offset) &&
+                 lzr_file_write(&file, self->cells, cells * sizeof(atom_cell_t), ctrl_offset) &&
+                 lzr_file_write(&file, table_slots(self, self->cells), cells * sizeof(uint32_t), slots_offset) &&
+                 lzr_file_write(&file, &padding, sizeof(padding), snapshot_end - 1) &&
+                 lzr_file_write(&file, &header, sizeof(header), 0);
+
+    lzr_mutex_unlock(&self->lock);
+    lzr_file_close(&file);
+    return saved;
+}
+
+// slots start `capacity` bytes after the control bytes so the two sections can only
+// be mapped without overlapping each other when that's a multiple of the alignment.
+bool snapshot_can_map(lzr_atom_table_t* self) {
+    return self->capacity % ATOM_SNAPSHOT_ALIGN == 0;
+}
+
+bool snapshot_load_cells(lzr_atom_table_t* self, lzr_file_t* file, atom_cell_t* cells, size_t num_cells, uint64_t ctrl_offset, uint64_t slots_offset) {
+    const size_t ctrl_bytes = num_cells * sizeof(atom_cell_t);
+    const size_t slot_bytes = num_cells * sizeof(uint32_t);
+
+    if (snapshot_can_map(self))
+        return lzr_file_map(file, (void*) cells, ALIGN(ctrl_bytes, ATOM_SNAPSHOT_ALIGN), ctrl_offset) &&
+               lzr_file_map(file, (void*) table_slots(self, cells), ALIGN(slot_bytes, ATOM_SNAPSHOT_ALIGN), slots_offset);
+
+    lzr_memory_commit((void*) cells, ctrl_bytes);
+    lzr_memory_commit((void*) table_slots(self, cells), slot_bytes);
+    return lzr_file_read(file, (void*) cells, ctrl_bytes, ctrl_offset) &&
+           lzr_file_read(file, (void*) table_slots(self, cells), slot_bytes, slots_offset);
+}
 
-    if (cell == NULL) {
-        if (++self->size >= (ATOM_CELL_LOAD_FACTOR * self->capacity) / 100)
-            table_grow(self);
-        lzr_atom_t* atom = atom_heap_alloc(&self->atom_heap, hash, key, key_len);
-        cell = table_insert(self, LZR_PTR_ZIP(atom));
+// undo a (possibly partial) snapshot_load_cells(), leaving the cells empty again
+void snapshot_unload_cells(lzr_atom_table_t* self, atom_cell_t* cells, size_t num_cells) {
+    const size_t ctrl_bytes = num_cells * sizeof(atom_cell_t);
+    const size_t slot_bytes = num_cells * sizeof(uint32_t);
+
+    if (snapshot_can_map(self)) {
+        lzr_file_unmap((void*) cells, ALIGN(ctrl_bytes, ATOM_SNAPSHOT_ALIGN));
+        lzr_file_unmap((void*) table_slots(self, cells), ALIGN(slot_bytes, ATOM_SNAPSHOT_ALIGN));
+        lzr_memory_commit((void*) self->cells, (self->mask + 1) * sizeof(atom_cell_t));
+        lzr_memory_commit((void*) table_slots(self, self->cells), (self->mask + 1) * sizeof(uint32_t));
+    } else {
+        memset((void*) cells, 0, ctrl_bytes);
+        memset((void*) table_slots(self, cells), 0, slot_bytes);
     }
+}
+
+bool lzr_atom_table_load(lzr_atom_table_t* self, const char* path) {
+    assert(self->size == 0 && self->migrate == NULL);
+
+    lzr_file_t file;
+    if (!lzr_file_open(&file, path, false))
+        return false;
+
+    atom_snapshot_t header;
+    if (!lzr_file_read(&file, &header, sizeof(header), 0))
+        goto failed;
+
+    // the cells are reserved at the same addresses as long as the table was initialized
+    // with the same max_atoms at the same point during startup. Which of the two cell
+    // tables was current when saved depends on how many times it grew.
+    atom_cell_t* cells = (atom_cell_t*) header.cells;
+    if (memcmp(header.magic, ATOM_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != ATOM_SNAPSHOT_VERSION ||
+        header.hash_check != snapshot_hash_check() ||
+        header.heap_begin != LZR_HEAP_BEGIN ||
+        header.capacity != self->capacity ||
+        (cells != self->cells && cells != self->remap) ||
+        header.mask + 1 > header.capacity ||
+        (header.mask & (header.mask + 1)) != 0 ||
+        header.size >= header.mask + 1 ||
+        header.heap_bytes < LZR_ATOM_BUILTIN_HEAP_BYTES ||
+        header.heap_bytes > LZR_ATOM_HEAP_SIZE)
+        goto failed;
+
+    const size_t num_cells = header.mask + 1;
+    const size_t heap_extent = ALIGN(header.heap_bytes, ATOM_SNAPSHOT_ALIGN);
+    const uint64_t heap_offset = ALIGN(sizeof(header), ATOM_SNAPSHOT_ALIGN);
+    const uint64_t ctrl_offset = heap_offset + heap_extent;
+    const uint64_t slots_offset = ctrl_offset + ALIGN(num_cells * sizeof(atom_cell_t), ATOM_SNAPSHOT_ALIGN);
+    const uint64_t snapshot_end = slots_offset + ALIGN(num_cells * sizeof(uint32_t), ATOM_SNAPSHOT_ALIGN);
+
+    // touching a mapping past the end of a truncated file would fault instead of failing here
+    char padding;
+    if (!lzr_file_read(&file, &padding, sizeof(padding), snapshot_end - 1))
+        goto failed;
+
+    // put back the empty table lzr_atom_table_init() left if either fails
+    if (!snapshot_load_cells(self, &file, cells, num_cells, ctrl_offset, slots_offset)) {
+        snapshot_unload_cells(self, cells, num_cells);
+        goto failed;
+    }
+
+    if (!lzr_file_map(&file, (void*) LZR_ATOM_HEAP_BEGIN, heap_extent, heap_offset)) {
+        snapshot_unload_cells(self, cells, num_cells);
+        lzr_file_unmap((void*) LZR_ATOM_HEAP_BEGIN, heap_extent);
+        atom_heap_commit((void*) LZR_ATOM_HEAP_BEGIN, ATOM_HEAP_COMMIT_SIZE);
+        goto failed;
+    }
+
+    if (cells != self->cells) {
+        self->remap = self->cells;
+        self->cells = cells;
+    }
+
+    if (snapshot_can_map(self))
+        self->mapped = cells;
+    self->mask = header.mask;
+    self->size = header.size;
+    self->atom_heap.heap = (lzr_atom_t*) (LZR_ATOM_HEAP_BEGIN + header.heap_bytes);
+    self->atom_heap.commit_at = MAX(self->atom_heap.commit_at, LZR_ATOM_HEAP_BEGIN + heap_extent);
+    lzr_file_close(&file);
+    return true;
+
+failed:
+    lzr_file_close(&file);
+    return false;
+}
+
+// the displacement of an atom is the position of its group in the quadratic
+// probe sequence starting from its home group (so an atom in its home group is 1)
+size_t table_displacement(size_t home, size_t group, size_t group_mask) {
+    size_t displacement = 1;
+    for (size_t stride = 1; home != group && stride <= group_mask; stride++) {
+        home = (home + stride) & group_mask;
+        displacement++;
+    }
+    return displacement;
+}
+
+void lzr_atom_table_stats(lzr_stats_atoms_t* stats) {
+    memset(stats, 0, sizeof(lzr_stats_atoms_t));
+    stats->finds = lzr_stat_read(LZR_STAT_ATOM_FIND);
+    stats->inserts = lzr_stat_read(LZR_STAT_ATOM_INSERT);
+    for (size_t i = 0; i < LZR_STATS_BUCKETS; i++)
+        stats->probe_groups[i] = lzr_stat_read(LZR_STAT_ATOM_PROBE + i);
+
+    lzr_atom_table_t* self = atom_table;
+    if (self == NULL)
+        return;
+
+    // atoms still waiting in the old cells of a migration aren't in the displacement histogram,
+    // nor are the built-in atoms which aren't in any cells
+    lzr_mutex_lock(&self->lock);
+    stats->atoms = self->size + LZR_ATOM_BUILTIN_COUNT;
+    stats->cells = self->mask + 1;
+    stats->capacity = self->capacity;
+    stats->heap_bytes = ((size_t) self->atom_heap.heap) - LZR_ATOM_HEAP_BEGIN;
+    stats->load_factor = (double) self->size / (double) (self->mask + 1);
+
+    uint32_t* slots = table_slots(self, self->cells);
+    size_t group_mask = self->mask / ATOM_GROUP_SIZE;
+    for (size_t index = 0; index <= self->mask; index++) {
+        if (slots[index] == 0)
+            continue;
+        uint32_t hash = ((lzr_atom_t*) LZR_PTR_UNZIP(slots[index]))->hash;
+        size_t displacement = table_displacement((hash >> 7) & group_mask, index / ATOM_GROUP_SIZE, group_mask);
+        stats->displacement[lzr_stat_bucket(displacement)]++;
+    }
+    lzr_mutex_unlock(&self->lock);
 
-    return (lzr_atom_t*) LZR_PTR_UNZIP(cell->atom_ptr);
-}
\ No newline at end of file
+    lzr_mutex_stats_t lock;
+    lzr_mutex_stats(&self->lock, &lock);
+    stats->lock.acquired = lock.acquired;
+    stats->lock.contended = lock.contended;
+    stats->lock.parked = lock.parked;
+}
@@ -2,6 +2,11 @@
 #define LZR_ATOM_H
 
 #include "hash.h"
+#include "os/lock.h"
+
+// LZR_ATOM_* for the built-in atoms of atoms.def, generated by tools/atomgen.c.
+// they're the atoms' terms (see term.h) as they sit at fixed addresses in the atom heap.
+#include <lazer_atoms.h>
 
 typedef struct {
     uint32_t hash;
@@ -16,7 +21,29 @@ typedef struct {
 #define lzr_atom_len_ptr(atom) ((uint8_t*) ((atom) + 1))
 #define lzr_atom_text_ptr(atom) (((char*) ((atom) + 1)) + 1)
 
-typedef struct lzr_atom_table_t lzr_atom_table_t;
+// the table's internals are only touched by atom.c (see the layout described there),
+// they're defined here so that a table can be embedded without allocating it.
+typedef uint8_t atom_cell_t;
+
+typedef struct {
+    lzr_atom_t* heap;
+    size_t commit_at;
+} atom_heap_t;
+
+typedef struct lzr_atom_table_t {
+    size_t seq;
+    lzr_mutex_t lock;
+    size_t size;
+    size_t mask;
+    size_t capacity;
+    atom_cell_t* cells;
+    atom_cell_t* remap;
+    atom_cell_t* migrate;
+    size_t migrate_mask;
+    size_t migrate_at;
+    atom_cell_t* mapped;
+    atom_heap_t atom_heap;
+} lzr_atom_table_t;
 
 void lzr_atom_table_init(lzr_atom_table_t* self, size_t max_atoms);
 
@@ -24,4 +51,23 @@ lzr_atom_t* lzr_atom_table_find(lzr_atom_table_t* self, const char* key, size_t
 
 lzr_atom_t* lzr_atom_table_upsert(lzr_atom_table_t* self, const char* key, size_t key_len);
 
+// batched versions of find/upsert which overlap the memory latency of each lookup.
+// `atoms[i]` is set to the result of finding/upserting `keys[i]` with length `key_lens[i]`.
+void lzr_atom_table_find_batch(lzr_atom_table_t* self, const char* const* keys, const size_t* key_lens, lzr_atom_t** atoms, size_t count);
+
+void lzr_atom_table_upsert_batch(lzr_atom_table_t* self, const char* const* keys, const size_t* key_lens, lzr_atom_t** atoms, size_t count);
+
+// write a snapshot of every atom in the table to `path`. Can run alongside finds
+// but other writers wait until it's done. Returns false if the file couldn't be written.
+bool lzr_atom_table_save(lzr_atom_table_t* self, const char* path);
+
+// map a snapshot from lzr_atom_table_save() into a table which was just initialized, with the
+// same max_atoms and at the same point during startup as the one which saved it (so that its
+// cells were reserved at the same addresses). Returns false, leaving the table empty, if the
+// snapshot is missing, truncated or was saved by an incompatible table or build.
+bool lzr_atom_table_load(lzr_atom_table_t* self, const char* path);
+
+// fill in the atom table's part of lzr_stats_snapshot(). takes the writer lock to scan the cells.
+void lzr_atom_table_stats(lzr_stats_atoms_t* stats);
+
 #endif // LZR_ATOM_H
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include "binary.h"
+#include "slab.h"
+
+lzr_binary_t* lzr_binary_new(size_t size) {
+    assert(size <= UINT32_MAX);
+    size_t bytes = sizeof(lzr_binary_t) + size;
+    lzr_binary_t* self;
+
+    if (bytes <= LZR_SLAB_MAX_SIZE) {
+        self = (lzr_binary_t*) lzr_slab_alloc(bytes);
+        self->chunks = 0;
+    } else {
+        size_t chunks = (bytes + LZR_HEAP_CHUNK_SIZE - 1) / LZR_HEAP_CHUNK_SIZE;
+        assert(chunks <= UINT16_MAX);
+        self = (lzr_binary_t*) lzr_heap_alloc((uint16_t) chunks);
+        if (self == NULL)
+            return NULL;
+        lzr_memory_commit((void*) self, bytes);
+        self->chunks = (uint32_t) chunks;
+    }
+
+    self->refs = 1;
+    self->size = size;
+    return self;
+}
+
+void lzr_binary_ref(lzr_binary_t* self) {
+    __atomic_fetch_add(&self->refs, 1, __ATOMIC_RELAXED);
+}
+
+// the release/acquire pair makes every write through other references happen before the free
+void lzr_binary_unref(lzr_binary_t* self) {
+    if (__atomic_fetch_sub(&self->refs, 1, __ATOMIC_RELEASE) != 1)
+        return;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if (self->chunks == 0) {
+        lzr_slab_free((void*) self);
+    } else {
+        lzr_memory_decommit((void*) self, sizeof(lzr_binary_t) + self->size);
+        lzr_heap_free((void*) self);
+    }
+}
+
+lzr_term_t lzr_binary_term(lzr_arena_t* arena, lzr_binary_t* binary, size_t offset, size_t size) {
+    assert(offset + size <= binary->size);
+    lzr_object_t* object = lzr_arena_alloc(arena, sizeof(lzr_sub_binary_t), 0, LZR_TYPE_BINARY);
+    if (object == NULL)
+        return LZR_NIL;
+
+    lzr_binary_ref(binary);
+    lzr_sub_binary_t* sub_binary = (lzr_sub_binary_t*) lzr_object_body(object);
+    sub_binary->off_heap.ref = LZR_PTR_ZIP(binary);
+    sub_binary->offset = (uint32_t) offset;
+    sub_binary->size = (uint32_t) size;
+    lzr_arena_track(arena, object);
+    return lzr_term_from_object(object);
+}
+
+lzr_term_t lzr_binary_slice(lzr_arena_t* arena, lzr_term_t term, size_t offset, size_t size) {
+    assert(offset + size <= lzr_binary_term_size(term));
+    return lzr_binary_term(arena, lzr_sub_binary_root(term), lzr_sub_binary(term)->offset + offset, size);
+}
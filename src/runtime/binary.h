@@ -0,0 +1,53 @@
+#ifndef LZR_BINARY_H
+#define LZR_BINARY_H
+
+#include "term.h"
+
+/*
+Binaries live outside of any actor's arena and are shared by reference counting, so passing
+one to another actor never copies its bytes. Small ones are slab objects and the rest get
+their own run of heap chunks. Binaries can be at most 4gb.
+
+Actors refer to a binary through a sub-binary term (LZR_TYPE_BINARY): an object in its arena
+holding a reference to the binary and the (offset, size) range of it which the term is.
+Slicing a sub-binary makes another one of the same binary without copying anything.
+Sub-binaries are tracked as off-heap objects by the arena (see lzr_arena_track) so their
+reference is dropped once a collection finds them dead.
+*/
+typedef struct {
+    uint32_t refs;
+    uint32_t chunks;  // 0 if it's a slab object
+    uint64_t size;
+} lzr_binary_t;
+
+#define lzr_binary_bytes(binary) ((uint8_t*) ((binary) + 1))
+
+// the body of an LZR_TYPE_BINARY object. starts with the lzr_off_heap_t the arena tracks
+typedef struct {
+    lzr_off_heap_t off_heap;
+    uint32_t offset;
+    uint32_t size;
+} lzr_sub_binary_t;
+
+#define lzr_sub_binary(term) ((lzr_sub_binary_t*) lzr_object_body(lzr_term_to_object(term)))
+#define lzr_sub_binary_root(term) ((lzr_binary_t*) LZR_PTR_UNZIP(lzr_sub_binary(term)->off_heap.ref))
+#define lzr_binary_term_size(term) (lzr_sub_binary(term)->size)
+#define lzr_binary_term_bytes(term) (lzr_binary_bytes(lzr_sub_binary_root(term)) + lzr_sub_binary(term)->offset)
+
+// a new binary with uninitialized bytes and a single reference owned by the caller,
+// or NULL if one that big doesn't fit in the heap
+lzr_binary_t* lzr_binary_new(size_t size);
+
+void lzr_binary_ref(lzr_binary_t* self);
+
+// drops a reference, freeing the binary once there are none left
+void lzr_binary_unref(lzr_binary_t* self);
+
+// a sub-binary term for `size` bytes of the binary from `offset`, which takes its own reference.
+// returns LZR_NIL when the arena is full like the other constructors.
+lzr_term_t lzr_binary_term(lzr_arena_t* arena, lzr_binary_t* binary, size_t offset, size_t size);
+
+// a sub-binary for `size` bytes from `offset` into an existing one, sharing its binary
+lzr_term_t lzr_binary_slice(lzr_arena_t* arena, lzr_term_t term, size_t offset, size_t size);
+
+#endif // LZR_BINARY_H
@@ -0,0 +1,56 @@
+#include "code.h"
+#include <string.h>
+
+#define CODE_CHUNKS(bytes) (((bytes) + LZR_HEAP_CHUNK_SIZE - 1) / LZR_HEAP_CHUNK_SIZE)
+
+bool lzr_code_init(lzr_code_t* self, size_t bytes) {
+    size_t num_chunks = CODE_CHUNKS(bytes);
+    assert(num_chunks > 0 && num_chunks <= UINT16_MAX);
+
+    self->sealed = false;
+    self->start = (uint8_t*) lzr_heap_alloc((uint16_t) num_chunks);
+    if (self->start == NULL) {
+        self->top = self->end = NULL;
+        return false;
+    }
+
+    self->top = self->start;
+    self->end = self->start + (num_chunks * LZR_HEAP_CHUNK_SIZE);
+    lzr_memory_commit((void*) self->start, num_chunks * LZR_HEAP_CHUNK_SIZE);
+    return true;
+}
+
+// the chunks go back to the heap as data so they have to be writable again first
+void lzr_code_destroy(lzr_code_t* self) {
+    size_t size = (size_t) (self->end - self->start);
+    if (self->sealed)
+        lzr_memory_protect((void*) self->start, size, false);
+    lzr_memory_decommit((void*) self->start, size);
+    lzr_heap_free((void*) self->start);
+    self->start = self->top = self->end = NULL;
+}
+
+void* lzr_code_emit(lzr_code_t* self, const void* bytes, size_t len) {
+    assert(!self->sealed);
+    if (len > (size_t) (self->end - self->top))
+        return NULL;
+
+    void* code = (void*) self->top;
+    memcpy(code, bytes, len);
+    self->top += len;
+    return code;
+}
+
+void lzr_code_seal(lzr_code_t* self) {
+    assert(!self->sealed);
+    size_t size = (size_t) (self->end - self->start);
+    lzr_memory_flush_icache((void*) self->start, (size_t) (self->top - self->start));
+    lzr_memory_protect((void*) self->start, size, true);
+    self->sealed = true;
+}
+
+void lzr_code_unseal(lzr_code_t* self) {
+    assert(self->sealed);
+    lzr_memory_protect((void*) self->start, (size_t) (self->end - self->start), false);
+    self->sealed = false;
+}
@@ -0,0 +1,33 @@
+#ifndef LZR_CODE_H
+#define LZR_CODE_H
+
+#include "os/heap.h"
+
+/*
+A buffer of native code in its own run of heap chunks, so that code can be referred to
+by compressed pointer like everything else. It's written while read/write and then sealed,
+which flips it to read/execute (W^X) and flushes the icache. Unsealing makes it writable
+again for patching, during which nothing may be running it.
+*/
+typedef struct {
+    uint8_t* start;
+    uint8_t* top;
+    uint8_t* end;
+    bool sealed;
+} lzr_code_t;
+
+// a writable, empty buffer with room for at least `bytes` of code. the heap needs to be committed.
+// returns false (leaving it empty) if the heap has no room for it.
+bool lzr_code_init(lzr_code_t* self, size_t bytes);
+
+void lzr_code_destroy(lzr_code_t* self);
+
+// append code, returning where it was written or NULL if the buffer is full
+void* lzr_code_emit(lzr_code_t* self, const void* bytes, size_t len);
+
+// make everything written so far executable
+void lzr_code_seal(lzr_code_t* self);
+
+void lzr_code_unseal(lzr_code_t* self);
+
+#endif // LZR_CODE_H
@@ -0,0 +1,588 @@
+#include "etf.h"
+#include <string.h>
+
+#define ETF_VERSION 131
+#define ETF_DIST_HEADER 68
+#define ETF_ATOM_CACHE_REF 82
+#define ETF_SMALL_INTEGER 97
+#define ETF_INTEGER 98
+#define ETF_ATOM 100
+#define ETF_SMALL_TUPLE 104
+#define ETF_LARGE_TUPLE 105
+#define ETF_NIL 106
+#define ETF_STRING 107
+#define ETF_LIST 108
+#define ETF_BINARY 109
+#define ETF_SMALL_ATOM 115
+#define ETF_MAP 116
+#define ETF_ATOM_UTF8 118
+#define ETF_SMALL_ATOM_UTF8 119
+
+/*
+The decoder is a state machine which never recurses: every step reads a fixed number of bytes
+(`need`) and then acts on them, and compound terms are frames on an explicit stack. Steps whose
+bytes are all in the input read them from there, the rest are gathered in `scratch` first.
+A step which runs out of arena returns LZR_ETF_FULL without moving on so it's simply run
+again, and a finished term which couldn't be added to its parent waits in `pending`.
+*/
+#define ETF_STEP_START 0       // the version byte, or a tag if there was a distribution header
+#define ETF_STEP_VERSIONED 1   // a tag or distribution header after the version byte
+#define ETF_STEP_TAG 2
+#define ETF_STEP_SMALL_INT 3
+#define ETF_STEP_INT 4
+#define ETF_STEP_ATOM_LEN 5
+#define ETF_STEP_ATOM_TEXT 6
+#define ETF_STEP_CACHE_REF 7
+#define ETF_STEP_TUPLE_ARITY 8
+#define ETF_STEP_LIST_LEN 9
+#define ETF_STEP_STRING_LEN 10
+#define ETF_STEP_STRING_BYTE 11
+#define ETF_STEP_BINARY_LEN 12
+#define ETF_STEP_BINARY 13     // copying the input into `binary`, outside of the steps
+#define ETF_STEP_BINARY_TERM 14
+#define ETF_STEP_MAP_ARITY 15
+#define ETF_STEP_HEADER_COUNT 16
+#define ETF_STEP_HEADER_FLAGS 17
+#define ETF_STEP_HEADER_REF 18
+#define ETF_STEP_HEADER_ATOM_LEN 19
+#define ETF_STEP_HEADER_ATOM_TEXT 20
+#define ETF_STEP_DELIVER 21
+#define ETF_STEP_ERROR 22
+
+#define ETF_FRAME_TUPLE 0
+#define ETF_FRAME_LIST 1   // `remaining` counts the tail too
+#define ETF_FRAME_STRING 2
+#define ETF_FRAME_MAP 3    // `remaining` counts pairs
+
+#define ETF_CONTINUE -1
+
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+
+uint32_t etf_u16(const uint8_t* bytes) {
+    return ((uint32_t) bytes[0] << 8) | bytes[1];
+}
+
+uint32_t etf_u32(const uint8_t* bytes) {
+    return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8) | bytes[3];
+}
+
+void etf_expect(lzr_etf_decoder_t* self, uint8_t step, uint16_t need) {
+    self->step = step;
+    self->need = need;
+    self->have = 0;
+}
+
+int etf_fail(lzr_etf_decoder_t* self) {
+    self->step = ETF_STEP_ERROR;
+    return LZR_ETF_ERROR;
+}
+
+int etf_full(lzr_etf_decoder_t* self, size_t reserve) {
+    self->reserve = reserve;
+    return LZR_ETF_FULL;
+}
+
+void lzr_etf_decoder_init(lzr_etf_decoder_t* self, lzr_atom_table_t* atoms, lzr_arena_t* arena) {
+    self->atoms = atoms;
+    self->arena = arena;
+    self->reserve = 0;
+    self->max_binary = LZR_ETF_MAX_BINARY;
+    self->has_header = false;
+    self->header_refs = 0;
+    self->header_terms = 0;
+    self->binary = NULL;
+    self->pending = LZR_NIL;
+    self->depth = 0;
+    memset(self->atom_cache, 0, sizeof(self->atom_cache));
+    memset(self->recent_atoms, 0, sizeof(self->recent_atoms));
+    etf_expect(self, ETF_STEP_START, 1);
+}
+
+void lzr_etf_decoder_destroy(lzr_etf_decoder_t* self) {
+    if (self->binary != NULL)
+        lzr_binary_unref(self->binary);
+    self->binary = NULL;
+}
+
+size_t lzr_etf_roots(lzr_etf_decoder_t* self, uint32_t** roots) {
+    size_t count = 0;
+    roots[count++] = &self->pending;
+    for (size_t i = 0; i < self->depth; i++) {
+        roots[count++] = &self->stack[i].term;
+        roots[count++] = &self->stack[i].last;
+    }
+    return count;
+}
+
+// Atoms are looked up in the recently decoded ones before going to the atom table. The index
+// only looks at a few bytes so it's much cheaper than the hash the table would need.
+// latin-1 atoms are converted to utf-8 first like every other atom is stored as.
+lzr_term_t etf_intern(lzr_etf_decoder_t* self, const uint8_t* text, size_t len, bool latin1) {
+    char utf8[2 * MAX_ATOM_TEXT];
+    if (latin1) {
+        size_t utf8_len = 0;
+        for (size_t i = 0; i < len; i++) {
+            if (text[i] < 0x80) {
+                utf8[utf8_len++] = (char) text[i];
+            } else {
+                utf8[utf8_len++] = (char) (0xc0 | (text[i] >> 6));
+                utf8[utf8_len++] = (char) (0x80 | (text[i] & 0x3f));
+            }
+        }
+        text = (const uint8_t*) utf8;
+        len = utf8_len;
+    }
+    if (len > MAX_ATOM_TEXT)
+        return LZR_NIL;
+
+    size_t index = len == 0 ? 0 : (len * 31 + text[0] * 7 + text[len - 1]) & (LZR_ETF_RECENT_ATOMS - 1);
+    uint32_t recent = self->recent_atoms[index];
+    if (recent != 0) {
+        lzr_atom_t* atom = (lzr_atom_t*) LZR_PTR_UNZIP(recent);
+        if (lzr_atom_len(atom) == len && memcmp(lzr_atom_text_ptr(atom), text, len) == 0)
+            return (lzr_term_t) recent;
+    }
+
+    lzr_atom_t* atom = lzr_atom_table_upsert(self->atoms, (const char*) text, len);
+    self->recent_atoms[index] = LZR_PTR_ZIP(atom);
+    return lzr_term_from_atom(atom);
+}
+
+// after a frame gets an element: a string reads its next byte and everything else a term
+void etf_next(lzr_etf_decoder_t* self) {
+    if (self->depth > 0 && self->stack[self->depth - 1].type == ETF_FRAME_STRING) {
+        etf_expect(self, ETF_STEP_STRING_BYTE, 1);
+    } else {
+        etf_expect(self, ETF_STEP_TAG, 1);
+    }
+}
+
+int etf_push(lzr_etf_decoder_t* self, uint8_t type, uint32_t remaining, lzr_term_t term) {
+    if (self->depth == LZR_ETF_MAX_DEPTH)
+        return etf_fail(self);
+
+    lzr_etf_frame_t* frame = &self->stack[self->depth++];
+    frame->type = type;
+    frame->has_key = false;
+    frame->index = 0;
+    frame->remaining = remaining;
+    frame->term = term;
+    frame->last = LZR_NIL;
+    etf_next(self);
+    return ETF_CONTINUE;
+}
+
+int etf_defer(lzr_etf_decoder_t* self, lzr_term_t term, size_t reserve) {
+    self->pending = term;
+    etf_expect(self, ETF_STEP_DELIVER, 0);
+    return etf_full(self, reserve);
+}
+
+void etf_header_reset(lzr_etf_decoder_t* self) {
+    self->has_header = false;
+    self->header_refs = 0;
+    self->header_terms = 0;
+}
+
+// add a finished term to the frame it's in, finishing the frames it completes along the way
+int etf_complete(lzr_etf_decoder_t* self, lzr_term_t term) {
+    while (self->depth > 0) {
+        lzr_etf_frame_t* frame = &self->stack[self->depth - 1];
+        switch (frame->type) {
+            case ETF_FRAME_TUPLE:
+                lzr_tuple_elements(frame->term)[frame->index++] = term;
+                break;
+
+            case ETF_FRAME_MAP:
+                if (!frame->has_key) {
+                    if (!lzr_term_is_atom(term) && !lzr_term_is_small(term))
+                        return etf_fail(self);
+                    frame->last = term;
+                    frame->has_key = true;
+                    etf_next(self);
+                    return ETF_CONTINUE;
+                } else {
+                    lzr_term_t map = lzr_map_put(self->arena, frame->term, frame->last, term);
+                    if (map == LZR_NIL)
+                        return etf_defer(self, term, LZR_MAP_PUT_RESERVE);
+                    frame->term = map;
+                    frame->has_key = false;
+                }
+                break;
+
+            case ETF_FRAME_LIST:
+            case ETF_FRAME_STRING:
+                if (frame->type == ETF_FRAME_LIST && frame->remaining == 1) {
+                    if (frame->last == LZR_NIL) {
+                        frame->term = term;
+                    } else {
+                        lzr_cons_tail(frame->last) = term;
+                    }
+                } else {
+                    lzr_term_t cons = lzr_cons_new(self->arena, term, LZR_NIL);
+                    if (cons == LZR_NIL)
+                        return etf_defer(self, term, sizeof(lzr_object_t) + 2 * sizeof(lzr_term_t));
+                    if (frame->last == LZR_NIL) {
+                        frame->term = cons;
+                    } else {
+                        lzr_cons_tail(frame->last) = cons;
+                    }
+                    frame->last = cons;
+                }
+                break;
+        }
+
+        if (--frame->remaining > 0) {
+            etf_next(self);
+            return ETF_CONTINUE;
+        }
+        term = frame->term;
+        self->depth--;
+    }
+
+    // the refs of a finished message's header mustn't resolve in the messages after it
+    if (self->has_header && --self->header_terms == 0)
+        etf_header_reset(self);
+
+    self->pending = term;
+    etf_expect(self, ETF_STEP_START, 1);
+    return LZR_ETF_TERM;
+}
+
+int etf_tag(lzr_etf_decoder_t* self, uint8_t tag) {
+    self->tag = tag;
+    switch (tag) {
+        case ETF_SMALL_INTEGER:
+            etf_expect(self, ETF_STEP_SMALL_INT, 1);
+            break;
+        case ETF_INTEGER:
+            etf_expect(self, ETF_STEP_INT, 4);
+            break;
+        case ETF_ATOM:
+        case ETF_ATOM_UTF8:
+            etf_expect(self, ETF_STEP_ATOM_LEN, 2);
+            break;
+        case ETF_SMALL_ATOM:
+        case ETF_SMALL_ATOM_UTF8:
+            etf_expect(self, ETF_STEP_ATOM_LEN, 1);
+            break;
+        case ETF_ATOM_CACHE_REF:
+            etf_expect(self, ETF_STEP_CACHE_REF, 1);
+            break;
+        case ETF_SMALL_TUPLE:
+            etf_expect(self, ETF_STEP_TUPLE_ARITY, 1);
+            break;
+        case ETF_LARGE_TUPLE:
+            etf_expect(self, ETF_STEP_TUPLE_ARITY, 4);
+            break;
+        case ETF_NIL:
+            return etf_complete(self, LZR_NIL);
+        case ETF_STRING:
+            etf_expect(self, ETF_STEP_STRING_LEN, 2);
+            break;
+        case ETF_LIST:
+            etf_expect(self, ETF_STEP_LIST_LEN, 4);
+            break;
+        case ETF_BINARY:
+            etf_expect(self, ETF_STEP_BINARY_LEN, 4);
+            break;
+        case ETF_MAP:
+            etf_expect(self, ETF_STEP_MAP_ARITY, 4);
+            break;
+        default:
+            return etf_fail(self);
+    }
+    return ETF_CONTINUE;
+}
+
+// the flags of each atom cache ref are a nibble, followed by one more for the whole header
+uint8_t etf_header_flags(lzr_etf_decoder_t* self, size_t index) {
+    uint8_t flags = self->header_flags[index / 2];
+    return (index & 1) ? (flags >> 4) : (flags & 0xf);
+}
+
+int etf_header_next(lzr_etf_decoder_t* self) {
+    if (++self->header_at < self->header_refs) {
+        etf_expect(self, ETF_STEP_HEADER_REF, 1);
+    } else {
+        self->has_header = true;
+        self->header_terms = 2;
+        etf_expect(self, ETF_STEP_START, 1);
+    }
+    return ETF_CONTINUE;
+}
+
+int etf_step(lzr_etf_decoder_t* self, const uint8_t* bytes) {
+    switch (self->step) {
+        case ETF_STEP_START:
+            if (bytes[0] == ETF_VERSION) {
+                etf_expect(self, ETF_STEP_VERSIONED, 1);
+                return ETF_CONTINUE;
+            }
+            if (!self->has_header)
+                return etf_fail(self);
+            return etf_tag(self, bytes[0]);
+
+        case ETF_STEP_VERSIONED:
+            if (bytes[0] == ETF_DIST_HEADER) {
+                etf_expect(self, ETF_STEP_HEADER_COUNT, 1);
+                return ETF_CONTINUE;
+            }
+            etf_header_reset(self);
+            return etf_tag(self, bytes[0]);
+
+        case ETF_STEP_TAG:
+            return etf_tag(self, bytes[0]);
+
+        case ETF_STEP_SMALL_INT:
+            return etf_complete(self, lzr_term_from_small(bytes[0]));
+
+        case ETF_STEP_INT: {
+            // no bignums so integers have to fit in a small
+            int32_t value = (int32_t) etf_u32(bytes);
+            if (value < LZR_SMALL_MIN || value > LZR_SMALL_MAX)
+                return etf_fail(self);
+            return etf_complete(self, lzr_term_from_small(value));
+        }
+
+        case ETF_STEP_ATOM_LEN: {
+            uint32_t len = self->need == 2 ? etf_u16(bytes) : bytes[0];
+            if (len > MAX_ATOM_TEXT)
+                return etf_fail(self);
+            etf_expect(self, ETF_STEP_ATOM_TEXT, (uint16_t) len);
+            return ETF_CONTINUE;
+        }
+
+        case ETF_STEP_ATOM_TEXT: {
+            bool latin1 = self->tag == ETF_ATOM || self->tag == ETF_SMALL_ATOM;
+            lzr_term_t atom = etf_intern(self, bytes, self->need, latin1);
+            if (atom == LZR_NIL)
+                return etf_fail(self);
+            return etf_complete(self, atom);
+        }
+
+        case ETF_STEP_CACHE_REF:
+            if (bytes[0] >= self->header_refs)
+                return etf_fail(self);
+            return etf_complete(self, (lzr_term_t) self->refs[bytes[0]]);
+
+        case ETF_STEP_TUPLE_ARITY: {
+            uint32_t arity = self->need == 4 ? etf_u32(bytes) : bytes[0];
+            if (arity > UINT16_MAX)
+                return etf_fail(self);
+            lzr_term_t tuple = lzr_tuple_new(self->arena, (uint16_t) arity);
+            if (tuple == LZR_NIL)
+                return etf_full(self, sizeof(lzr_object_t) + arity * sizeof(lzr_term_t));
+            if (arity == 0)
+                return etf_complete(self, tuple);
+            return etf_push(self, ETF_FRAME_TUPLE, arity, tuple);
+        }
+
+        case ETF_STEP_LIST_LEN: {
+            uint32_t len = etf_u32(bytes);
+            if (len == UINT32_MAX)
+                return etf_fail(self);
+            return etf_push(self, ETF_FRAME_LIST, len + 1, LZR_NIL);
+        }
+
+        case ETF_STEP_STRING_LEN: {
+            uint32_t len = etf_u16(bytes);
+            if (len == 0)
+                return etf_complete(self, LZR_NIL);
+            return etf_push(self, ETF_FRAME_STRING, len, LZR_NIL);
+        }
+
+        case ETF_STEP_STRING_BYTE:
+            return etf_complete(self, lzr_term_from_small(bytes[0]));
+
+        case ETF_STEP_BINARY_LEN: {
+            uint32_t size = etf_u32(bytes);
+            if (size > self->max_binary)
+                return etf_fail(self);
+            self->binary = lzr_binary_new(size);
+            if (self->binary == NULL)
+                return etf_fail(self);
+            self->binary_at = 0;
+            etf_expect(self, ETF_STEP_BINARY, 0);
+            return ETF_CONTINUE;
+        }
+
+        // the sub-binary takes its own reference to the binary
+        case ETF_STEP_BINARY_TERM: {
+            lzr_term_t term = lzr_binary_term(self->arena, self->binary, 0, self->binary->size);
+            if (term == LZR_NIL)
+                return etf_full(self, sizeof(lzr_object_t) + sizeof(lzr_sub_binary_t));
+            lzr_binary_unref(self->binary);
+            self->binary = NULL;
+            return etf_complete(self, term);
+        }
+
+        case ETF_STEP_MAP_ARITY: {
+            uint32_t arity = etf_u32(bytes);
+            lzr_term_t map = lzr_map_new(self->arena);
+            if (map == LZR_NIL)
+                return etf_full(self, sizeof(lzr_object_t));
+            if (arity == 0)
+                return etf_complete(self, map);
+            return etf_push(self, ETF_FRAME_MAP, arity, map);
+        }
+
+        case ETF_STEP_HEADER_COUNT:
+            self->header_refs = bytes[0];
+            self->header_at = 0;
+            if (self->header_refs == 0) {
+                self->has_header = true;
+                self->header_terms = 2;
+                etf_expect(self, ETF_STEP_START, 1);
+            } else {
+                etf_expect(self, ETF_STEP_HEADER_FLAGS, (uint16_t) (self->header_refs / 2 + 1));
+            }
+            return ETF_CONTINUE;
+
+        case ETF_STEP_HEADER_FLAGS:
+            memcpy(self->header_flags, bytes, self->need);
+            self->header_long_atoms = (etf_header_flags(self, self->header_refs) & 1) != 0;
+            etf_expect(self, ETF_STEP_HEADER_REF, 1);
+            return ETF_CONTINUE;
+
+        // a ref either fills a slot of the cache with a new atom or reuses what's already in it
+        case ETF_STEP_HEADER_REF: {
+            uint8_t flags = etf_header_flags(self, self->header_at);
+            uint16_t slot = (uint16_t) ((flags & 0x7) * 256 + bytes[0]);
+            if (flags & 0x8) {
+                self->header_slot = slot;
+                etf_expect(self, ETF_STEP_HEADER_ATOM_LEN, self->header_long_atoms ? 2 : 1);
+                return ETF_CONTINUE;
+            }
+            if (self->atom_cache[slot] == 0)
+                return etf_fail(self);
+            self->refs[self->header_at] = self->atom_cache[slot];
+            return etf_header_next(self);
+        }
+
+        case ETF_STEP_HEADER_ATOM_LEN: {
+            uint32_t len = self->need == 2 ? etf_u16(bytes) : bytes[0];
+            if (len > MAX_ATOM_TEXT)
+                return etf_fail(self);
+            etf_expect(self, ETF_STEP_HEADER_ATOM_TEXT, (uint16_t) len);
+            return ETF_CONTINUE;
+        }
+
+        case ETF_STEP_HEADER_ATOM_TEXT: {
+            lzr_term_t atom = etf_intern(self, bytes, self->need, false);
+            if (atom == LZR_NIL)
+                return etf_fail(self);
+            self->atom_cache[self->header_slot] = atom;
+            self->refs[self->header_at] = atom;
+            return etf_header_next(self);
+        }
+
+        case ETF_STEP_DELIVER: {
+            lzr_term_t term = self->pending;
+            self->pending = LZR_NIL;
+            return etf_complete(self, term);
+        }
+
+        default:
+            return etf_fail(self);
+    }
+}
+
+// Leaf terms which are all there in the input are decoded from it in one go instead of taking
+// a step for the tag and another for the rest. Returns how many bytes it used, 0 if it didn't.
+size_t etf_leaf(lzr_etf_decoder_t* self, const uint8_t* bytes, size_t len, int* status) {
+    if (len < 2)
+        return 0;
+
+    switch (bytes[0]) {
+        case ETF_SMALL_INTEGER:
+            *status = etf_complete(self, lzr_term_from_small(bytes[1]));
+            return 2;
+
+        case ETF_ATOM_CACHE_REF:
+            if (bytes[1] >= self->header_refs)
+                return 0;
+            *status = etf_complete(self, (lzr_term_t) self->refs[bytes[1]]);
+            return 2;
+
+        case ETF_SMALL_ATOM:
+        case ETF_SMALL_ATOM_UTF8: {
+            size_t text_len = bytes[1];
+            if (len < 2 + text_len)
+                return 0;
+            lzr_term_t atom = etf_intern(self, bytes + 2, text_len, bytes[0] == ETF_SMALL_ATOM);
+            if (atom == LZR_NIL)
+                return 0;
+            *status = etf_complete(self, atom);
+            return 2 + text_len;
+        }
+
+        case ETF_NIL:
+            *status = etf_complete(self, LZR_NIL);
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+int lzr_etf_decode(lzr_etf_decoder_t* self, const uint8_t* bytes, size_t len, size_t* consumed, lzr_term_t* term) {
+    size_t at = 0;
+    int status = ETF_CONTINUE;
+
+    while (status == ETF_CONTINUE) {
+        if (self->step == ETF_STEP_ERROR) {
+            status = LZR_ETF_ERROR;
+            break;
+        }
+
+        if (self->step == ETF_STEP_BINARY) {
+            size_t copy = MIN(self->binary->size - self->binary_at, len - at);
+            memcpy(lzr_binary_bytes(self->binary) + self->binary_at, bytes + at, copy);
+            self->binary_at += (uint32_t) copy;
+            at += copy;
+            if (self->binary_at < self->binary->size) {
+                status = LZR_ETF_MORE;
+                break;
+            }
+            etf_expect(self, ETF_STEP_BINARY_TERM, 0);
+        }
+
+        if (self->step == ETF_STEP_TAG) {
+            size_t used = etf_leaf(self, bytes + at, len - at, &status);
+            if (used > 0) {
+                at += used;
+                continue;
+            }
+        }
+
+        // read the step's bytes straight from the input when they're all there
+        const uint8_t* step_bytes = self->scratch;
+        if (self->have == 0 && len - at >= self->need) {
+            step_bytes = bytes + at;
+            at += self->need;
+            self->have = self->need;
+        } else if (self->have < self->need) {
+            size_t copy = MIN((size_t) (self->need - self->have), len - at);
+            memcpy(self->scratch + self->have, bytes + at, copy);
+            self->have += (uint16_t) copy;
+            at += copy;
+            if (self->have < self->need) {
+                status = LZR_ETF_MORE;
+                break;
+            }
+        }
+
+        // the step is run again once there's room so its bytes have to outlive the input
+        status = etf_step(self, step_bytes);
+        if (status == LZR_ETF_FULL && step_bytes != self->scratch)
+            memcpy(self->scratch, step_bytes, self->need);
+    }
+
+    *consumed = at;
+    if (status == LZR_ETF_TERM) {
+        *term = self->pending;
+        self->pending = LZR_NIL;
+    }
+    return status;
+}
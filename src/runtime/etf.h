@@ -0,0 +1,96 @@
+#ifndef LZR_ETF_H
+#define LZR_ETF_H
+
+#include "binary.h"
+#include "map.h"
+
+/*
+A streaming decoder for the external term format that other nodes send messages in.
+Bytes are fed in as they arrive, in pieces of any size, and terms are built straight into
+an arena as they're decoded: tuples are allocated as soon as their arity is read and filled
+in place, lists are consed up front to back, maps are put into as their pairs complete and
+binaries are copied from the input into a shared binary (see binary.h) and nowhere else.
+Only the few bytes of a header or atom split between two pieces are ever buffered.
+
+Supported are small integers, atoms, nil, tuples, lists, strings, binaries and maps (keyed by
+atoms or small integers, see map.h). Anything else (floats, bignums, pids, ...) is an error.
+So is a binary longer than the decoder's `max_binary`, since the length is all it takes
+for a peer to make the decoder allocate up to 4gb.
+
+Each term starts with the version byte 131, which can be followed by a distribution header
+instead of a term. Like BEAM's distribution atom cache, a header lists the atoms the terms
+after it refer to (with ATOM_CACHE_REF) as slots of the connection's cache of
+LZR_ETF_ATOM_CACHE_SIZE atoms. A slot's text is only sent when it's first filled, after which
+referring to the atom is just its index: no hashing or probing of the atom table at all.
+Once a header was seen the terms after it may also leave out their version byte. A header
+only covers the message it starts: the control message and its payload, if it has one.
+
+Atoms sent inline (ATOM_EXT and co) go through a small direct mapped cache of the atoms
+recently decoded, indexed by their length and first & last bytes, so a repeated one is only
+a compare against the cached atom's text instead of being hashed and looked up again.
+*/
+#define LZR_ETF_ATOM_CACHE_SIZE 2048
+#define LZR_ETF_RECENT_ATOMS 256
+#define LZR_ETF_MAX_DEPTH 64
+#define LZR_ETF_MAX_ROOTS (2 * LZR_ETF_MAX_DEPTH + 1)
+#define LZR_ETF_MAX_BINARY (64 * 1024 * 1024) // the default `max_binary`
+
+// what lzr_etf_decode() stopped for
+#define LZR_ETF_MORE 0  // all of the input was consumed without finishing a term
+#define LZR_ETF_TERM 1  // a term was decoded
+#define LZR_ETF_FULL 2  // the arena is full, see lzr_etf_roots()
+#define LZR_ETF_ERROR 3 // the input is malformed or uses something unsupported
+
+// a compound term being built. `term` is the tuple, map or first cons of a list and
+// `last` is the last cons of a list or the key waiting for its value in a map.
+typedef struct {
+    uint8_t type;
+    bool has_key;
+    uint16_t index;
+    uint32_t remaining;
+    lzr_term_t term;
+    lzr_term_t last;
+} lzr_etf_frame_t;
+
+typedef struct {
+    lzr_atom_table_t* atoms;
+    lzr_arena_t* arena;
+    size_t reserve;       // how much the arena needs free after LZR_ETF_FULL
+    size_t max_binary;    // the longest binary accepted, can be changed after init
+    uint8_t step;
+    uint8_t tag;
+    uint16_t need;
+    uint16_t have;
+    uint8_t scratch[256]; // the bytes of the current step
+    bool has_header;
+    uint8_t header_refs;
+    uint8_t header_terms; // how many more terms the header covers
+    uint8_t header_at;
+    bool header_long_atoms;
+    uint16_t header_slot;
+    uint8_t header_flags[128];
+    lzr_binary_t* binary;
+    uint32_t binary_at;
+    lzr_term_t pending;   // a finished term waiting for room in the arena to be added to its parent
+    size_t depth;
+    lzr_etf_frame_t stack[LZR_ETF_MAX_DEPTH];
+    uint32_t refs[255];   // the atoms of the current distribution header (compressed)
+    uint32_t atom_cache[LZR_ETF_ATOM_CACHE_SIZE];
+    uint32_t recent_atoms[LZR_ETF_RECENT_ATOMS];
+} lzr_etf_decoder_t;
+
+// one decoder per connection, interning atoms into `atoms` and building terms in `arena`
+void lzr_etf_decoder_init(lzr_etf_decoder_t* self, lzr_atom_table_t* atoms, lzr_arena_t* arena);
+
+void lzr_etf_decoder_destroy(lzr_etf_decoder_t* self);
+
+// decode from `bytes` until a term is done (LZR_ETF_TERM, storing it in `term`) or something
+// else stops it. `consumed` is set to how many bytes were used: call it again with the rest.
+// After LZR_ETF_ERROR the decoder stays failed.
+int lzr_etf_decode(lzr_etf_decoder_t* self, const uint8_t* bytes, size_t len, size_t* consumed, lzr_term_t* term);
+
+// the terms the decoder is holding on to in the arena, for the lzr_arena_collect()
+// (with `reserve` bytes to spare) which should follow LZR_ETF_FULL. Returns how many.
+size_t lzr_etf_roots(lzr_etf_decoder_t* self, uint32_t** roots);
+
+#endif // LZR_ETF_H
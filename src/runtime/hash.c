@@ -1,38 +1,94 @@
 #include "hash.h"
+#include <string.h>
 
 uint32_t fx_hash(const char* bytes, size_t len);
-uint32_t fnv1a_hash(const char* bytes, size_t len);
+uint32_t word_hash(const char* bytes, size_t len);
 
 uint32_t lzr_hash_bytes(const char* bytes, size_t len) {
     if (len >= 512)
         return fx_hash(bytes, len);
-    return fnv1a_hash(bytes, len);
+    return word_hash(bytes, len);
 }
 
-uint32_t fnv1a_hash(const char* bytes, size_t len) {
-    uint32_t hash = 0x811c9dc5;
-    while (len--)
-        hash = (hash ^ (*bytes++)) * 0x1000193;
-    return hash;
+// unaligned little endian reads which compile down to a single load
+uint64_t hash_read64(const char* bytes) {
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+uint64_t hash_read32(const char* bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+// fold the full 128-bit product of two words back into 64 bits
+uint64_t hash_mix(uint64_t a, uint64_t b) {
+    __uint128_t product = (__uint128_t) a * b;
+    return ((uint64_t) product) ^ ((uint64_t) (product >> 64));
+}
+
+#define WORD_HASH_SEED 0xa0761d6478bd642fULL
+#define WORD_HASH_PRIME 0xe7037ed1a0b428dbULL
+
+/*
+Hashes a word (or two) at a time instead of a byte at a time like fnv1a which matters
+since every atom key is <= MAX_ATOM_TEXT bytes. Based on wyhash's mum mixing: keys <= 16
+bytes are read using (possibly overlapping) loads without any loop at all and longer keys
+consume 16 bytes per multiply. The final fold keeps both the low 7 bits (atom control bytes)
+and the higher bits (atom group index) well distributed.
+*/
+uint32_t word_hash(const char* bytes, size_t len) {
+    uint64_t seed = WORD_HASH_SEED;
+    uint64_t a, b;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            const size_t middle = (len >> 3) << 2;
+            a = (hash_read32(bytes) << 32) | hash_read32(bytes + middle);
+            b = (hash_read32(bytes + len - 4) << 32) | hash_read32(bytes + len - 4 - middle);
+        } else if (len > 0) {
+            a = (((uint64_t) (uint8_t) bytes[0]) << 16) |
+                (((uint64_t) (uint8_t) bytes[len >> 1]) << 8) |
+                ((uint64_t) (uint8_t) bytes[len - 1]);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+
+    } else {
+        size_t remaining = len;
+        while (remaining > 16) {
+            seed = hash_mix(hash_read64(bytes) ^ WORD_HASH_PRIME, hash_read64(bytes + 8) ^ seed);
+            bytes += 16;
+            remaining -= 16;
+        }
+        a = hash_read64(bytes + remaining - 16);
+        b = hash_read64(bytes + remaining - 8);
+    }
+
+    uint64_t hash = hash_mix(WORD_HASH_PRIME ^ len, hash_mix(a ^ WORD_HASH_PRIME, b ^ seed));
+    return (uint32_t) (hash ^ (hash >> 32));
 }
 
 uint32_t fx_hash(const char* bytes, size_t len) {
     #define fx_rotl(type, value, shift) \
         ((value << shift) | (value >> (sizeof(type) * 8 - shift)))
     #define fx_hash_word(type, word) \
-        (fx_rotl(type, hash, 5) ^ (word) * 0x517cc1b727220a95ULL)
+        ((fx_rotl(type, hash, 5) ^ (word)) * 0x517cc1b727220a95ULL)
 
     size_t hash = 0;
     while (len >= sizeof(size_t)) {
-        hash = fx_hash_word(size_t, *((size_t*) bytes));
+        hash = fx_hash_word(size_t, hash_read64(bytes));
         bytes += sizeof(size_t);
         len -= sizeof(size_t);
     }
 
     while (len--)
-        hash = fx_hash_word(size_t, (*bytes++));
+        hash = fx_hash_word(size_t, (uint8_t) (*bytes++));
 
     return (uint32_t) (hash >> 32);
     #undef fx_rotl
     #undef fx_hash_word
-}
\ No newline at end of file
+}
@@ -0,0 +1,360 @@
+#include "map.h"
+#include <string.h>
+
+#define MAP_BITS 5
+#define MAP_FANOUT (1 << MAP_BITS)
+#define MAP_HASH_BITS 32
+
+typedef struct {
+    uint32_t hash;
+    lzr_term_t key;
+    lzr_term_t value;
+} map_entry_t;
+
+// small integers don't have a hash lying around so they're mixed into one
+uint32_t map_hash(lzr_term_t key) {
+    if (lzr_term_is_small(key)) {
+        uint32_t hash = key * 0x9e3779b1u;
+        return hash ^ (hash >> 15);
+    }
+
+    assert(lzr_term_is_atom(key));
+    return lzr_term_to_atom(key)->hash;
+}
+
+#define map_fragment(hash, shift) (((hash) >> (shift)) & (MAP_FANOUT - 1))
+#define map_index(bitmap, bit) ((size_t) __builtin_popcount((bitmap) & ((bit) - 1)))
+
+#define flat_size(map) ((size_t) (map)->refs / 2)
+#define flat_keys(map) lzr_object_fields(map)
+#define flat_values(map) (lzr_object_fields(map) + flat_size(map))
+
+// the untraced words come right after the traced ones, the key count only in the root node
+#define node_datamap(node) (lzr_object_fields(node)[(node)->refs])
+#define node_nodemap(node) (lzr_object_fields(node)[(node)->refs + 1])
+#define node_size(node) (lzr_object_fields(node)[(node)->refs + 2])
+#define node_children(node) (lzr_object_fields(node) + 2 * __builtin_popcount(node_datamap(node)))
+
+#define collision_size(node) ((size_t) (node)->refs / 2)
+
+lzr_object_t* flat_alloc(lzr_arena_t* arena, size_t count) {
+    return lzr_arena_alloc(arena, 2 * count * sizeof(uint32_t), (uint16_t) (2 * count), LZR_TYPE_MAP);
+}
+
+lzr_object_t* node_alloc(lzr_arena_t* arena, uint32_t datamap, uint32_t nodemap, bool root) {
+    size_t refs = 2 * __builtin_popcount(datamap) + __builtin_popcount(nodemap);
+    size_t untraced = root ? 3 : 2;
+    lzr_object_t* node = lzr_arena_alloc(arena, (refs + untraced) * sizeof(uint32_t), (uint16_t) refs, LZR_TYPE_MAP_NODE);
+    if (node == NULL)
+        return NULL;
+
+    node_datamap(node) = datamap;
+    node_nodemap(node) = nodemap;
+    return node;
+}
+
+lzr_object_t* node_copy(lzr_arena_t* arena, lzr_object_t* node, bool root) {
+    lzr_object_t* copy = node_alloc(arena, node_datamap(node), node_nodemap(node), root);
+    if (copy != NULL)
+        memcpy(lzr_object_fields(copy), lzr_object_fields(node), node->refs * sizeof(uint32_t));
+    return copy;
+}
+
+lzr_object_t* collision_alloc(lzr_arena_t* arena, size_t count) {
+    return lzr_arena_alloc(arena, 2 * count * sizeof(uint32_t), (uint16_t) (2 * count), LZR_TYPE_MAP_COLLISION);
+}
+
+// the index of the first key that's not below `key`
+size_t flat_search(lzr_object_t* map, lzr_term_t key) {
+    uint32_t* keys = flat_keys(map);
+    size_t low = 0;
+    size_t high = flat_size(map);
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (keys[mid] < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// A trie of `count` entries whose hashes all agree below `shift`. Entries with a fragment
+// to themselves are stored inline and the rest are built into children, so this is only ever
+// called with a handful of entries: the two keys which ended up sharing a slot in a node or the
+// keys of a flat map outgrowing it.
+lzr_object_t* map_build(lzr_arena_t* arena, map_entry_t* entries, size_t count, uint32_t shift, bool root) {
+    if (shift >= MAP_HASH_BITS) {
+        lzr_object_t* node = collision_alloc(arena, count);
+        if (node == NULL)
+            return NULL;
+        for (size_t i = 0; i < count; i++) {
+            lzr_object_fields(node)[2 * i] = entries[i].key;
+            lzr_object_fields(node)[2 * i + 1] = entries[i].value;
+        }
+        return node;
+    }
+
+    // group the entries by fragment, which is also the order they go into the node in
+    for (size_t i = 1; i < count; i++) {
+        map_entry_t entry = entries[i];
+        size_t j = i;
+        for (; j > 0 && map_fragment(entries[j - 1].hash, shift) > map_fragment(entry.hash, shift); j--)
+            entries[j] = entries[j - 1];
+        entries[j] = entry;
+    }
+
+    uint32_t datamap = 0;
+    uint32_t nodemap = 0;
+    uint32_t children[MAP_FANOUT];
+    size_t num_children = 0;
+    for (size_t i = 0, end; i < count; i = end) {
+        uint32_t fragment = map_fragment(entries[i].hash, shift);
+        for (end = i + 1; end < count && map_fragment(entries[end].hash, shift) == fragment; end++) {}
+
+        if (end - i == 1) {
+            datamap |= 1u << fragment;
+            continue;
+        }
+
+        lzr_object_t* child = map_build(arena, &entries[i], end - i, shift + MAP_BITS, false);
+        if (child == NULL)
+            return NULL;
+        nodemap |= 1u << fragment;
+        children[num_children++] = LZR_PTR_ZIP(child);
+    }
+
+    lzr_object_t* node = node_alloc(arena, datamap, nodemap, root);
+    if (node == NULL)
+        return NULL;
+
+    uint32_t* fields = lzr_object_fields(node);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t bit = 1u << map_fragment(entries[i].hash, shift);
+        if ((datamap & bit) == 0)
+            continue;
+        size_t index = map_index(datamap, bit);
+        fields[2 * index] = entries[i].key;
+        fields[2 * index + 1] = entries[i].value;
+    }
+    memcpy(node_children(node), children, num_children * sizeof(uint32_t));
+    return node;
+}
+
+lzr_object_t* collision_put(lzr_arena_t* arena, lzr_object_t* node, map_entry_t* entry, bool* added) {
+    size_t count = collision_size(node);
+    uint32_t* fields = lzr_object_fields(node);
+
+    size_t index = 0;
+    while (index < count && fields[2 * index] != entry->key)
+        index++;
+    if (index < count && fields[2 * index + 1] == entry->value)
+        return node;
+
+    *added = index == count;
+    lzr_object_t* copy = collision_alloc(arena, count + *added);
+    if (copy == NULL)
+        return NULL;
+
+    memcpy(lzr_object_fields(copy), fields, 2 * count * sizeof(uint32_t));
+    lzr_object_fields(copy)[2 * index] = entry->key;
+    lzr_object_fields(copy)[2 * index + 1] = entry->value;
+    return copy;
+}
+
+// returns the node itself if nothing changed, otherwise a copy of it with the entry put in.
+// the root's key count is left for lzr_map_put() to fill in.
+lzr_object_t* node_put(lzr_arena_t* arena, lzr_object_t* node, map_entry_t* entry, uint32_t shift, bool root, bool* added) {
+    if (node->type == LZR_TYPE_MAP_COLLISION)
+        return collision_put(arena, node, entry, added);
+
+    uint32_t* fields = lzr_object_fields(node);
+    uint32_t datamap = node_datamap(node);
+    uint32_t nodemap = node_nodemap(node);
+    uint32_t bit = 1u << map_fragment(entry->hash, shift);
+
+    if (nodemap & bit) {
+        size_t child_index = map_index(nodemap, bit);
+        lzr_object_t* child = (lzr_object_t*) LZR_PTR_UNZIP(node_children(node)[child_index]);
+        lzr_object_t* new_child = node_put(arena, child, entry, shift + MAP_BITS, false, added);
+        if (new_child == NULL)
+            return NULL;
+        if (new_child == child)
+            return node;
+
+        lzr_object_t* copy = node_copy(arena, node, root);
+        if (copy != NULL)
+            node_children(copy)[child_index] = LZR_PTR_ZIP(new_child);
+        return copy;
+    }
+
+    size_t index = map_index(datamap, bit);
+    if ((datamap & bit) && fields[2 * index] == entry->key) {
+        if (fields[2 * index + 1] == entry->value)
+            return node;
+
+        lzr_object_t* copy = node_copy(arena, node, root);
+        if (copy != NULL)
+            lzr_object_fields(copy)[2 * index + 1] = entry->value;
+        return copy;
+    }
+
+    *added = true;
+    if ((datamap & bit) == 0) {
+        lzr_object_t* copy = node_alloc(arena, datamap | bit, nodemap, root);
+        if (copy == NULL)
+            return NULL;
+
+        uint32_t* to = lzr_object_fields(copy);
+        memcpy(to, fields, 2 * index * sizeof(uint32_t));
+        to[2 * index] = entry->key;
+        to[2 * index + 1] = entry->value;
+        memcpy(to + 2 * index + 2, fields + 2 * index, (node->refs - 2 * index) * sizeof(uint32_t));
+        return copy;
+    }
+
+    // another key has the slot so push both down into a new child in its place
+    map_entry_t pair[2] = { { map_hash(fields[2 * index]), fields[2 * index], fields[2 * index + 1] }, *entry };
+    lzr_object_t* child = map_build(arena, pair, 2, shift + MAP_BITS, false);
+    if (child == NULL)
+        return NULL;
+
+    lzr_object_t* copy = node_alloc(arena, datamap & ~bit, nodemap | bit, root);
+    if (copy == NULL)
+        return NULL;
+
+    size_t num_data = __builtin_popcount(datamap);
+    size_t num_children = __builtin_popcount(nodemap);
+    size_t child_index = map_index(nodemap, bit);
+    uint32_t* to = lzr_object_fields(copy);
+    memcpy(to, fields, 2 * index * sizeof(uint32_t));
+    memcpy(to + 2 * index, fields + 2 * index + 2, 2 * (num_data - index - 1) * sizeof(uint32_t));
+
+    uint32_t* from_children = fields + 2 * num_data;
+    uint32_t* to_children = to + 2 * (num_data - 1);
+    memcpy(to_children, from_children, child_index * sizeof(uint32_t));
+    to_children[child_index] = LZR_PTR_ZIP(child);
+    memcpy(to_children + child_index + 1, from_children + child_index, (num_children - child_index) * sizeof(uint32_t));
+    return copy;
+}
+
+lzr_term_t flat_put(lzr_arena_t* arena, lzr_object_t* map, lzr_term_t key, lzr_term_t value) {
+    size_t count = flat_size(map);
+    size_t index = flat_search(map, key);
+    uint32_t* keys = flat_keys(map);
+    uint32_t* values = flat_values(map);
+
+    if (index < count && keys[index] == key) {
+        if (values[index] == value)
+            return lzr_term_from_object(map);
+
+        lzr_object_t* copy = flat_alloc(arena, count);
+        if (copy == NULL)
+            return LZR_NIL;
+        memcpy(lzr_object_fields(copy), lzr_object_fields(map), 2 * count * sizeof(uint32_t));
+        flat_values(copy)[index] = value;
+        return lzr_term_from_object(copy);
+    }
+
+    if (count == LZR_MAP_FLAT_MAX) {
+        map_entry_t entries[LZR_MAP_FLAT_MAX + 1];
+        for (size_t i = 0; i < count; i++)
+            entries[i] = (map_entry_t) { map_hash(keys[i]), keys[i], values[i] };
+        entries[count] = (map_entry_t) { map_hash(key), key, value };
+
+        lzr_object_t* root = map_build(arena, entries, count + 1, 0, true);
+        if (root == NULL)
+            return LZR_NIL;
+        node_size(root) = (uint32_t) (count + 1);
+        return lzr_term_from_object(root);
+    }
+
+    lzr_object_t* copy = flat_alloc(arena, count + 1);
+    if (copy == NULL)
+        return LZR_NIL;
+
+    uint32_t* to_keys = flat_keys(copy);
+    uint32_t* to_values = flat_values(copy);
+    memcpy(to_keys, keys, index * sizeof(uint32_t));
+    memcpy(to_values, values, index * sizeof(uint32_t));
+    to_keys[index] = key;
+    to_values[index] = value;
+    memcpy(to_keys + index + 1, keys + index, (count - index) * sizeof(uint32_t));
+    memcpy(to_values + index + 1, values + index, (count - index) * sizeof(uint32_t));
+    return lzr_term_from_object(copy);
+}
+
+lzr_term_t lzr_map_new(lzr_arena_t* arena) {
+    lzr_object_t* map = flat_alloc(arena, 0);
+    if (map == NULL)
+        return LZR_NIL;
+    return lzr_term_from_object(map);
+}
+
+size_t lzr_map_size(lzr_term_t map) {
+    lzr_object_t* object = lzr_term_to_object(map);
+    if (object->type == LZR_TYPE_MAP)
+        return flat_size(object);
+    return node_size(object);
+}
+
+bool lzr_map_find(lzr_term_t map, lzr_term_t key, lzr_term_t* value) {
+    lzr_object_t* node = lzr_term_to_object(map);
+    if (node->type == LZR_TYPE_MAP) {
+        size_t index = flat_search(node, key);
+        if (index == flat_size(node) || flat_keys(node)[index] != key)
+            return false;
+        if (value != NULL)
+            *value = flat_values(node)[index];
+        return true;
+    }
+
+    // the hash runs out at the bottom of the trie where any collision nodes are
+    uint32_t hash = map_hash(key);
+    for (uint32_t shift = 0; node->type == LZR_TYPE_MAP_NODE; shift += MAP_BITS) {
+        uint32_t* fields = lzr_object_fields(node);
+        uint32_t bit = 1u << map_fragment(hash, shift);
+
+        uint32_t datamap = node_datamap(node);
+        if (datamap & bit) {
+            size_t index = map_index(datamap, bit);
+            if (fields[2 * index] != key)
+                return false;
+            if (value != NULL)
+                *value = fields[2 * index + 1];
+            return true;
+        }
+
+        uint32_t nodemap = node_nodemap(node);
+        if ((nodemap & bit) == 0)
+            return false;
+        node = (lzr_object_t*) LZR_PTR_UNZIP(node_children(node)[map_index(nodemap, bit)]);
+    }
+
+    uint32_t* fields = lzr_object_fields(node);
+    for (size_t i = 0; i < collision_size(node); i++) {
+        if (fields[2 * i] == key) {
+            if (value != NULL)
+                *value = fields[2 * i + 1];
+            return true;
+        }
+    }
+    return false;
+}
+
+lzr_term_t lzr_map_put(lzr_arena_t* arena, lzr_term_t map, lzr_term_t key, lzr_term_t value) {
+    lzr_object_t* object = lzr_term_to_object(map);
+    if (object->type == LZR_TYPE_MAP)
+        return flat_put(arena, object, key, value);
+
+    bool added = false;
+    map_entry_t entry = { map_hash(key), key, value };
+    lzr_object_t* root = node_put(arena, object, &entry, 0, true, &added);
+    if (root == NULL)
+        return LZR_NIL;
+
+    if (root != object)
+        node_size(root) = node_size(object) + added;
+    return lzr_term_from_object(root);
+}
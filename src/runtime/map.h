@@ -0,0 +1,47 @@
+#ifndef LZR_MAP_H
+#define LZR_MAP_H
+
+#include "term.h"
+
+/*
+Maps are immutable: putting a key returns a new map which shares everything it didn't change
+with the old one. Keys are atoms or small integers, and atom keys are hashed by the hash already
+stored in the atom (see lzr_atom_t) so a lookup never hashes any text.
+
+Small maps (up to LZR_MAP_FLAT_MAX keys) are a single LZR_TYPE_MAP object with the keys sorted
+by term followed by their values. Looking one up is a binary search through a few cache lines
+which never even touches the atoms.
+
+Larger maps are hash array mapped tries (CHAMP style) of LZR_TYPE_MAP_NODE objects. Each node
+consumes 5 bits of the hash and has two bitmaps with a bit per 5 bit fragment: one for the keys
+stored inline in the node and one for its child nodes. Only the present entries are stored,
+the position of an entry being the popcount of the bitmap below its bit, and children are
+compressed pointers so a node with a single key is only 32 bytes. Putting a key copies just
+the nodes on the path from the root down to it. Keys whose whole hash collides end up in an
+LZR_TYPE_MAP_COLLISION node of unsorted pairs at the bottom.
+
+All of these are ordinary arena objects: the keys, values and children are the traced fields
+and the bitmaps (and the root node's key count) are untraced words after them.
+*/
+#define LZR_MAP_FLAT_MAX 32
+
+// the most a single lzr_map_put() allocates unless a lot of keys share their whole hash,
+// for the `reserve` of the lzr_arena_collect() to retry it after it returned LZR_NIL.
+#define LZR_MAP_PUT_RESERVE (4 * 1024)
+
+#define lzr_term_is_map(term) \
+    (lzr_term_is_type(term, LZR_TYPE_MAP) || lzr_term_is_type(term, LZR_TYPE_MAP_NODE))
+
+// an empty map, or LZR_NIL when the arena is full like the other constructors
+lzr_term_t lzr_map_new(lzr_arena_t* arena);
+
+size_t lzr_map_size(lzr_term_t map);
+
+// returns false if the key isn't in the map, otherwise stores its value in `value` (if not NULL)
+bool lzr_map_find(lzr_term_t map, lzr_term_t key, lzr_term_t* value);
+
+// the map with `key` set to `value`, which is `map` itself if the key already had that value.
+// returns LZR_NIL when the arena is full, in which case no map changed.
+lzr_term_t lzr_map_put(lzr_arena_t* arena, lzr_term_t map, lzr_term_t key, lzr_term_t value);
+
+#endif // LZR_MAP_H
@@ -0,0 +1,114 @@
+#include "file.h"
+#include "memory.h"
+
+#if defined(LZR_WINDOWS)
+    #include <Windows.h>
+
+    bool lzr_file_open(lzr_file_t* self, const char* path, bool write) {
+        DWORD access = write ? GENERIC_WRITE : GENERIC_READ;
+        DWORD creation = write ? CREATE_ALWAYS : OPEN_EXISTING;
+        HANDLE handle = CreateFileA(path, access, FILE_SHARE_READ, NULL, creation, FILE_ATTRIBUTE_NORMAL, NULL);
+        self->handle = (intptr_t) handle;
+        return handle != INVALID_HANDLE_VALUE;
+    }
+
+    void lzr_file_close(lzr_file_t* self) {
+        CloseHandle((HANDLE) self->handle);
+    }
+
+    // ReadFile/WriteFile take a DWORD length so do them in pieces
+    #define FILE_IO_MAX (1U << 30)
+
+    bool lzr_file_read(lzr_file_t* self, void* buffer, size_t bytes, uint64_t offset) {
+        while (bytes > 0) {
+            DWORD transferred = 0;
+            OVERLAPPED overlapped = { 0 };
+            overlapped.Offset = (DWORD) offset;
+            overlapped.OffsetHigh = (DWORD) (offset >> 32);
+            DWORD size = (DWORD) (bytes < FILE_IO_MAX ? bytes : FILE_IO_MAX);
+            if (ReadFile((HANDLE) self->handle, buffer, size, &transferred, &overlapped) == FALSE || transferred == 0)
+                return false;
+            buffer = (void*) (((char*) buffer) + transferred);
+            bytes -= transferred;
+            offset += transferred;
+        }
+        return true;
+    }
+
+    bool lzr_file_write(lzr_file_t* self, const void* buffer, size_t bytes, uint64_t offset) {
+        while (bytes > 0) {
+            DWORD transferred = 0;
+            OVERLAPPED overlapped = { 0 };
+            overlapped.Offset = (DWORD) offset;
+            overlapped.OffsetHigh = (DWORD) (offset >> 32);
+            DWORD size = (DWORD) (bytes < FILE_IO_MAX ? bytes : FILE_IO_MAX);
+            if (WriteFile((HANDLE) self->handle, buffer, size, &transferred, &overlapped) == FALSE)
+                return false;
+            buffer = (const void*) (((const char*) buffer) + transferred);
+            bytes -= transferred;
+            offset += transferred;
+        }
+        return true;
+    }
+
+    // views can't be placed inside of a VirtualAlloc reservation without splitting it
+    // using placeholders (VirtualAlloc2 & MapViewOfFile3) so just read it in for now.
+    bool lzr_file_map(lzr_file_t* self, void* addr, size_t bytes, uint64_t offset) {
+        lzr_memory_commit(addr, bytes);
+        return lzr_file_read(self, addr, bytes, offset);
+    }
+
+    void lzr_file_unmap(void* addr, size_t bytes) {
+        lzr_memory_decommit(addr, bytes);
+    }
+
+#elif defined(LZR_LINUX)
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+
+    bool lzr_file_open(lzr_file_t* self, const char* path, bool write) {
+        int flags = write ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+        self->handle = (intptr_t) open(path, flags | O_CLOEXEC, 0644);
+        return self->handle >= 0;
+    }
+
+    void lzr_file_close(lzr_file_t* self) {
+        close((int) self->handle);
+    }
+
+    bool lzr_file_read(lzr_file_t* self, void* buffer, size_t bytes, uint64_t offset) {
+        while (bytes > 0) {
+            ssize_t transferred = pread((int) self->handle, buffer, bytes, (off_t) offset);
+            if (transferred <= 0)
+                return false;
+            buffer = (void*) (((char*) buffer) + transferred);
+            bytes -= (size_t) transferred;
+            offset += (uint64_t) transferred;
+        }
+        return true;
+    }
+
+    bool lzr_file_write(lzr_file_t* self, const void* buffer, size_t bytes, uint64_t offset) {
+        while (bytes > 0) {
+            ssize_t transferred = pwrite((int) self->handle, buffer, bytes, (off_t) offset);
+            if (transferred < 0)
+                return false;
+            buffer = (const void*) (((const char*) buffer) + transferred);
+            bytes -= (size_t) transferred;
+            offset += (uint64_t) transferred;
+        }
+        return true;
+    }
+
+    bool lzr_file_map(lzr_file_t* self, void* addr, size_t bytes, uint64_t offset) {
+        int flags = MAP_PRIVATE | MAP_FIXED;
+        void* mapped = mmap(addr, bytes, PROT_READ | PROT_WRITE, flags, (int) self->handle, (off_t) offset);
+        return mapped == addr;
+    }
+
+    void lzr_file_unmap(void* addr, size_t bytes) {
+        lzr_memory_map(addr, bytes, false);
+    }
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef LZR_FILE_H
+#define LZR_FILE_H
+
+#include "../system.h"
+
+typedef struct {
+    intptr_t handle;
+} lzr_file_t;
+
+// open a file for reading or, when `write` is set, create/truncate it for writing
+bool lzr_file_open(lzr_file_t* self, const char* path, bool write);
+
+void lzr_file_close(lzr_file_t* self);
+
+// positional reads & writes of exactly `bytes`, returns false on failure or a short read
+bool lzr_file_read(lzr_file_t* self, void* buffer, size_t bytes, uint64_t offset);
+
+bool lzr_file_write(lzr_file_t* self, const void* buffer, size_t bytes, uint64_t offset);
+
+// map `bytes` of the file at a page aligned `offset` copy-on-write over the already mapped
+// (page aligned) address range. Writes to it are private and never reach the file.
+// Where that isn't supported the file contents are read into the range instead.
+bool lzr_file_map(lzr_file_t* self, void* addr, size_t bytes, uint64_t offset);
+
+// drop a range mapped with lzr_file_map(), leaving it decommitted. Use this instead of
+// lzr_memory_decommit() which would just bring back the file contents on the next touch.
+void lzr_file_unmap(void* addr, size_t bytes);
+
+#endif // LZR_FILE_H
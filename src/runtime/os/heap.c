@@ -1,12 +1,25 @@
 #include "heap.h"
 #include "lock.h"
+#include "../stats.h"
+#include <string.h>
 
 #define HEAP_SIZE (LZR_HEAP_END - LZR_HEAP_BEGIN)
-#define HEAP_PTR(offset) (LZR_HEAP_BEGIN + ((offset) * LZR_HEAP_CHUNK_SIZE))
+#define HEAP_PTR(offset) (LZR_HEAP_BEGIN + (((size_t) (offset)) * LZR_HEAP_CHUNK_SIZE))
+
+/*
+Free runs of chunks are kept in TLSF-style segregated lists: the first level splits sizes by
+power of two and the second level splits each power of two into FREELIST_SL_COUNT linear steps.
+A bitmap for each level means finding a good fit is just a couple of bit scans instead
+of walking every free run, and inserting/removing a run (as done when coalescing) is O(1).
+*/
+#define FREELIST_SL_BITS 2
+#define FREELIST_SL_COUNT (1 << FREELIST_SL_BITS)
+#define FREELIST_FL_COUNT 13
 
 typedef struct {
-    uint16_t head;
-    uint16_t tail;
+    uint16_t fl_bitmap;
+    uint8_t sl_bitmap[FREELIST_FL_COUNT];
+    uint16_t heads[FREELIST_FL_COUNT][FREELIST_SL_COUNT];
 } freelist_t;
 
 typedef struct {
@@ -17,15 +30,39 @@ typedef struct {
     uint16_t predecessor: 14;
 } chunk_info_t;
 
+// runs freed with lzr_heap_retain() stay committed (and allocated) in a small pool so that
+// reusing them doesn't page fault. Every lzr_heap_purge() ages them and those which went
+// unused for HEAP_RETAIN_DECAY purges are decommitted and actually freed.
+#define HEAP_RETAIN_MAX 64
+#define HEAP_RETAIN_DECAY 4
+
+typedef struct {
+    uint16_t chunk;
+    uint16_t age;
+} retained_t;
+
 typedef struct {
-    lzr_spinlock_t lock;
+    lzr_mutex_t lock;
     uint16_t top_heap;
     uint16_t top_chunk;
     freelist_t free_list;
+    uint16_t retained_count;
+    retained_t retained[HEAP_RETAIN_MAX];
     chunk_info_t chunks[HEAP_SIZE / LZR_HEAP_CHUNK_SIZE];
 } heap_t;
 
-static uint32_t heap_offset = 0;
+// small runs of chunks are cached per thread so that most alloc/free
+// pairs never have to touch the global heap and its lock.
+#define HEAP_CACHE_CLASSES 8
+#define HEAP_CACHE_DEPTH 4
+
+typedef struct {
+    uint16_t count[HEAP_CACHE_CLASSES];
+    uint16_t chunks[HEAP_CACHE_CLASSES][HEAP_CACHE_DEPTH];
+} heap_cache_t;
+
+static _Thread_local heap_cache_t heap_cache;
+static uint32_t heap_offset = LZR_ATOM_HEAP_SIZE / LZR_HEAP_CHUNK_SIZE; // in chunks, after the atom heap
 static bool heap_committed = false;
 static bool heap_initialized = false;
 
@@ -34,6 +71,11 @@ void lzr_heap_init() {
     assert(heap_initialized == false);
     lzr_memory_map((void*) HEAP_PTR(0), HEAP_SIZE, false);
     heap_initialized = true;
+
+    // every chunk is 2mb aligned which lines up exactly with x86_64 huge pages
+    #if defined(LZR_HUGEPAGES)
+        lzr_memory_hugepage((void*) HEAP_PTR(0), HEAP_SIZE);
+    #endif
 }
 
 // reserve a specific amount of the heap for static data.
@@ -41,7 +83,7 @@ void lzr_heap_init() {
 void* lzr_heap_reserve(uint16_t num_chunks) {
     assert(heap_committed == false);
     void* address = (void*) HEAP_PTR(heap_offset);
-    heap_offset += num_chunks * LZR_HEAP_CHUNK_SIZE;
+    heap_offset += num_chunks;
     return address;
 }
 
@@ -56,9 +98,9 @@ void lzr_heap_commit() {
 
     heap->top_heap = 1;
     heap->top_chunk = 0;
-    heap->free_list.head = 0;
-    heap->free_list.tail = 0;
-    lzr_spinlock_init(&heap->lock);
+    heap->retained_count = 0;
+    memset(&heap->free_list, 0, sizeof(freelist_t));
+    lzr_mutex_init(&heap->lock);
 
     heap->chunks[0].prev = 0;
     heap->chunks[0].next = 0;
@@ -67,58 +109,117 @@ void lzr_heap_commit() {
     heap->chunks[0].predecessor = 0;
 }
 
-void freelist_append(heap_t* heap, uint16_t chunk) {
-    heap->chunks[chunk].next = 0;
-
-    if (heap->free_list.tail == 0) {
-        heap->chunks[chunk].prev = 0;
-        heap->free_list.tail = heap->free_list.head = chunk;
+// map a run size to the (first level, second level) list which holds it
+void freelist_mapping(uint16_t size, uint16_t* fl, uint16_t* sl) {
+    if (size < FREELIST_SL_COUNT) {
+        *fl = 0;
+        *sl = size;
     } else {
-        heap->chunks[heap->free_list.tail].next = chunk;
-        heap->chunks[chunk].prev = heap->free_list.tail;
-        heap->free_list.tail = chunk;
+        uint16_t log2 = 31 - __builtin_clz(size);
+        *fl = log2 - FREELIST_SL_BITS + 1;
+        *sl = (size >> (log2 - FREELIST_SL_BITS)) - FREELIST_SL_COUNT;
     }
 }
 
+void freelist_append(heap_t* heap, uint16_t chunk) {
+    uint16_t fl, sl;
+    freelist_mapping(heap->chunks[chunk].size, &fl, &sl);
+    uint16_t* head = &heap->free_list.heads[fl][sl];
+
+    heap->chunks[chunk].prev = 0;
+    heap->chunks[chunk].next = *head;
+    if (*head != 0)
+        heap->chunks[*head].prev = chunk;
+    *head = chunk;
+
+    heap->free_list.fl_bitmap |= 1 << fl;
+    heap->free_list.sl_bitmap[fl] |= 1 << sl;
+}
+
+// the run's size must not have changed since it was appended
 void freelist_remove(heap_t* heap, uint16_t chunk) {
     chunk_info_t* chunk_info = &heap->chunks[chunk];
+    uint16_t fl, sl;
+    freelist_mapping(chunk_info->size, &fl, &sl);
 
-    if (heap->free_list.head == chunk)
-        heap->free_list.head = chunk_info->next;
-    if (heap->free_list.tail == chunk)
-        heap->free_list.tail = chunk_info->next;
     if (chunk_info->prev != 0)
         heap->chunks[chunk_info->prev].next = chunk_info->next;
     if (chunk_info->next != 0)
         heap->chunks[chunk_info->next].prev = chunk_info->prev;
+
+    if (heap->free_list.heads[fl][sl] == chunk) {
+        heap->free_list.heads[fl][sl] = chunk_info->next;
+        if (chunk_info->next == 0) {
+            heap->free_list.sl_bitmap[fl] &= ~(1 << sl);
+            if (heap->free_list.sl_bitmap[fl] == 0)
+                heap->free_list.fl_bitmap &= ~(1 << fl);
+        }
+    }
+}
+
+// find a free run of at least `size` chunks. The size is rounded up to the next list
+// boundary first so that any run in the list found is big enough without searching it.
+uint16_t freelist_find(heap_t* heap, uint16_t size) {
+    uint16_t fl, sl;
+    if (size >= FREELIST_SL_COUNT) {
+        uint32_t rounded = size + (1 << (31 - __builtin_clz(size) - FREELIST_SL_BITS)) - 1;
+        if (rounded > UINT16_MAX)
+            return 0;
+        size = rounded;
+    }
+    freelist_mapping(size, &fl, &sl);
+    if (fl >= FREELIST_FL_COUNT)
+        return 0;
+
+    uint32_t sl_map = heap->free_list.sl_bitmap[fl] & (~0U << sl);
+    if (sl_map == 0) {
+        uint32_t fl_map = heap->free_list.fl_bitmap & (~0U << (fl + 1));
+        if (fl_map == 0)
+            return 0;
+        fl = __builtin_ctz(fl_map);
+        sl_map = heap->free_list.sl_bitmap[fl];
+    }
+
+    sl = __builtin_ctz(sl_map);
+    return heap->free_list.heads[fl][sl];
 }
 
 void* lzr_heap_alloc(uint16_t num_chunks) {
     heap_t* heap = (heap_t*) HEAP_PTR(heap_offset);
-    lzr_spinlock_lock(&heap->lock);
     void* address;
+    LZR_STAT_ADD(LZR_STAT_HEAP_ALLOC, 1);
+
+    // try to reuse a run of the same size which this thread freed recently
+    if (num_chunks > 0 && num_chunks <= HEAP_CACHE_CLASSES) {
+        heap_cache_t* cache = &heap_cache;
+        uint16_t* count = &cache->count[num_chunks - 1];
+        if (*count > 0) {
+            LZR_STAT_ADD(LZR_STAT_HEAP_CACHE_HIT, 1);
+            return (void*) HEAP_PTR(heap_offset + cache->chunks[num_chunks - 1][--(*count)]);
+        }
+    }
+
+    lzr_mutex_lock(&heap->lock);
 
-    // using Best-Fit search, try and find a free chunk in the free list
-    uint16_t free_chunk = 0;
-    for (uint16_t chunk = heap->free_list.head; chunk != 0; chunk = heap->chunks[chunk].next)
-        if (heap->chunks[chunk].size >= num_chunks)
-            if (free_chunk == 0 || heap->chunks[free_chunk].size > heap->chunks[chunk].size)
-                free_chunk = chunk;
+    // using Good-Fit search, try and find a free chunk in the segregated free lists
+    uint16_t free_chunk = freelist_find(heap, num_chunks);
 
     // a free chunk was found, use it
     if (free_chunk != 0) {
         chunk_info_t* free_chunk_info = &heap->chunks[free_chunk];
+        freelist_remove(heap, free_chunk);
         free_chunk_info->allocated = true;
         free_chunk_info->next = 0;
 
-        // remove it from the free list and add back the remaining if it was bigget than needed
-        freelist_remove(heap, free_chunk);
+        // add back the remaining to the free list if it was bigger than needed
         if (free_chunk_info->size > num_chunks) {
             uint16_t left_over = free_chunk + num_chunks;
             heap->chunks[left_over].size = free_chunk_info->size - num_chunks;
             heap->chunks[left_over].predecessor = free_chunk;
             heap->chunks[left_over].allocated = false;
             freelist_append(heap, left_over);
+            if (left_over + heap->chunks[left_over].size < heap->top_heap)
+                heap->chunks[left_over + heap->chunks[left_over].size].predecessor = left_over;
         }
 
         free_chunk_info->size = num_chunks;
@@ -127,6 +228,10 @@ void* lzr_heap_alloc(uint16_t num_chunks) {
     // no free chunk was found, bump-allocate from the top of the heap
     } else {
         uint16_t top = heap->top_heap;
+        if (heap_offset + top + num_chunks > HEAP_SIZE / LZR_HEAP_CHUNK_SIZE) {
+            lzr_mutex_unlock(&heap->lock);
+            return NULL;
+        }
         heap->top_heap += num_chunks;
         assert(heap->top_heap > top);
 
@@ -139,34 +244,22 @@ void* lzr_heap_alloc(uint16_t num_chunks) {
         address = (void*) HEAP_PTR(heap_offset + top);
     }
 
-    lzr_spinlock_unlock(&heap->lock);
+    lzr_mutex_unlock(&heap->lock);
     return address;
 }
 
-void lzr_heap_free(void* ptr) {
-    // assert that the ptr is in the heap & aligned to LZR_HEAP_CHUNK_SIZE (its a valid chunk)
-    assert((size_t) ptr > LZR_HEAP_BEGIN && (size_t) ptr < LZR_HEAP_END);
-    assert(((size_t) ptr % LZR_HEAP_CHUNK_SIZE) == 0);
-    heap_t* heap = (heap_t*) HEAP_PTR(heap_offset);
-
-    // get the chunk info and make sure that it was allocated before freeing
-    uint16_t ptr_chunk = ((size_t) ptr - heap_offset - LZR_HEAP_BEGIN) / LZR_HEAP_CHUNK_SIZE;
+// return a chunk back to the global heap. assumes the heap lock is held.
+void heap_free_chunk(heap_t* heap, uint16_t ptr_chunk) {
     chunk_info_t* ptr_chunk_info = &heap->chunks[ptr_chunk];
-    
-    lzr_spinlock_lock(&heap->lock);
     assert(ptr_chunk_info->allocated == true);
     ptr_chunk_info->allocated = false;
 
     // coalesce free chunks from left to right (removing them from the free list)    
-    if (ptr_chunk != heap->top_chunk) {
-        uint16_t chunk = ptr_chunk + ptr_chunk_info->size;
-        while (!heap->chunks[chunk].allocated) {
-            freelist_remove(heap, chunk);
-            ptr_chunk_info->size += heap->chunks[chunk].size;
-            chunk += heap->chunks[chunk].size;
-            if (chunk >= heap->top_heap)
-                break;
-        }
+    uint16_t chunk = ptr_chunk + ptr_chunk_info->size;
+    while (chunk < heap->top_heap && !heap->chunks[chunk].allocated) {
+        freelist_remove(heap, chunk);
+        ptr_chunk_info->size += heap->chunks[chunk].size;
+        chunk += heap->chunks[chunk].size;
     }
 
     // coalesce free chunks right to left following the chain of predecessors
@@ -180,6 +273,10 @@ void lzr_heap_free(void* ptr) {
         ptr_chunk_info = predecessor;
     }
 
+    // the chunk after the coalesced run now follows it
+    if (chunk < heap->top_heap)
+        heap->chunks[chunk].predecessor = ptr_chunk;
+
     // the freed chunk is on the top of the heap:
     // move the heap top back down to the freed chunk and discard it
     if (ptr_chunk + ptr_chunk_info->size >= heap->top_heap) {
@@ -191,6 +288,165 @@ void lzr_heap_free(void* ptr) {
     } else {
         freelist_append(heap, ptr_chunk);
     }
+}
+
+void lzr_heap_free(void* ptr) {
+    // assert that the ptr is in the heap & aligned to LZR_HEAP_CHUNK_SIZE (its a valid chunk)
+    assert((size_t) ptr > LZR_HEAP_BEGIN && (size_t) ptr < LZR_HEAP_END);
+    assert(((size_t) ptr % LZR_HEAP_CHUNK_SIZE) == 0);
+    heap_t* heap = (heap_t*) HEAP_PTR(heap_offset);
+
+    // get the chunk info and make sure that it was allocated before freeing.
+    // the size of an allocated run is only ever changed by its owner so its safe to read unlocked.
+    uint16_t ptr_chunk = ((size_t) ptr - (size_t) heap) / LZR_HEAP_CHUNK_SIZE;
+    uint16_t num_chunks = heap->chunks[ptr_chunk].size;
+    LZR_STAT_ADD(LZR_STAT_HEAP_FREE, 1);
+
+    // keep the run in the thread's cache if theres room, it stays allocated in the global heap
+    if (num_chunks > 0 && num_chunks <= HEAP_CACHE_CLASSES) {
+        heap_cache_t* cache = &heap_cache;
+        uint16_t* count = &cache->count[num_chunks - 1];
+        if (*count < HEAP_CACHE_DEPTH) {
+            LZR_STAT_ADD(LZR_STAT_HEAP_CACHE_HIT, 1);
+            cache->chunks[num_chunks - 1][(*count)++] = ptr_chunk;
+            return;
+        }
+    }
+
+    lzr_mutex_lock(&heap->lock);
+    heap_free_chunk(heap, ptr_chunk);
+    lzr_mutex_unlock(&heap->lock);
+}
+
+void lzr_heap_cache_flush() {
+    heap_t* heap = (heap_t*) HEAP_PTR(heap_offset);
+    heap_cache_t* cache = &heap_cache;
+
+    lzr_mutex_lock(&heap->lock);
+    for (uint16_t size_class = 0; size_class < HEAP_CACHE_CLASSES; size_class++) {
+        while (cache->count[size_class] > 0)
+            heap_free_chunk(heap, cache->chunks[size_class][--cache->count[size_class]]);
+    }
+    lzr_mutex_unlock(&heap->lock);
+}
+
+// decommit and free retained runs outside of the lock as decommitting can take a while
+void heap_release_retained(heap_t* heap, uint16_t* chunks, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++)
+        lzr_memory_decommit((void*) HEAP_PTR(heap_offset + chunks[i]), heap->chunks[chunks[i]].size * LZR_HEAP_CHUNK_SIZE);
+
+    lzr_mutex_lock(&heap->lock);
+    for (uint16_t i = 0; i < count; i++)
+        heap_free_chunk(heap, chunks[i]);
+    lzr_mutex_unlock(&heap->lock);
+}
+
+void* lzr_heap_alloc_committed(uint16_t num_chunks) {
+    heap_t* heap = (heap_t*) HEAP_PTR(heap_offset);
+    lzr_mutex_lock(&heap->lock);
+
+    // prefer the most recently retained run of the same size as its the most likely to still be cached
+    for (uint16_t i = heap->retained_count; i-- > 0;) {
+        uint16_t chunk = heap->retained[i].chunk;
+        if (heap->chunks[chunk].size == num_chunks) {
+            heap->retained[i] = heap->retained[--heap->retained_count];
+            lzr_mutex_unlock(&heap->lock);
+            return (void*) HEAP_PTR(heap_offset + chunk);
+        }
+    }
+
+    lzr_mutex_unlock(&heap->lock);
+    void* address = lzr_heap_alloc(num_chunks);
+    if (address != NULL)
+        lzr_memory_commit(address, num_chunks * LZR_HEAP_CHUNK_SIZE);
+    return address;
+}
+
+void lzr_heap_retain(void* ptr) {
+    assert((size_t) ptr > LZR_HEAP_BEGIN && (size_t) ptr < LZR_HEAP_END);
+    assert(((size_t) ptr % LZR_HEAP_CHUNK_SIZE) == 0);
+    heap_t* heap = (heap_t*) HEAP_PTR(heap_offset);
+    uint16_t ptr_chunk = ((size_t) ptr - (size_t) heap) / LZR_HEAP_CHUNK_SIZE;
+    uint16_t evicted = 0;
+    uint16_t num_evicted = 0;
+
+    // make room by evicting the oldest run if the pool is full
+    lzr_mutex_lock(&heap->lock);
+    if (heap->retained_count == HEAP_RETAIN_MAX) {
+        uint16_t oldest = 0;
+        for (uint16_t i = 1; i < heap->retained_count; i++)
+            if (heap->retained[i].age > heap->retained[oldest].age)
+                oldest = i;
+        evicted = heap->retained[oldest].chunk;
+        heap->retained[oldest] = heap->retained[--heap->retained_count];
+        num_evicted = 1;
+    }
 
-    lzr_spinlock_unlock(&heap->lock);
-}
\ No newline at end of file
+    heap->retained[heap->retained_count].chunk = ptr_chunk;
+    heap->retained[heap->retained_count].age = 0;
+    heap->retained_count++;
+    lzr_mutex_unlock(&heap->lock);
+
+    if (num_evicted != 0)
+        heap_release_retained(heap, &evicted, num_evicted);
+}
+
+void lzr_heap_purge(bool all) {
+    heap_t* heap = (heap_t*) HEAP_PTR(heap_offset);
+    uint16_t decayed[HEAP_RETAIN_MAX];
+    uint16_t num_decayed = 0;
+
+    lzr_mutex_lock(&heap->lock);
+    for (uint16_t i = 0; i < heap->retained_count;) {
+        if (all || ++heap->retained[i].age >= HEAP_RETAIN_DECAY) {
+            decayed[num_decayed++] = heap->retained[i].chunk;
+            heap->retained[i] = heap->retained[--heap->retained_count];
+        } else {
+            i++;
+        }
+    }
+    lzr_mutex_unlock(&heap->lock);
+
+    if (num_decayed != 0)
+        heap_release_retained(heap, decayed, num_decayed);
+}
+
+void lzr_heap_stats(lzr_stats_heap_t* stats) {
+    memset(stats, 0, sizeof(lzr_stats_heap_t));
+    uint64_t committed = lzr_stat_read(LZR_STAT_MEMORY_COMMIT);
+    uint64_t decommitted = lzr_stat_read(LZR_STAT_MEMORY_DECOMMIT);
+    stats->committed_bytes = committed > decommitted ? committed - decommitted : 0;
+    stats->allocs = lzr_stat_read(LZR_STAT_HEAP_ALLOC);
+    stats->frees = lzr_stat_read(LZR_STAT_HEAP_FREE);
+    stats->cache_hits = lzr_stat_read(LZR_STAT_HEAP_CACHE_HIT);
+    if (!heap_committed)
+        return;
+
+    // runs sitting in thread caches are still allocated as far as the global heap knows
+    heap_t* heap = (heap_t*) HEAP_PTR(heap_offset);
+    lzr_mutex_lock(&heap->lock);
+    stats->top_chunks = heap->top_heap;
+    for (uint16_t i = 0; i < heap->retained_count; i++)
+        stats->retained_chunks += heap->chunks[heap->retained[i].chunk].size;
+
+    for (uint16_t fl = 0; fl < FREELIST_FL_COUNT; fl++) {
+        for (uint16_t sl = 0; sl < FREELIST_SL_COUNT; sl++) {
+            for (uint16_t chunk = heap->free_list.heads[fl][sl]; chunk != 0; chunk = heap->chunks[chunk].next) {
+                uint16_t size = heap->chunks[chunk].size;
+                stats->free_runs++;
+                stats->free_chunks += size;
+                if (size > stats->largest_free_run)
+                    stats->largest_free_run = size;
+            }
+        }
+    }
+    lzr_mutex_unlock(&heap->lock);
+
+    lzr_mutex_stats_t lock;
+    lzr_mutex_stats(&heap->lock, &lock);
+    stats->lock.acquired = lock.acquired;
+    stats->lock.contended = lock.contended;
+    stats->lock.parked = lock.parked;
+    if (stats->free_chunks != 0)
+        stats->fragmentation = 1.0 - ((double) stats->largest_free_run / (double) stats->free_chunks);
+}
@@ -13,6 +13,12 @@ the bottom 3 bits are always zero so a pointer in this space can be compressed d
 #define LZR_HEAP_END        (1ULL << 36)
 #define LZR_HEAP_CHUNK_SIZE (2 * 1024 * 1024)
 
+// the first 1gb of the heap is set aside for the atom heap so that atoms are always
+// at a fixed address range, which also means their compressed pointers are below LZR_ATOM_ZIP_END.
+#define LZR_ATOM_HEAP_BEGIN LZR_HEAP_BEGIN
+#define LZR_ATOM_HEAP_SIZE  (1ULL << 30)
+#define LZR_ATOM_ZIP_END    ((uint32_t) (LZR_ATOM_HEAP_SIZE >> 3))
+
 // compression and decompression of 8-byte aligned heap pointers
 #define LZR_PTR_ZIP(ptr) ((uint32_t) ((((size_t) (ptr)) - LZR_HEAP_BEGIN) >> 3))
 #define LZR_PTR_UNZIP(ptr) ((void*) ((((size_t) (ptr)) << 3) + LZR_HEAP_BEGIN))
@@ -26,7 +32,7 @@ void* lzr_heap_reserve(uint16_t num_chunks);
 // no more reserving. lock it down and make it safe to use alloc/free
 void lzr_heap_commit();
 
-// allocate `num_chunk` amount of chunks (2mb).
+// allocate `num_chunk` amount of chunks (2mb), or NULL when the heap is out of room.
 // The caller is responsible for committing it.
 void* lzr_heap_alloc(uint16_t num_chunks);
 
@@ -34,4 +40,24 @@ void* lzr_heap_alloc(uint16_t num_chunks);
 // again, the caller is responsible for decommit it.
 void lzr_heap_free(void* ptr);
 
+// allocate `num_chunks` which are already committed, preferring ones recently retained.
+// NULL when the heap is out of room like lzr_heap_alloc()
+void* lzr_heap_alloc_committed(uint16_t num_chunks);
+
+// free a still committed allocation into the retained pool instead of decommitting it.
+// retained chunks are decommitted and freed once they've decayed (see lzr_heap_purge).
+void lzr_heap_retain(void* ptr);
+
+// age the retained pool, decommitting and freeing chunks which haven't been reused
+// for a while (or all of them). schedulers call it periodically as they park, and with
+// `all` once lzr_sched_run() is done.
+void lzr_heap_purge(bool all);
+
+// small runs of chunks freed by a thread are kept in a bounded per-thread cache.
+// return them to the global heap, which threads should do when idle and before exiting.
+void lzr_heap_cache_flush();
+
+// fill in the heap's part of lzr_stats_snapshot(). takes the heap lock to walk the free lists.
+void lzr_heap_stats(lzr_stats_heap_t* stats);
+
 #endif // LZR_HEAP_H
\ No newline at end of file
@@ -2,34 +2,130 @@
 
 #if defined(LZR_WINDOWS)
     #include <Windows.h>
-    #define cpu_yield() Sleep(1)
-    #define cpu_relax() YieldProcessor()
-
 #elif defined(LZR_LINUX)
-    #include <sched.h>
+    #include <unistd.h>
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <time.h>
+#endif
+
+#if defined(LZR_X86)
     #include <immintrin.h>
-    #define cpu_relax() _mm_pause()
-    #define cpu_yield() sched_yield()
 #endif
 
-void lzr_spinlock_init(lzr_spinlock_t* self) {
-    atomic_flag_clear_explicit(self, memory_order_relaxed);
+void lzr_cpu_relax(void) {
+    #if defined(LZR_X86)
+        _mm_pause();
+    #elif defined(LZR_ARM)
+        __asm__ __volatile__("yield" ::: "memory");
+    #endif
+}
+
+void lzr_futex_wait(const uint32_t* addr, uint32_t expect) {
+    #if defined(LZR_WINDOWS)
+        WaitOnAddress((volatile VOID*) addr, (PVOID) &expect, sizeof(uint32_t), INFINITE);
+    #elif defined(LZR_LINUX)
+        syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expect, NULL, NULL, 0);
+    #endif
+}
+
+void lzr_futex_wait_for(const uint32_t* addr, uint32_t expect, uint64_t timeout) {
+    #if defined(LZR_WINDOWS)
+        uint64_t millis = (timeout + 999999) / 1000000;
+        DWORD wait_millis = millis < INFINITE ? (DWORD) millis : INFINITE - 1;
+        WaitOnAddress((volatile VOID*) addr, (PVOID) &expect, sizeof(uint32_t), wait_millis);
+    #elif defined(LZR_LINUX)
+        struct timespec ts = { .tv_sec = (time_t) (timeout / 1000000000ULL), .tv_nsec = (long) (timeout % 1000000000ULL) };
+        syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expect, &ts, NULL, 0);
+    #endif
 }
 
-void lzr_spinlock_lock(lzr_spinlock_t* self) {
-    size_t contended = 0;
-    while (!atomic_flag_test_and_set_explicit(self, memory_order_relaxed)) {
-        if (++contended > 20) {
-            cpu_relax();
-        } else {
-            cpu_yield();
-        }
+void lzr_futex_wake_one(const uint32_t* addr) {
+    #if defined(LZR_WINDOWS)
+        WakeByAddressSingle((PVOID) addr);
+    #elif defined(LZR_LINUX)
+        syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    #endif
+}
+
+void lzr_futex_wake_all(const uint32_t* addr) {
+    #if defined(LZR_WINDOWS)
+        WakeByAddressAll((PVOID) addr);
+    #elif defined(LZR_LINUX)
+        syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+    #endif
+}
+
+// the classic 3 state futex mutex: waiters set CONTENDED before parking
+// so that an unlock only pays for the wake syscall when someone may be asleep.
+#define MUTEX_UNLOCKED 0
+#define MUTEX_LOCKED 1
+#define MUTEX_CONTENDED 2
+
+// roughly a few microseconds of spinning (the pause latency varies a lot across cpus)
+// which covers the short critical sections in the heap and atom table.
+#define MUTEX_SPIN_LIMIT 10
+#define MUTEX_SPIN_BACKOFF_MAX 64
+
+void lzr_mutex_init(lzr_mutex_t* self) {
+    self->state = MUTEX_UNLOCKED;
+    self->acquired = 0;
+    self->contended = 0;
+    self->parked = 0;
+}
+
+bool lzr_mutex_try_lock(lzr_mutex_t* self) {
+    uint32_t state = MUTEX_UNLOCKED;
+    if (!__atomic_compare_exchange_n(&self->state, &state, MUTEX_LOCKED, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return false;
+
+    __atomic_store_n(&self->acquired, self->acquired + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+void mutex_lock_slow(lzr_mutex_t* self) {
+    uint64_t parked = 0;
+
+    // spin with exponential backoff while the lock is held but nobody is asleep on it.
+    // spinning when there are parked waiters would only let us barge ahead of them.
+    uint32_t state = __atomic_load_n(&self->state, __ATOMIC_RELAXED);
+    for (size_t spin = 0; spin < MUTEX_SPIN_LIMIT && state == MUTEX_LOCKED; spin++) {
+        size_t backoff = (size_t) 1 << spin;
+        if (backoff > MUTEX_SPIN_BACKOFF_MAX)
+            backoff = MUTEX_SPIN_BACKOFF_MAX;
+        while (backoff-- != 0)
+            lzr_cpu_relax();
+        state = __atomic_load_n(&self->state, __ATOMIC_RELAXED);
     }
 
-    atomic_thread_fence(memory_order_release);
+    if (state == MUTEX_UNLOCKED && __atomic_compare_exchange_n(&self->state, &state, MUTEX_LOCKED, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        goto acquired;
+
+    // once we've marked the lock as contended we can't know if we're the last waiter
+    // so acquire it as CONTENDED as well to make sure the next unlock wakes someone.
+    while (__atomic_exchange_n(&self->state, MUTEX_CONTENDED, __ATOMIC_ACQUIRE) != MUTEX_UNLOCKED) {
+        lzr_futex_wait(&self->state, MUTEX_CONTENDED);
+        parked++;
+    }
+
+acquired:
+    __atomic_store_n(&self->acquired, self->acquired + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->contended, self->contended + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->parked, self->parked + parked, __ATOMIC_RELAXED);
+}
+
+void lzr_mutex_lock(lzr_mutex_t* self) {
+    if (!lzr_mutex_try_lock(self))
+        mutex_lock_slow(self);
 }
 
-void lzr_spinlock_unlock(lzr_spinlock_t* self) {
-    atomic_thread_fence(memory_order_acquire);
-    atomic_flag_clear_explicit(self, memory_order_relaxed);
-}
\ No newline at end of file
+void lzr_mutex_unlock(lzr_mutex_t* self) {
+    if (__atomic_exchange_n(&self->state, MUTEX_UNLOCKED, __ATOMIC_RELEASE) == MUTEX_CONTENDED)
+        lzr_futex_wake_one(&self->state);
+}
+
+void lzr_mutex_stats(lzr_mutex_t* self, lzr_mutex_stats_t* stats) {
+    stats->acquired = __atomic_load_n(&self->acquired, __ATOMIC_RELAXED);
+    stats->contended = __atomic_load_n(&self->contended, __ATOMIC_RELAXED);
+    stats->parked = __atomic_load_n(&self->parked, __ATOMIC_RELAXED);
+}
@@ -2,14 +2,53 @@
 #define LZR_LOCK_H
 
 #include "../system.h"
-#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
 
-typedef atomic_flag lzr_spinlock_t;
+// hint to the cpu that we're in a spin loop (pause on x86, yield on arm)
+void lzr_cpu_relax(void);
 
-void lzr_spinlock_init(lzr_spinlock_t* self);
+// block while *addr == expect, returning early on a wake or a spurious wakeup.
+// only compares the address and never touches it otherwise.
+void lzr_futex_wait(const uint32_t* addr, uint32_t expect);
 
-void lzr_spinlock_lock(lzr_spinlock_t* self);
+// same but gives up after roughly `timeout` nanoseconds
+void lzr_futex_wait_for(const uint32_t* addr, uint32_t expect, uint64_t timeout);
 
-void lzr_spinlock_unlock(lzr_spinlock_t* self);
+void lzr_futex_wake_one(const uint32_t* addr);
+
+void lzr_futex_wake_all(const uint32_t* addr);
+
+/*
+An adaptive mutex: a short bounded spin which backs off with the cpu's relax instruction
+and then parks the thread on a futex until the holder wakes it. Zero initialized memory
+is an unlocked mutex.
+
+The counters are only written while the mutex is held so they cost no extra atomics
+on the fast path but can be read at any time (possibly slightly stale).
+*/
+typedef struct {
+    uint32_t state;
+    uint32_t _reserved;
+    uint64_t acquired;
+    uint64_t contended;
+    uint64_t parked;
+} lzr_mutex_t;
+
+typedef struct {
+    uint64_t acquired;
+    uint64_t contended;
+    uint64_t parked;
+} lzr_mutex_stats_t;
+
+void lzr_mutex_init(lzr_mutex_t* self);
+
+bool lzr_mutex_try_lock(lzr_mutex_t* self);
+
+void lzr_mutex_lock(lzr_mutex_t* self);
+
+void lzr_mutex_unlock(lzr_mutex_t* self);
+
+void lzr_mutex_stats(lzr_mutex_t* self, lzr_mutex_stats_t* stats);
 
 #endif // LZR_LOCK_H
@@ -1,4 +1,5 @@
 #include "memory.h"
+#include "../stats.h"
 
 #if defined(LZR_WINDOWS)
     #include <Windows.h>
@@ -15,16 +16,42 @@
     void lzr_memory_unmap(void* addr, size_t bytes) {
         BOOL unmapped = VirtualFree(addr, 0, MEM_RELEASE);
         assert(unmapped == TRUE);
+        (void) unmapped;
     }
 
     void lzr_memory_commit(void* addr, size_t bytes) {
         void* address = VirtualAlloc(addr, bytes, MEM_COMMIT, PAGE_READWRITE);
         assert(address == addr);
+        LZR_STAT_ADD(LZR_STAT_MEMORY_COMMIT, bytes);
     }
 
     void lzr_memory_decommit(void* addr, size_t bytes) {
         BOOL decommitted = VirtualFree(addr, bytes, MEM_DECOMMIT);
         assert(decommitted == TRUE);
+        (void) decommitted;
+        LZR_STAT_ADD(LZR_STAT_MEMORY_DECOMMIT, bytes);
+    }
+
+    void lzr_memory_hugepage(void* addr, size_t bytes) {
+        // large pages on windows need SeLockMemoryPrivilege and have to be
+        // requested when mapping so theres nothing to do after the fact.
+    }
+
+    void lzr_memory_protect(void* addr, size_t bytes, bool executable) {
+        DWORD old_protect;
+        BOOL protected = VirtualProtect(addr, bytes, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &old_protect);
+        assert(protected == TRUE);
+        (void) protected;
+    }
+
+    void lzr_memory_flush_icache(void* addr, size_t bytes) {
+        FlushInstructionCache(GetCurrentProcess(), addr, bytes);
+    }
+
+    void lzr_memory_prefault(void* addr, size_t bytes) {
+        lzr_memory_commit(addr, bytes);
+        for (size_t offset = 0; offset < bytes; offset += 4096)
+            ((volatile char*) addr)[offset] = ((volatile char*) addr)[offset];
     }
 
 #else
@@ -33,6 +60,8 @@
     void* lzr_memory_map(void* addr, size_t bytes, bool commit) {
         int protect = PROT_READ | PROT_WRITE;
         int flags = MAP_PRIVATE | MAP_ANONYMOUS | (addr != NULL ? MAP_FIXED : 0);
+        if (!commit)
+            flags |= MAP_NORESERVE;
 
         addr = mmap(addr, bytes, protect, flags, -1, 0);
         assert(addr != MAP_FAILED);
@@ -42,15 +71,47 @@
     void lzr_memory_unmap(void* addr, size_t bytes) {
         int unmapped = munmap(addr, bytes);
         assert(unmapped == 0);
+        (void) unmapped;
     }
 
     void lzr_memory_commit(void* addr, size_t bytes) {
-        // linux over-commits memory by default
+        // linux over-commits memory by default, so this only counts what was asked for
+        LZR_STAT_ADD(LZR_STAT_MEMORY_COMMIT, bytes);
     }
 
     void lzr_memory_decommit(void* addr, size_t bytes) {
         int decommitted = madvise(addr, bytes, MADV_DONTNEED);
         assert(decommitted == 0);
+        (void) decommitted;
+        LZR_STAT_ADD(LZR_STAT_MEMORY_DECOMMIT, bytes);
+    }
+
+    void lzr_memory_hugepage(void* addr, size_t bytes) {
+        // fails with EINVAL if transparent huge pages are compiled out which is fine
+        #if defined(MADV_HUGEPAGE)
+            madvise(addr, bytes, MADV_HUGEPAGE);
+        #endif
+    }
+
+    void lzr_memory_protect(void* addr, size_t bytes, bool executable) {
+        int protect = executable ? (PROT_READ | PROT_EXEC) : (PROT_READ | PROT_WRITE);
+        int protected = mprotect(addr, bytes, protect);
+        assert(protected == 0);
+        (void) protected;
+    }
+
+    void lzr_memory_flush_icache(void* addr, size_t bytes) {
+        __builtin___clear_cache((char*) addr, ((char*) addr) + bytes);
+    }
+
+    void lzr_memory_prefault(void* addr, size_t bytes) {
+        LZR_STAT_ADD(LZR_STAT_MEMORY_COMMIT, bytes);
+        #if defined(MADV_POPULATE_WRITE)
+            if (madvise(addr, bytes, MADV_POPULATE_WRITE) == 0)
+                return;
+        #endif
+        for (size_t offset = 0; offset < bytes; offset += 4096)
+            ((volatile char*) addr)[offset] = ((volatile char*) addr)[offset];
     }
     
 #endif
\ No newline at end of file
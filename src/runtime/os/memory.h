@@ -3,7 +3,7 @@
 
 #include "../system.h"
 
-// virtually map memory (TODO: add support for executable memory down the road)
+// virtually map memory. it's always mapped read/write, see lzr_memory_protect() for executable memory
 void* lzr_memory_map(void* addr, size_t bytes, bool commit);
 
 // tbh i dont think this will ever be used, but its here if need be.
@@ -15,4 +15,17 @@ void lzr_memory_commit(void* addr, size_t bytes);
 // discard the mapping of physical memory to the virtual address range
 void lzr_memory_decommit(void* addr, size_t bytes);
 
+// hint that the range should be backed by huge pages. best-effort, does nothing where unsupported.
+void lzr_memory_hugepage(void* addr, size_t bytes);
+
+// commit and fault in a freshly mapped range upfront so that first touches don't page fault
+void lzr_memory_prefault(void* addr, size_t bytes);
+
+// change committed memory to read/execute or back to read/write. Code is never both
+// writable and executable (W^X): write it while RW and then flip it to RX to run it.
+void lzr_memory_protect(void* addr, size_t bytes, bool executable);
+
+// make freshly written code visible to instruction fetch. required on arm, free on x86.
+void lzr_memory_flush_icache(void* addr, size_t bytes);
+
 #endif // LZR_MEMORY_H
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "poll.h"
+
+#if defined(LZR_WINDOWS)
+    // readiness doesn't map onto windows sockets and files, it wants an IOCP backend which
+    // completes reads and writes instead. Until then nothing can be polled: arming reports every
+    // handle as always ready so lzr_io_wait() completes right away and the i/o itself fails.
+    // No wait is ever pending either, so schedulers only ever park on the futex.
+
+    void lzr_poller_init(lzr_poller_t* self) {
+        self->handle = 0;
+        self->wake = 0;
+    }
+
+    void lzr_poller_destroy(lzr_poller_t* self) {}
+
+    bool lzr_poller_arm(lzr_poller_t* self, intptr_t handle, uint32_t events, void* data, bool registered) {
+        return false;
+    }
+
+    void lzr_poller_remove(lzr_poller_t* self, intptr_t handle) {}
+
+    size_t lzr_poller_wait(lzr_poller_t* self, lzr_poll_event_t* events, size_t max_events, uint64_t timeout) {
+        return 0;
+    }
+
+    void lzr_poller_wake(lzr_poller_t* self) {}
+
+    bool lzr_handle_nonblocking(intptr_t handle) {
+        return false;
+    }
+
+    intptr_t lzr_handle_read(intptr_t handle, void* buffer, size_t bytes) {
+        return LZR_IO_ERROR;
+    }
+
+    intptr_t lzr_handle_write(intptr_t handle, const void* buffer, size_t bytes) {
+        return LZR_IO_ERROR;
+    }
+
+    void lzr_handle_close(intptr_t handle) {}
+
+#elif defined(LZR_LINUX)
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+
+    void lzr_poller_init(lzr_poller_t* self) {
+        self->handle = (intptr_t) epoll_create1(EPOLL_CLOEXEC);
+        self->wake = (intptr_t) eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        assert(self->handle >= 0 && self->wake >= 0);
+
+        // the wake eventfd is the only one with no data and stays armed (level triggered)
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+        int added = epoll_ctl((int) self->handle, EPOLL_CTL_ADD, (int) self->wake, &event);
+        assert(added == 0);
+        (void) added;
+    }
+
+    void lzr_poller_destroy(lzr_poller_t* self) {
+        close((int) self->wake);
+        close((int) self->handle);
+    }
+
+    bool lzr_poller_arm(lzr_poller_t* self, intptr_t handle, uint32_t events, void* data, bool registered) {
+        struct epoll_event event = { .events = EPOLLONESHOT | EPOLLRDHUP, .data.ptr = data };
+        if (events & LZR_POLL_READ)
+            event.events |= EPOLLIN;
+        if (events & LZR_POLL_WRITE)
+            event.events |= EPOLLOUT;
+
+        int armed = epoll_ctl((int) self->handle, registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, (int) handle, &event);
+        if (armed != 0 && errno == EPERM)
+            return false;
+        assert(armed == 0);
+        return true;
+    }
+
+    void lzr_poller_remove(lzr_poller_t* self, intptr_t handle) {
+        epoll_ctl((int) self->handle, EPOLL_CTL_DEL, (int) handle, NULL);
+    }
+
+    size_t lzr_poller_wait(lzr_poller_t* self, lzr_poll_event_t* events, size_t max_events, uint64_t timeout) {
+        struct epoll_event ready[64];
+        if (max_events > sizeof(ready) / sizeof(ready[0]))
+            max_events = sizeof(ready) / sizeof(ready[0]);
+
+        int timeout_millis = -1;
+        if (timeout != LZR_POLL_INFINITE) {
+            uint64_t millis = (timeout + 999999) / 1000000;
+            timeout_millis = millis < INT32_MAX ? (int) millis : INT32_MAX;
+        }
+
+        int count = epoll_wait((int) self->handle, ready, (int) max_events, timeout_millis);
+        size_t num_events = 0;
+        for (int i = 0; i < count; i++) {
+            if (ready[i].data.ptr == NULL) {
+                uint64_t value;
+                while (read((int) self->wake, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+
+            // errors and hang ups are reported as both so that whoever waits sees them on their next read or write
+            uint32_t flags = ready[i].events;
+            events[num_events].data = ready[i].data.ptr;
+            events[num_events].events = 0;
+            if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                events[num_events].events |= LZR_POLL_READ;
+            if (flags & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+                events[num_events].events |= LZR_POLL_WRITE;
+            num_events++;
+        }
+        return num_events;
+    }
+
+    void lzr_poller_wake(lzr_poller_t* self) {
+        uint64_t value = 1;
+        ssize_t written = write((int) self->wake, &value, sizeof(value));
+        (void) written;
+    }
+
+    bool lzr_handle_nonblocking(intptr_t handle) {
+        int flags = fcntl((int) handle, F_GETFL);
+        return flags >= 0 && fcntl((int) handle, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+    intptr_t lzr_handle_read(intptr_t handle, void* buffer, size_t bytes) {
+        while (true) {
+            ssize_t transferred = read((int) handle, buffer, bytes);
+            if (transferred >= 0)
+                return (intptr_t) transferred;
+            if (errno == EINTR)
+                continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? LZR_IO_AGAIN : LZR_IO_ERROR;
+        }
+    }
+
+    intptr_t lzr_handle_write(intptr_t handle, const void* buffer, size_t bytes) {
+        while (true) {
+            ssize_t transferred = write((int) handle, buffer, bytes);
+            if (transferred >= 0)
+                return (intptr_t) transferred;
+            if (errno == EINTR)
+                continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? LZR_IO_AGAIN : LZR_IO_ERROR;
+        }
+    }
+
+    void lzr_handle_close(intptr_t handle) {
+        close((int) handle);
+    }
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef LZR_POLL_H
+#define LZR_POLL_H
+
+#include "../system.h"
+
+/*
+A readiness poller (epoll on linux) which every registered handle is armed on one-shot:
+once a handle is reported it stays registered but is disarmed until lzr_poller_arm() is
+called for it again. Another thread can interrupt a blocking lzr_poller_wait() with
+lzr_poller_wake(), which isn't reported as an event.
+*/
+#define LZR_POLL_READ 1
+#define LZR_POLL_WRITE 2
+
+typedef struct {
+    intptr_t handle;
+    intptr_t wake;
+} lzr_poller_t;
+
+typedef struct {
+    void* data;
+    uint32_t events;
+} lzr_poll_event_t;
+
+void lzr_poller_init(lzr_poller_t* self);
+
+void lzr_poller_destroy(lzr_poller_t* self);
+
+// arm (or re-arm) the handle for the events, reporting `data` when one of them is ready.
+// `registered` says if the handle was armed on this poller before. Returns false for handles
+// which can't be polled as they're always ready (like regular files on linux).
+bool lzr_poller_arm(lzr_poller_t* self, intptr_t handle, uint32_t events, void* data, bool registered);
+
+void lzr_poller_remove(lzr_poller_t* self, intptr_t handle);
+
+// fill up to `max_events` events, blocking for at least one for up to `timeout` nanoseconds
+// (rounded up to a millisecond). 0 doesn't block and LZR_POLL_INFINITE waits indefinitely.
+#define LZR_POLL_INFINITE UINT64_MAX
+
+size_t lzr_poller_wait(lzr_poller_t* self, lzr_poll_event_t* events, size_t max_events, uint64_t timeout);
+
+void lzr_poller_wake(lzr_poller_t* self);
+
+// non-blocking handle i/o. Returns the bytes transferred (0 on end of file for reads),
+// LZR_IO_AGAIN if it would have blocked or LZR_IO_ERROR.
+#define LZR_IO_AGAIN (-1)
+#define LZR_IO_ERROR (-2)
+
+bool lzr_handle_nonblocking(intptr_t handle);
+
+intptr_t lzr_handle_read(intptr_t handle, void* buffer, size_t bytes);
+
+intptr_t lzr_handle_write(intptr_t handle, const void* buffer, size_t bytes);
+
+void lzr_handle_close(intptr_t handle);
+
+#endif // LZR_POLL_H
@@ -0,0 +1,60 @@
+#include "thread.h"
+
+#if defined(LZR_WINDOWS)
+
+    DWORD WINAPI thread_entry(LPVOID param) {
+        lzr_thread_t* self = (lzr_thread_t*) param;
+        self->function(self->arg);
+        return 0;
+    }
+
+    void lzr_thread_spawn(lzr_thread_t* self, lzr_thread_fn function, void* arg) {
+        self->function = function;
+        self->arg = arg;
+        self->handle = CreateThread(NULL, 0, thread_entry, (LPVOID) self, 0, NULL);
+        assert(self->handle != NULL);
+    }
+
+    void lzr_thread_join(lzr_thread_t* self) {
+        WaitForSingleObject(self->handle, INFINITE);
+        CloseHandle(self->handle);
+    }
+
+    size_t lzr_thread_cpu_count() {
+        DWORD_PTR process_mask, system_mask;
+        if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask) == FALSE)
+            return 1;
+        return (size_t) __builtin_popcountll((unsigned long long) process_mask);
+    }
+
+#elif defined(LZR_LINUX)
+    #include <sched.h>
+
+    void* thread_entry(void* param) {
+        lzr_thread_t* self = (lzr_thread_t*) param;
+        self->function(self->arg);
+        return NULL;
+    }
+
+    void lzr_thread_spawn(lzr_thread_t* self, lzr_thread_fn function, void* arg) {
+        self->function = function;
+        self->arg = arg;
+        int spawned = pthread_create(&self->handle, NULL, thread_entry, (void*) self);
+        assert(spawned == 0);
+        (void) spawned;
+    }
+
+    void lzr_thread_join(lzr_thread_t* self) {
+        int joined = pthread_join(self->handle, NULL);
+        assert(joined == 0);
+        (void) joined;
+    }
+
+    size_t lzr_thread_cpu_count() {
+        cpu_set_t cpus;
+        if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0)
+            return 1;
+        return (size_t) CPU_COUNT(&cpus);
+    }
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef LZR_THREAD_H
+#define LZR_THREAD_H
+
+#include "../system.h"
+
+#if defined(LZR_WINDOWS)
+    #include <Windows.h>
+    typedef HANDLE lzr_thread_handle_t;
+#elif defined(LZR_LINUX)
+    #include <pthread.h>
+    typedef pthread_t lzr_thread_handle_t;
+#endif
+
+typedef void (*lzr_thread_fn)(void* arg);
+
+// the thread struct has to outlive the thread as it's passed to it on startup
+typedef struct {
+    lzr_thread_handle_t handle;
+    lzr_thread_fn function;
+    void* arg;
+} lzr_thread_t;
+
+void lzr_thread_spawn(lzr_thread_t* self, lzr_thread_fn function, void* arg);
+
+void lzr_thread_join(lzr_thread_t* self);
+
+// number of cpus the process is allowed to run on
+size_t lzr_thread_cpu_count();
+
+#endif // LZR_THREAD_H
@@ -0,0 +1,26 @@
+#include "time.h"
+
+#if defined(LZR_WINDOWS)
+    #include <Windows.h>
+
+    uint64_t lzr_time_now() {
+        static LARGE_INTEGER frequency = { 0 };
+        if (frequency.QuadPart == 0)
+            QueryPerformanceFrequency(&frequency);
+
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return (uint64_t) ((counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+                           ((counter.QuadPart % frequency.QuadPart) * 1000000000ULL) / frequency.QuadPart);
+    }
+
+#elif defined(LZR_LINUX)
+    #include <time.h>
+
+    uint64_t lzr_time_now() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return ((uint64_t) now.tv_sec * 1000000000ULL) + (uint64_t) now.tv_nsec;
+    }
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef LZR_TIME_H
+#define LZR_TIME_H
+
+#include "../system.h"
+
+// monotonic time in nanoseconds from some arbitrary point
+uint64_t lzr_time_now();
+
+#endif // LZR_TIME_H
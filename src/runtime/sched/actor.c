@@ -0,0 +1,72 @@
+#include "actor.h"
+#include "sched.h"
+#include "../slab.h"
+
+lzr_actor_t* lzr_actor_spawn(lzr_behavior_t behavior, void* state) {
+    lzr_actor_t* self = (lzr_actor_t*) lzr_slab_alloc(sizeof(lzr_actor_t));
+    self->scheduled = 0;
+    self->next = 0;
+    self->name = 0;
+    self->behavior = behavior;
+    self->state = state;
+    lzr_mailbox_init(&self->mailbox);
+    lzr_arena_init(&self->heap);
+    return self;
+}
+
+void lzr_actor_free(lzr_actor_t* self) {
+    uint32_t name = __atomic_load_n(&self->name, __ATOMIC_RELAXED);
+    if (name != 0) {
+        uint32_t actor_ptr = LZR_PTR_ZIP(self);
+        lzr_atom_t* atom = (lzr_atom_t*) LZR_PTR_UNZIP(name);
+        __atomic_compare_exchange_n(&atom->actor, &actor_ptr, 0, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+
+    lzr_arena_destroy(&self->heap);
+    lzr_slab_free((void*) self);
+}
+
+// the fence pairs with the one in sched_run_actor() when it goes idle:
+// either we see it's no longer scheduled or it sees our message in the mailbox.
+void lzr_actor_send(lzr_actor_t* self, lzr_message_t* message) {
+    lzr_mailbox_push(&self->mailbox, message);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&self->scheduled, __ATOMIC_RELAXED) == 0)
+        if (__atomic_exchange_n(&self->scheduled, 1, __ATOMIC_ACQUIRE) == 0)
+            lzr_sched_submit(self);
+}
+
+// the actor claims the name for itself first so that it can't be registered twice concurrently.
+// the release on the atom's slot makes the spawned actor visible to whoever looks it up.
+bool lzr_actor_register(lzr_atom_t* name, lzr_actor_t* actor) {
+    uint32_t no_name = 0;
+    if (!__atomic_compare_exchange_n(&actor->name, &no_name, LZR_PTR_ZIP(name), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return false;
+
+    uint32_t no_actor = 0;
+    if (__atomic_compare_exchange_n(&name->actor, &no_actor, LZR_PTR_ZIP(actor), false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        return true;
+
+    __atomic_store_n(&actor->name, 0, __ATOMIC_RELAXED);
+    return false;
+}
+
+// the name is released before the actor's claim on it, so for a moment the
+// actor can't be registered again under another name but never has two.
+bool lzr_actor_unregister(lzr_atom_t* name) {
+    uint32_t actor_ptr = __atomic_load_n(&name->actor, __ATOMIC_ACQUIRE);
+    do {
+        if (actor_ptr == 0)
+            return false;
+    } while (!__atomic_compare_exchange_n(&name->actor, &actor_ptr, 0, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    lzr_actor_t* actor = (lzr_actor_t*) LZR_PTR_UNZIP(actor_ptr);
+    __atomic_store_n(&actor->name, 0, __ATOMIC_RELAXED);
+    return true;
+}
+
+lzr_actor_t* lzr_actor_whereis(lzr_atom_t* name) {
+    uint32_t actor_ptr = __atomic_load_n(&name->actor, __ATOMIC_ACQUIRE);
+    return actor_ptr != 0 ? (lzr_actor_t*) LZR_PTR_UNZIP(actor_ptr) : NULL;
+}
@@ -0,0 +1,58 @@
+#ifndef LZR_ACTOR_H
+#define LZR_ACTOR_H
+
+#include "mailbox.h"
+#include "../arena.h"
+#include "../atom.h"
+
+typedef struct lzr_actor_t lzr_actor_t;
+
+// called by a scheduler thread for each message the actor receives.
+// the behavior owns the message from then on.
+typedef void (*lzr_behavior_t)(lzr_actor_t* actor, lzr_message_t* message);
+
+/*
+Actors are allocated from the slab allocator so they can be referred to by compressed
+pointer, which is what the scheduler run queues store. An actor is only ever run by one
+scheduler at a time: `scheduled` is set by whoever makes it runnable and cleared by the
+scheduler once its mailbox has been drained.
+Each actor also has its own arena (`heap`) which only it allocates from and collects.
+`name` is the compressed pointer of the atom it's registered under, if any.
+*/
+struct lzr_actor_t {
+    uint32_t scheduled;
+    uint32_t next;
+    uint32_t name;
+    lzr_behavior_t behavior;
+    void* state;
+    lzr_mailbox_t mailbox;
+    lzr_arena_t heap;
+};
+
+lzr_actor_t* lzr_actor_spawn(lzr_behavior_t behavior, void* state);
+
+// there's no tracking of who still holds a reference to an actor (yet)
+// so it's up to the caller to only free actors which won't be sent to anymore.
+// a registered actor is unregistered first.
+void lzr_actor_free(lzr_actor_t* self);
+
+// enqueue a message and schedule the actor if it isn't already. callable from any thread.
+void lzr_actor_send(lzr_actor_t* self, lzr_message_t* message);
+
+/*
+Registered names (like erlang's register/2) are stored directly in the name's atom as the
+compressed pointer of the actor in `lzr_atom_t.actor`, so resolving a name is an atom lookup
+and an atomic load with no registry lock or map. Registering and unregistering are CAS's
+on that slot. An actor can only have one name and a name only one actor at a time.
+*/
+
+// fails if the name is already taken or the actor already has a name
+bool lzr_actor_register(lzr_atom_t* name, lzr_actor_t* actor);
+
+// fails if nothing is registered under the name
+bool lzr_actor_unregister(lzr_atom_t* name);
+
+// the actor registered under the name or NULL
+lzr_actor_t* lzr_actor_whereis(lzr_atom_t* name);
+
+#endif // LZR_ACTOR_H
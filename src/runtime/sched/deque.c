@@ -0,0 +1,64 @@
+#include "deque.h"
+
+// orderings follow "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al.)
+// with the buffer accessed atomically, as a thief may read a slot the owner is overwriting
+// in which case its cas on `top` fails and the value is discarded anyway.
+
+void lzr_deque_init(lzr_deque_t* self) {
+    self->top = 0;
+    self->bottom = 0;
+}
+
+bool lzr_deque_empty(lzr_deque_t* self) {
+    int64_t top = __atomic_load_n(&self->top, __ATOMIC_ACQUIRE);
+    int64_t bottom = __atomic_load_n(&self->bottom, __ATOMIC_ACQUIRE);
+    return bottom <= top;
+}
+
+bool lzr_deque_push(lzr_deque_t* self, uint32_t ptr) {
+    int64_t bottom = __atomic_load_n(&self->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&self->top, __ATOMIC_ACQUIRE);
+    if (bottom - top >= LZR_DEQUE_SIZE)
+        return false;
+
+    __atomic_store_n(&self->buffer[bottom % LZR_DEQUE_SIZE], ptr, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&self->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+uint32_t lzr_deque_pop(lzr_deque_t* self) {
+    int64_t bottom = __atomic_load_n(&self->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&self->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&self->top, __ATOMIC_RELAXED);
+
+    if (top > bottom) {
+        __atomic_store_n(&self->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    uint32_t ptr = __atomic_load_n(&self->buffer[bottom % LZR_DEQUE_SIZE], __ATOMIC_RELAXED);
+    if (top == bottom) {
+        // the last item, race the thieves for it
+        if (!__atomic_compare_exchange_n(&self->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            ptr = 0;
+        __atomic_store_n(&self->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+
+    return ptr;
+}
+
+uint32_t lzr_deque_steal(lzr_deque_t* self) {
+    while (true) {
+        int64_t top = __atomic_load_n(&self->top, __ATOMIC_ACQUIRE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        int64_t bottom = __atomic_load_n(&self->bottom, __ATOMIC_ACQUIRE);
+        if (top >= bottom)
+            return 0;
+
+        uint32_t ptr = __atomic_load_n(&self->buffer[top % LZR_DEQUE_SIZE], __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&self->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            return ptr;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef LZR_DEQUE_H
+#define LZR_DEQUE_H
+
+#include "../system.h"
+#include <stdint.h>
+
+/*
+A Chase-Lev work-stealing deque of compressed heap pointers (see LZR_PTR_ZIP).
+The owning thread pushes and pops at the bottom while any other thread can steal
+from the top. Unlike the original it's a fixed size ring, which keeps it inline in
+the scheduler, so a push can fail when it's full and the caller has to overflow elsewhere.
+Zero is never a valid compressed pointer to an actor so it's used to mean "nothing".
+*/
+#define LZR_DEQUE_SIZE 256
+
+typedef struct {
+    int64_t top;
+    char _pad[64 - sizeof(int64_t)];
+    int64_t bottom;
+    uint32_t buffer[LZR_DEQUE_SIZE];
+} lzr_deque_t;
+
+void lzr_deque_init(lzr_deque_t* self);
+
+// racy but conservative size check, useful for deciding whether to look elsewhere
+bool lzr_deque_empty(lzr_deque_t* self);
+
+// owner only
+bool lzr_deque_push(lzr_deque_t* self, uint32_t ptr);
+
+// owner only
+uint32_t lzr_deque_pop(lzr_deque_t* self);
+
+// any thread
+uint32_t lzr_deque_steal(lzr_deque_t* self);
+
+#endif // LZR_DEQUE_H
@@ -0,0 +1,33 @@
+#include "io.h"
+#include "sched.h"
+
+void lzr_io_init(lzr_io_t* self, intptr_t handle) {
+    self->handle = handle;
+    self->actor = 0;
+    self->message = 0;
+    self->ready = 0;
+    self->poller = 0;
+    lzr_handle_nonblocking(handle);
+}
+
+void lzr_io_close(lzr_io_t* self) {
+    assert(self->actor == 0);
+    lzr_sched_io_remove(self);
+    lzr_handle_close(self->handle);
+}
+
+void lzr_io_wait(lzr_io_t* self, lzr_actor_t* actor, uint32_t events, lzr_message_t* message) {
+    assert(self->actor == 0);
+    self->actor = LZR_PTR_ZIP(actor);
+    self->message = LZR_PTR_ZIP(message);
+    self->ready = 0;
+    lzr_sched_io_arm(self, events);
+}
+
+intptr_t lzr_io_read(lzr_io_t* self, void* buffer, size_t bytes) {
+    return lzr_handle_read(self->handle, buffer, bytes);
+}
+
+intptr_t lzr_io_write(lzr_io_t* self, const void* buffer, size_t bytes) {
+    return lzr_handle_write(self->handle, buffer, bytes);
+}
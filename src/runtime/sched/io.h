@@ -0,0 +1,38 @@
+#ifndef LZR_IO_H
+#define LZR_IO_H
+
+#include "actor.h"
+#include "../os/poll.h"
+
+/*
+Non-blocking i/o for actors on a handle (socket, pipe, file). An actor tries to read or write
+and if it gets LZR_IO_AGAIN, calls lzr_io_wait() and returns from its behavior instead of
+blocking its scheduler. The handle is then armed on the poller of the scheduler running it
+and once it's ready, that scheduler sends the actor the given message (in its next batch of
+completions) so the actor can try again. `ready` holds the events which were reported.
+Handles which can't be polled (regular files) are always ready and get the message at once.
+*/
+typedef struct {
+    intptr_t handle;
+    uint32_t actor;
+    uint32_t message;
+    uint32_t ready;
+    uint32_t poller; // 1 + the index of the scheduler it's registered with, 0 if none
+} lzr_io_t;
+
+// takes ownership of the handle and makes it non-blocking
+void lzr_io_init(lzr_io_t* self, intptr_t handle);
+
+// there can't be a wait outstanding
+void lzr_io_close(lzr_io_t* self);
+
+// only from an actor's behavior, with at most one wait outstanding per handle.
+// the message has to be allocated in the lazer heap like any other.
+void lzr_io_wait(lzr_io_t* self, lzr_actor_t* actor, uint32_t events, lzr_message_t* message);
+
+// see lzr_handle_read() and lzr_handle_write()
+intptr_t lzr_io_read(lzr_io_t* self, void* buffer, size_t bytes);
+
+intptr_t lzr_io_write(lzr_io_t* self, const void* buffer, size_t bytes);
+
+#endif // LZR_IO_H
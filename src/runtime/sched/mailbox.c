@@ -0,0 +1,59 @@
+#include "mailbox.h"
+
+#define MESSAGE(ptr) ((lzr_message_t*) LZR_PTR_UNZIP(ptr))
+
+void lzr_mailbox_init(lzr_mailbox_t* self) {
+    uint32_t stub_ptr = LZR_PTR_ZIP(&self->stub);
+    self->stub.next = 0;
+    self->head = stub_ptr;
+    self->tail = stub_ptr;
+}
+
+// between the exchange and the store the queue is disconnected at `prev`
+// which the consumer sees as a (temporarily) empty queue.
+void lzr_mailbox_push(lzr_mailbox_t* self, lzr_message_t* message) {
+    uint32_t message_ptr = LZR_PTR_ZIP(message);
+    __atomic_store_n(&message->next, 0, __ATOMIC_RELAXED);
+
+    uint32_t prev = __atomic_exchange_n(&self->tail, message_ptr, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&MESSAGE(prev)->next, message_ptr, __ATOMIC_RELEASE);
+}
+
+lzr_message_t* lzr_mailbox_pop(lzr_mailbox_t* self) {
+    uint32_t stub_ptr = LZR_PTR_ZIP(&self->stub);
+    uint32_t head = self->head;
+    uint32_t next = __atomic_load_n(&MESSAGE(head)->next, __ATOMIC_ACQUIRE);
+
+    // skip over the stub
+    if (head == stub_ptr) {
+        if (next == 0)
+            return NULL;
+        self->head = head = next;
+        next = __atomic_load_n(&MESSAGE(head)->next, __ATOMIC_ACQUIRE);
+    }
+
+    if (next != 0) {
+        self->head = next;
+        return MESSAGE(head);
+    }
+
+    // `head` looks like the last message but a producer may be in the middle of pushing after it
+    if (__atomic_load_n(&self->tail, __ATOMIC_ACQUIRE) != head)
+        return NULL;
+
+    // it really is the last one. push the stub behind it so it can be unlinked
+    lzr_mailbox_push(self, &self->stub);
+    next = __atomic_load_n(&MESSAGE(head)->next, __ATOMIC_ACQUIRE);
+    if (next != 0) {
+        self->head = next;
+        return MESSAGE(head);
+    }
+
+    return NULL;
+}
+
+// once drained, the head and tail both end up back at the stub
+bool lzr_mailbox_empty(lzr_mailbox_t* self) {
+    return __atomic_load_n(&self->tail, __ATOMIC_ACQUIRE) == LZR_PTR_ZIP(&self->stub) &&
+           __atomic_load_n(&self->stub.next, __ATOMIC_ACQUIRE) == 0;
+}
@@ -0,0 +1,37 @@
+#ifndef LZR_MAILBOX_H
+#define LZR_MAILBOX_H
+
+#include "../os/heap.h"
+
+// messages are intrusive: a message struct starts with this header and has to be
+// allocated inside the lazer heap (e.g. lzr_slab_alloc) as it's linked by compressed pointer.
+typedef struct {
+    uint32_t next;
+} lzr_message_t;
+
+/*
+An intrusive multi-producer single-consumer queue (Vyukov's) linked by compressed pointers.
+Producers swap themselves in as the `tail` and then link the previous tail to them, so a push
+is wait-free: one exchange and one store. The consumer walks from `head` without any atomic
+read-modify-writes, using the `stub` node to avoid ever leaving the queue truly empty.
+The mailbox needs to live in the lazer heap (8-byte aligned) for the stub to be zipped.
+*/
+typedef struct {
+    uint32_t tail;
+    uint32_t head;
+    lzr_message_t stub;
+} __attribute__((aligned(8))) lzr_mailbox_t;
+
+void lzr_mailbox_init(lzr_mailbox_t* self);
+
+// any thread
+void lzr_mailbox_push(lzr_mailbox_t* self, lzr_message_t* message);
+
+// only the actor owning the mailbox. returns NULL when empty, or when the only
+// messages left are still being pushed (in which case lzr_mailbox_empty() is false).
+lzr_message_t* lzr_mailbox_pop(lzr_mailbox_t* self);
+
+// a push which hasn't finished linking in its message still counts
+bool lzr_mailbox_empty(lzr_mailbox_t* self);
+
+#endif // LZR_MAILBOX_H
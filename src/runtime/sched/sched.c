@@ -0,0 +1,541 @@
+#include "sched.h"
+#include "deque.h"
+#include "../slab.h"
+#include "../os/lock.h"
+#include "../os/thread.h"
+#include "../os/time.h"
+
+// how often a scheduler checks the injector before its own deque.
+// without it, actors on the injector would starve while the local deque keeps refilling.
+#define SCHED_INJECTOR_INTERVAL 61
+
+// how often a scheduler with waits or timers outstanding polls while it has other work to do,
+// and how many events it takes from its poller in one go.
+#define SCHED_POLL_INTERVAL 31
+#define SCHED_POLL_BATCH 64
+
+// how often (in ns) parking schedulers age the heap's retained chunks with lzr_heap_purge().
+// it's by time instead of every park since busy schedulers park constantly.
+#define SCHED_PURGE_INTERVAL (100 * 1000 * 1000)
+
+// how long (in ns) a scheduler has to go without running anything before it hands its slab
+// and chunk caches back. parking for a moment between messages keeps them.
+#define SCHED_FLUSH_AFTER (10 * 1000 * 1000)
+
+typedef struct {
+    lzr_deque_t deque;
+    lzr_thread_t thread;
+    lzr_poller_t poller;
+    bool has_poller;
+    size_t io_pending;
+    uint32_t polling;
+    bool completing;
+    uint32_t completed_head;
+    uint32_t completed_tail;
+    size_t completed;
+    lzr_timer_wheel_t timers;
+    uint64_t rng;
+    int64_t reductions;
+    size_t ticks;
+    size_t index;
+    uint64_t idle_since; // lzr_time_now() of the first park since running an actor, or 0
+    bool flushed;        // whether the caches were flushed since then
+} __attribute__((aligned(64))) sched_worker_t;
+
+typedef struct {
+    // the injector, a fifo of actors linked through their `next` field
+    lzr_mutex_t injector_lock;
+    uint32_t injector_head;
+    uint32_t injector_tail;
+    size_t injector_size;
+
+    // `idle_lock` protects idle & quiescent. `epoch` is the futex parked schedulers wait on.
+    lzr_mutex_t idle_lock;
+    size_t idle;
+    bool quiescent;
+    uint32_t epoch;
+    uint32_t waking;
+    size_t num_workers;
+
+    // waits armed on any poller, and how many schedulers are parked in their poller
+    size_t io_pending;
+    size_t polling;
+
+    // lzr_time_now() of the last lzr_heap_purge()
+    uint64_t purged_at;
+} sched_t;
+
+static sched_t sched;
+static sched_worker_t sched_workers[LZR_SCHED_MAX_THREADS];
+static _Thread_local sched_worker_t* sched_current = NULL;
+
+// append a list of `count` actors already linked from `head` to `tail`
+void sched_inject_list(uint32_t head, uint32_t tail, size_t count) {
+    lzr_mutex_lock(&sched.injector_lock);
+    if (sched.injector_tail == 0) {
+        sched.injector_head = head;
+    } else {
+        ((lzr_actor_t*) LZR_PTR_UNZIP(sched.injector_tail))->next = head;
+    }
+    sched.injector_tail = tail;
+    __atomic_store_n(&sched.injector_size, sched.injector_size + count, __ATOMIC_RELAXED);
+    lzr_mutex_unlock(&sched.injector_lock);
+}
+
+void sched_inject(lzr_actor_t* actor) {
+    uint32_t actor_ptr = LZR_PTR_ZIP(actor);
+    actor->next = 0;
+    sched_inject_list(actor_ptr, actor_ptr, 1);
+}
+
+lzr_actor_t* sched_inject_pop() {
+    if (__atomic_load_n(&sched.injector_size, __ATOMIC_RELAXED) == 0)
+        return NULL;
+
+    lzr_actor_t* actor = NULL;
+    lzr_mutex_lock(&sched.injector_lock);
+    if (sched.injector_head != 0) {
+        actor = (lzr_actor_t*) LZR_PTR_UNZIP(sched.injector_head);
+        sched.injector_head = actor->next;
+        if (sched.injector_head == 0)
+            sched.injector_tail = 0;
+        __atomic_store_n(&sched.injector_size, sched.injector_size - 1, __ATOMIC_RELAXED);
+    }
+    lzr_mutex_unlock(&sched.injector_lock);
+    return actor;
+}
+
+// wake up a parked scheduler to come take the work that was just made available.
+// only one is woken at a time: the rest are left asleep until that one finds something.
+// schedulers parked in their poller are preferred as the futex can't reach them.
+void sched_notify() {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sched.idle, __ATOMIC_RELAXED) == 0)
+        return;
+    if (__atomic_load_n(&sched.waking, __ATOMIC_RELAXED) != 0)
+        return;
+    if (__atomic_exchange_n(&sched.waking, 1, __ATOMIC_ACQUIRE) != 0)
+        return;
+
+    __atomic_fetch_add(&sched.epoch, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sched.polling, __ATOMIC_SEQ_CST) != 0) {
+        for (size_t i = 0; i < sched.num_workers; i++) {
+            sched_worker_t* worker = &sched_workers[i];
+            if (__atomic_load_n(&worker->polling, __ATOMIC_RELAXED) == 0)
+                continue;
+            if (__atomic_exchange_n(&worker->polling, 0, __ATOMIC_RELAXED) == 0)
+                continue;
+            lzr_poller_wake(&worker->poller);
+            return;
+        }
+    }
+
+    lzr_futex_wake_one(&sched.epoch);
+}
+
+void lzr_sched_submit(lzr_actor_t* actor) {
+    sched_worker_t* worker = sched_current;
+
+    // collecting the actors woken by a batch of completions, see sched_batch_begin()
+    if (worker != NULL && worker->completing) {
+        uint32_t actor_ptr = LZR_PTR_ZIP(actor);
+        actor->next = 0;
+        if (worker->completed_tail == 0) {
+            worker->completed_head = actor_ptr;
+        } else {
+            ((lzr_actor_t*) LZR_PTR_UNZIP(worker->completed_tail))->next = actor_ptr;
+        }
+        worker->completed_tail = actor_ptr;
+        worker->completed++;
+        return;
+    }
+
+    if (worker == NULL || !lzr_deque_push(&worker->deque, LZR_PTR_ZIP(actor)))
+        sched_inject(actor);
+    sched_notify();
+}
+
+void lzr_sched_consume(size_t reductions) {
+    sched_worker_t* worker = sched_current;
+    assert(worker != NULL);
+    worker->reductions -= (int64_t) reductions;
+}
+
+uint64_t sched_random(sched_worker_t* worker) {
+    uint64_t x = worker->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return worker->rng = x;
+}
+
+lzr_actor_t* sched_steal(sched_worker_t* worker) {
+    size_t num_workers = sched.num_workers;
+    size_t victim = sched_random(worker) % num_workers;
+
+    for (size_t i = 0; i < num_workers; i++, victim = (victim + 1) % num_workers) {
+        if (victim == worker->index)
+            continue;
+        uint32_t actor_ptr = lzr_deque_steal(&sched_workers[victim].deque);
+        if (actor_ptr != 0)
+            return (lzr_actor_t*) LZR_PTR_UNZIP(actor_ptr);
+    }
+
+    return NULL;
+}
+
+void lzr_sched_io_arm(lzr_io_t* io, uint32_t events) {
+    sched_worker_t* worker = sched_current;
+    assert(worker != NULL);
+
+    // the handle is registered with the scheduler which last waited on it. if the actor has
+    // moved since then it's moved over too, so that it's always polled where the actor runs.
+    uint32_t poller = (uint32_t) worker->index + 1;
+    if (io->poller != poller) {
+        lzr_sched_io_remove(io);
+        io->poller = poller;
+        if (!lzr_poller_arm(&worker->poller, io->handle, events, io, false)) {
+            lzr_actor_t* actor = (lzr_actor_t*) LZR_PTR_UNZIP(io->actor);
+            io->poller = 0;
+            io->ready = events;
+            io->actor = 0;
+            lzr_actor_send(actor, (lzr_message_t*) LZR_PTR_UNZIP(io->message));
+            return;
+        }
+    } else {
+        lzr_poller_arm(&worker->poller, io->handle, events, io, true);
+    }
+
+    worker->io_pending++;
+    __atomic_fetch_add(&sched.io_pending, 1, __ATOMIC_RELAXED);
+}
+
+// a handle without a wait armed is never reported so any thread can unregister it
+void lzr_sched_io_remove(lzr_io_t* io) {
+    if (io->poller != 0)
+        lzr_poller_remove(&sched_workers[io->poller - 1].poller, io->handle);
+    io->poller = 0;
+}
+
+lzr_timer_wheel_t* lzr_sched_timers(uint16_t* id) {
+    sched_worker_t* worker = sched_current;
+    *id = worker != NULL ? (uint16_t) (worker->index + 1) : 0;
+    return worker != NULL ? &worker->timers : NULL;
+}
+
+lzr_timer_wheel_t* lzr_sched_timers_of(uint16_t id) {
+    assert(id != 0);
+    return &sched_workers[id - 1].timers;
+}
+
+// The actors made runnable by i/o completions and timers go onto the injector in one go at
+// the end of a batch rather than onto our deque: it's popped lifo, so actors woken by events
+// could be starved by those woken after them.
+void sched_batch_begin(sched_worker_t* worker) {
+    worker->completing = true;
+    worker->completed_head = 0;
+    worker->completed_tail = 0;
+    worker->completed = 0;
+}
+
+void sched_batch_end(sched_worker_t* worker) {
+    worker->completing = false;
+    if (worker->completed != 0) {
+        sched_inject_list(worker->completed_head, worker->completed_tail, worker->completed);
+        sched_notify();
+    }
+}
+
+// send the actors waiting on the handles that were ready the messages they're waiting for
+void sched_io_complete(sched_worker_t* worker, lzr_poll_event_t* events, size_t num_events) {
+    if (num_events == 0)
+        return;
+
+    worker->io_pending -= num_events;
+    __atomic_fetch_sub(&sched.io_pending, num_events, __ATOMIC_RELAXED);
+
+    for (size_t i = 0; i < num_events; i++) {
+        lzr_io_t* io = (lzr_io_t*) events[i].data;
+        lzr_actor_t* actor = (lzr_actor_t*) LZR_PTR_UNZIP(io->actor);
+        lzr_message_t* message = (lzr_message_t*) LZR_PTR_UNZIP(io->message);
+        io->ready = events[i].events;
+        io->actor = 0;
+        lzr_actor_send(actor, message);
+    }
+}
+
+// ticks are rounded down here (and deadlines up) so timers never fire early
+void sched_expire(sched_worker_t* worker) {
+    if (worker->timers.count == 0)
+        return;
+
+    uint64_t now = lzr_time_now() >> LZR_TIMER_TICK_SHIFT;
+    if (lzr_timer_wheel_next(&worker->timers) <= now)
+        lzr_timer_expire(&worker->timers, now);
+}
+
+// how long the scheduler can park for before its next timer is due
+uint64_t sched_park_timeout(sched_worker_t* worker) {
+    if (worker->timers.count == 0)
+        return LZR_POLL_INFINITE;
+
+    uint64_t next = lzr_timer_wheel_next(&worker->timers) << LZR_TIMER_TICK_SHIFT;
+    uint64_t now = lzr_time_now();
+    return next > now ? next - now : 0;
+}
+
+void sched_poll(sched_worker_t* worker) {
+    lzr_timer_reap(&worker->timers);
+    if (worker->io_pending == 0 && worker->timers.count == 0)
+        return;
+
+    lzr_poll_event_t events[SCHED_POLL_BATCH];
+    sched_batch_begin(worker);
+    if (worker->io_pending != 0)
+        sched_io_complete(worker, events, lzr_poller_wait(&worker->poller, events, SCHED_POLL_BATCH, 0));
+    sched_expire(worker);
+    sched_batch_end(worker);
+}
+
+lzr_actor_t* sched_find_work(sched_worker_t* worker) {
+    lzr_actor_t* actor;
+    if (++worker->ticks % SCHED_INJECTOR_INTERVAL == 0)
+        if ((actor = sched_inject_pop()) != NULL)
+            return actor;
+    if (worker->ticks % SCHED_POLL_INTERVAL == 0)
+        sched_poll(worker);
+
+    uint32_t actor_ptr = lzr_deque_pop(&worker->deque);
+    if (actor_ptr != 0)
+        return (lzr_actor_t*) LZR_PTR_UNZIP(actor_ptr);
+
+    if ((actor = sched_inject_pop()) != NULL)
+        return actor;
+
+    sched_poll(worker);
+    if ((actor = sched_inject_pop()) != NULL)
+        return actor;
+    return sched_steal(worker);
+}
+
+bool sched_has_work() {
+    if (__atomic_load_n(&sched.injector_size, __ATOMIC_RELAXED) != 0)
+        return true;
+    for (size_t i = 0; i < sched.num_workers; i++)
+        if (!lzr_deque_empty(&sched_workers[i].deque))
+            return true;
+    return false;
+}
+
+// timers which were cancelled from other schedulers don't count, they're never going to fire
+bool sched_has_timers() {
+    for (size_t i = 0; i < sched.num_workers; i++)
+        if (__atomic_load_n(&sched_workers[i].timers.armed, __ATOMIC_RELAXED) != 0)
+            return true;
+    return false;
+}
+
+// Block in the poller until one of the handles is ready, the timeout passes or sched_notify()
+// wakes us up. `polling` is set before the epoch is checked (and notify bumps the epoch before
+// checking `polling`) so either we see that there's new work or notify sees us and wakes the poller.
+size_t sched_park_poll(sched_worker_t* worker, uint32_t epoch, lzr_poll_event_t* events, uint64_t timeout) {
+    __atomic_store_n(&worker->polling, 1, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&sched.polling, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&sched.epoch, __ATOMIC_SEQ_CST) != epoch)
+        timeout = 0;
+    size_t num_events = lzr_poller_wait(&worker->poller, events, SCHED_POLL_BATCH, timeout);
+
+    __atomic_fetch_sub(&sched.polling, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->polling, 0, __ATOMIC_RELAXED);
+    return num_events;
+}
+
+// decommit retained chunks nobody has reused for a few intervals. only the scheduler
+// which wins the race to bump `purged_at` does it
+void sched_purge() {
+    uint64_t now = lzr_time_now();
+    uint64_t purged_at = __atomic_load_n(&sched.purged_at, __ATOMIC_RELAXED);
+    if (now - purged_at < SCHED_PURGE_INTERVAL)
+        return;
+    if (__atomic_compare_exchange_n(&sched.purged_at, &purged_at, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        lzr_heap_purge(false);
+}
+
+// Park the scheduler until there's more work, returning false when it should exit instead.
+// Counting itself as idle and rechecking for work both happen under `idle_lock` so that the
+// last scheduler to park can tell that nothing is running: only running actors create work
+// so if all the others are idle and there's nothing queued, there never will be again.
+// Waits and timers which are still armed will create work though, so they keep it from exiting
+// and it parks in its poller when it has waits and only until its next timer when it has timers.
+bool sched_park(sched_worker_t* worker) {
+    uint32_t epoch = __atomic_load_n(&sched.epoch, __ATOMIC_ACQUIRE);
+    bool parked = false;
+
+    lzr_mutex_lock(&sched.idle_lock);
+    if (!sched.quiescent) {
+        // pairs with the fence in sched_notify(): either we see its work or it sees us idle
+        __atomic_store_n(&sched.idle, sched.idle + 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (sched_has_work()) {
+            __atomic_store_n(&sched.idle, sched.idle - 1, __ATOMIC_RELAXED);
+        } else if (sched.idle == sched.num_workers && __atomic_load_n(&sched.io_pending, __ATOMIC_RELAXED) == 0 && !sched_has_timers()) {
+            sched.quiescent = true;
+            __atomic_fetch_add(&sched.epoch, 1, __ATOMIC_RELEASE);
+            lzr_futex_wake_all(&sched.epoch);
+        } else {
+            parked = true;
+        }
+    }
+    lzr_mutex_unlock(&sched.idle_lock);
+
+    if (parked) {
+        lzr_poll_event_t events[SCHED_POLL_BATCH];
+        size_t num_events = 0;
+        lzr_timer_reap(&worker->timers);
+        uint64_t timeout = sched_park_timeout(worker);
+
+        // idle for a while: hand back the chunks and slabs this thread is caching so the
+        // schedulers still running can use them instead of growing the heap meanwhile.
+        // until then it only sleeps as long as it takes to get there.
+        if (timeout != 0) {
+            uint64_t now = lzr_time_now();
+            if (worker->idle_since == 0)
+                worker->idle_since = now;
+            if (!worker->flushed) {
+                uint64_t idle = now - worker->idle_since;
+                if (idle >= SCHED_FLUSH_AFTER) {
+                    lzr_slab_thread_flush();
+                    lzr_heap_cache_flush();
+                    worker->flushed = true;
+                } else if (timeout > SCHED_FLUSH_AFTER - idle) {
+                    timeout = SCHED_FLUSH_AFTER - idle;
+                }
+            }
+            sched_purge();
+        }
+
+        if (worker->io_pending != 0) {
+            num_events = sched_park_poll(worker, epoch, events, timeout);
+        } else if (timeout == LZR_POLL_INFINITE) {
+            lzr_futex_wait(&sched.epoch, epoch);
+        } else if (timeout != 0) {
+            lzr_futex_wait_for(&sched.epoch, epoch, timeout);
+        }
+
+        lzr_mutex_lock(&sched.idle_lock);
+        __atomic_store_n(&sched.idle, sched.idle - 1, __ATOMIC_RELAXED);
+        lzr_mutex_unlock(&sched.idle_lock);
+
+        sched_batch_begin(worker);
+        sched_io_complete(worker, events, num_events);
+        sched_expire(worker);
+        sched_batch_end(worker);
+    }
+
+    // letting notify() wake another scheduler early is harmless, one never being woken isn't
+    __atomic_store_n(&sched.waking, 0, __ATOMIC_RELEASE);
+    return !__atomic_load_n(&sched.quiescent, __ATOMIC_ACQUIRE);
+}
+
+// Process messages until the mailbox is empty or the actor runs out of reductions.
+// Returns true if it was preempted (or has to wait on a sender) and needs to be rescheduled.
+bool sched_run_actor(sched_worker_t* worker, lzr_actor_t* actor) {
+    worker->reductions = LZR_SCHED_REDUCTIONS;
+
+    while (worker->reductions > 0) {
+        lzr_message_t* message = lzr_mailbox_pop(&actor->mailbox);
+        if (message == NULL) {
+            // a sender is halfway through pushing. rather than spinning
+            // until it links its message in, let other actors run first.
+            if (!lzr_mailbox_empty(&actor->mailbox))
+                return true;
+
+            // see lzr_actor_send(). if a message came in after we went idle and
+            // its sender didn't see that in time, reschedule it ourselves.
+            __atomic_store_n(&actor->scheduled, 0, __ATOMIC_RELEASE);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (lzr_mailbox_empty(&actor->mailbox))
+                return false;
+            if (__atomic_exchange_n(&actor->scheduled, 1, __ATOMIC_ACQUIRE) != 0)
+                return false;
+            continue;
+        }
+
+        worker->reductions--;
+        actor->behavior(actor, message);
+    }
+
+    return true;
+}
+
+void sched_worker_main(void* arg) {
+    sched_worker_t* worker = (sched_worker_t*) arg;
+    sched_current = worker;
+
+    while (true) {
+        lzr_actor_t* actor = sched_find_work(worker);
+        if (actor == NULL) {
+            if (!sched_park(worker))
+                break;
+            continue;
+        }
+
+        worker->idle_since = 0;
+        worker->flushed = false;
+        if (sched_run_actor(worker, actor)) {
+            sched_inject(actor);
+            sched_notify();
+        }
+    }
+
+    lzr_timer_purge(&worker->timers);
+
+    sched_current = NULL;
+    lzr_slab_thread_flush();
+    lzr_heap_cache_flush();
+}
+
+void lzr_sched_run(size_t num_threads) {
+    if (num_threads == 0)
+        num_threads = lzr_thread_cpu_count();
+    if (num_threads > LZR_SCHED_MAX_THREADS)
+        num_threads = LZR_SCHED_MAX_THREADS;
+
+    lzr_mutex_init(&sched.idle_lock);
+    sched.idle = 0;
+    sched.quiescent = false;
+    sched.waking = 0;
+    sched.num_workers = num_threads;
+    sched.io_pending = 0;
+    sched.polling = 0;
+    sched.purged_at = lzr_time_now();
+
+    for (size_t i = 0; i < num_threads; i++) {
+        sched_worker_t* worker = &sched_workers[i];
+        lzr_deque_init(&worker->deque);
+        worker->io_pending = 0;
+        worker->polling = 0;
+        worker->completing = false;
+        lzr_timer_wheel_init(&worker->timers, lzr_time_now() >> LZR_TIMER_TICK_SHIFT);
+        worker->rng = 0x9e3779b97f4a7c15ULL * (i + 1);
+        worker->ticks = 0;
+        worker->idle_since = 0;
+        worker->flushed = false;
+        worker->index = i;
+
+        // handles stay registered with a poller between runs so pollers live as long as the process
+        if (!worker->has_poller) {
+            lzr_poller_init(&worker->poller);
+            worker->has_poller = true;
+        }
+    }
+
+    for (size_t i = 0; i < num_threads; i++)
+        lzr_thread_spawn(&sched_workers[i].thread, sched_worker_main, &sched_workers[i]);
+    for (size_t i = 0; i < num_threads; i++)
+        lzr_thread_join(&sched_workers[i].thread);
+
+    // the workers flushed their caches on exit, nothing is going to reuse what's retained now
+    lzr_heap_purge(true);
+}
@@ -0,0 +1,48 @@
+#ifndef LZR_SCHED_H
+#define LZR_SCHED_H
+
+#include "io.h"
+#include "timer.h"
+
+/*
+One scheduler thread per core, each with its own work-stealing deque of runnable actors.
+Actors made runnable on a scheduler thread go onto its deque (and run next, for cache locality)
+while ones from outside, those which overflow a deque and ones which were preempted go onto
+a shared injector queue. Schedulers which run out of work steal from random others and then
+park on a futex. Once every scheduler is parked with no work left, lzr_sched_run() returns.
+
+Each scheduler also has its own poller for the handles its actors wait on (see io.h). It polls
+without blocking every so often and whenever its deque runs dry, delivering everything that's
+ready in one batch. A scheduler with waits outstanding parks in its poller instead of on the futex
+and lzr_sched_run() only returns once there are no waits left either.
+Timers (see timer.h) work the same way: a scheduler expires the timers on its own wheel in a batch
+whenever it polls, parks no longer than until the next one is due and keeps lzr_sched_run() going.
+*/
+#define LZR_SCHED_MAX_THREADS 256
+
+// every message received costs an actor a reduction. When an actor runs out of them
+// it's preempted and sent to the back of the injector so others get a chance to run.
+#define LZR_SCHED_REDUCTIONS 1000
+
+// run actors on `num_threads` schedulers (0 for one per cpu) until none are runnable.
+// the heap needs to be committed. actors can be sent to beforehand to kick things off.
+void lzr_sched_run(size_t num_threads);
+
+// charge the currently running actor some extra reductions for expensive work
+void lzr_sched_consume(size_t reductions);
+
+// make an actor which was marked as scheduled runnable. used by lzr_actor_send()
+void lzr_sched_submit(lzr_actor_t* actor);
+
+// arm the handle on the current scheduler's poller. used by lzr_io_wait()
+void lzr_sched_io_arm(lzr_io_t* io, uint32_t events);
+
+// unregister the handle from whichever poller it's on. used by lzr_io_close()
+void lzr_sched_io_remove(lzr_io_t* io);
+
+// the current scheduler's timer wheel and its id for lzr_sched_timers_of(), or NULL off a scheduler
+lzr_timer_wheel_t* lzr_sched_timers(uint16_t* id);
+
+lzr_timer_wheel_t* lzr_sched_timers_of(uint16_t id);
+
+#endif // LZR_SCHED_H
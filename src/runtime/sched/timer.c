@@ -0,0 +1,240 @@
+#include "timer.h"
+#include "sched.h"
+#include "../slab.h"
+#include "../os/time.h"
+
+#define TIMER_ARMED 0
+#define TIMER_FIRED 1
+#define TIMER_CANCELLED 2
+
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+
+// the `slot` of a cancelled timer which its wheel reached and unlinked before it was reaped
+#define TIMER_DETACHED UINT16_MAX
+
+void lzr_timer_wheel_init(lzr_timer_wheel_t* self, uint64_t now) {
+    self->now = now;
+    self->count = 0;
+    self->armed = 0;
+    self->cancelled = 0;
+    for (size_t level = 0; level < LZR_TIMER_LEVELS; level++) {
+        self->occupied[level] = 0;
+        for (size_t slot = 0; slot < TIMER_SLOTS; slot++)
+            self->slots[level][slot] = 0;
+    }
+}
+
+uint64_t lzr_timer_ticks(uint64_t nanos) {
+    return (nanos + (1ULL << LZR_TIMER_TICK_SHIFT) - 1) >> LZR_TIMER_TICK_SHIFT;
+}
+
+// the level is that of the highest digit where the deadline differs from now.
+// deadlines past the end of the wheel go in the top level and get cascaded until they fit.
+void timer_link(lzr_timer_wheel_t* self, lzr_timer_t* timer) {
+    uint64_t deadline = timer->deadline > self->now ? timer->deadline : self->now;
+    uint64_t differs = (deadline ^ self->now) | (TIMER_SLOTS - 1);
+    if (differs > LZR_TIMER_MAX_TICKS)
+        differs = LZR_TIMER_MAX_TICKS;
+
+    size_t level = (63 - __builtin_clzll(differs)) / TIMER_SLOT_BITS;
+    size_t slot = (deadline >> (level * TIMER_SLOT_BITS)) & (TIMER_SLOTS - 1);
+    uint32_t* head = &self->slots[level][slot];
+
+    uint32_t timer_ptr = LZR_PTR_ZIP(timer);
+    timer->slot = (uint16_t) (level * TIMER_SLOTS + slot);
+    timer->prev = 0;
+    timer->next = *head;
+    if (*head != 0)
+        ((lzr_timer_t*) LZR_PTR_UNZIP(*head))->prev = timer_ptr;
+    *head = timer_ptr;
+    self->occupied[level] |= 1ULL << slot;
+}
+
+void lzr_timer_wheel_insert(lzr_timer_wheel_t* self, lzr_timer_t* timer, uint64_t deadline) {
+    timer->deadline = deadline;
+    timer_link(self, timer);
+    self->count++;
+}
+
+void lzr_timer_wheel_remove(lzr_timer_wheel_t* self, lzr_timer_t* timer) {
+    size_t level = timer->slot / TIMER_SLOTS;
+    size_t slot = timer->slot % TIMER_SLOTS;
+
+    if (timer->prev != 0) {
+        ((lzr_timer_t*) LZR_PTR_UNZIP(timer->prev))->next = timer->next;
+    } else {
+        self->slots[level][slot] = timer->next;
+        if (timer->next == 0)
+            self->occupied[level] &= ~(1ULL << slot);
+    }
+    if (timer->next != 0)
+        ((lzr_timer_t*) LZR_PTR_UNZIP(timer->next))->prev = timer->prev;
+    self->count--;
+}
+
+// The tick at which a level's next non-empty slot starts. Slots behind the current one belong to
+// the next time around, which only happens in the top level for deadlines past the end of the wheel.
+// Above level 0 that's also true of the current slot as its timers would have been cascaded already.
+uint64_t timer_level_next(lzr_timer_wheel_t* self, size_t level) {
+    uint64_t occupied = self->occupied[level];
+    if (occupied == 0)
+        return UINT64_MAX;
+
+    size_t shift = level * TIMER_SLOT_BITS;
+    size_t current = (self->now >> shift) & (TIMER_SLOTS - 1);
+    size_t first = level == 0 ? current : current + 1;
+    uint64_t ahead = first < TIMER_SLOTS ? occupied & (~0ULL << first) : 0;
+
+    uint64_t span = 1ULL << (shift + TIMER_SLOT_BITS);
+    uint64_t base = self->now & ~(span - 1);
+    if (ahead != 0)
+        return base + ((uint64_t) __builtin_ctzll(ahead) << shift);
+    return base + span + ((uint64_t) __builtin_ctzll(occupied) << shift);
+}
+
+uint64_t lzr_timer_wheel_next(lzr_timer_wheel_t* self) {
+    uint64_t next = UINT64_MAX;
+    for (size_t level = 0; level < LZR_TIMER_LEVELS; level++) {
+        uint64_t tick = timer_level_next(self, level);
+        if (tick < next)
+            next = tick;
+    }
+    return next;
+}
+
+// jump from one non-empty slot to the next instead of stepping through every tick in between
+void lzr_timer_wheel_advance(lzr_timer_wheel_t* self, uint64_t now, lzr_timer_expire_t expire, void* ctx) {
+    while (self->count != 0) {
+        size_t level = 0;
+        uint64_t next = UINT64_MAX;
+        for (size_t i = 0; i < LZR_TIMER_LEVELS; i++) {
+            uint64_t tick = timer_level_next(self, i);
+            if (tick < next) {
+                next = tick;
+                level = i;
+            }
+        }
+        if (next > now)
+            break;
+
+        // take the whole slot and either fire or cascade everything in it
+        self->now = next;
+        size_t slot = (next >> (level * TIMER_SLOT_BITS)) & (TIMER_SLOTS - 1);
+        uint32_t timer_ptr = self->slots[level][slot];
+        self->slots[level][slot] = 0;
+        self->occupied[level] &= ~(1ULL << slot);
+
+        while (timer_ptr != 0) {
+            lzr_timer_t* timer = (lzr_timer_t*) LZR_PTR_UNZIP(timer_ptr);
+            timer_ptr = timer->next;
+            if (timer->deadline <= next) {
+                self->count--;
+                expire(ctx, timer);
+            } else {
+                timer_link(self, timer);
+            }
+        }
+    }
+
+    if (now > self->now)
+        self->now = now;
+}
+
+lzr_timer_t* lzr_timer_send_after(lzr_actor_t* actor, lzr_message_t* message, uint64_t delay) {
+    uint16_t wheel_id;
+    lzr_timer_wheel_t* wheel = lzr_sched_timers(&wheel_id);
+    assert(wheel != NULL);
+
+    lzr_timer_t* timer = (lzr_timer_t*) lzr_slab_alloc(sizeof(lzr_timer_t));
+    timer->actor = LZR_PTR_ZIP(actor);
+    timer->message = LZR_PTR_ZIP(message);
+    timer->state = TIMER_ARMED;
+    timer->wheel = wheel_id;
+    lzr_timer_wheel_insert(wheel, timer, lzr_timer_ticks(lzr_time_now() + delay));
+    __atomic_fetch_add(&wheel->armed, 1, __ATOMIC_RELAXED);
+    return timer;
+}
+
+// only the scheduler which armed a timer fires it, so on that scheduler nothing can race
+// with cancelling it. Anywhere else the cancel and the firing race on `state`.
+bool lzr_timer_cancel(lzr_timer_t* timer, lzr_message_t** message) {
+    uint16_t wheel_id;
+    lzr_timer_wheel_t* wheel = lzr_sched_timers(&wheel_id);
+    bool local = wheel != NULL && timer->wheel == wheel_id;
+    lzr_message_t* armed_message = (lzr_message_t*) LZR_PTR_UNZIP(timer->message);
+
+    // a timer cancelled remotely can only be unlinked by its own scheduler, so it's handed over
+    // through the wheel's `cancelled` stack, linked by `message` which nothing needs anymore.
+    // it stops counting as armed right away so it doesn't keep the other schedulers running.
+    bool cancelled;
+    if (local) {
+        cancelled = __atomic_load_n(&timer->state, __ATOMIC_RELAXED) == TIMER_ARMED;
+        if (cancelled) {
+            lzr_timer_wheel_remove(wheel, timer);
+            __atomic_fetch_sub(&wheel->armed, 1, __ATOMIC_RELAXED);
+        }
+        lzr_slab_free((void*) timer);
+    } else {
+        lzr_timer_wheel_t* timer_wheel = lzr_sched_timers_of(timer->wheel);
+        uint32_t state = TIMER_ARMED;
+        cancelled = __atomic_compare_exchange_n(&timer->state, &state, TIMER_CANCELLED, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE);
+        if (cancelled) {
+            __atomic_fetch_sub(&timer_wheel->armed, 1, __ATOMIC_RELAXED);
+            uint32_t head = __atomic_load_n(&timer_wheel->cancelled, __ATOMIC_RELAXED);
+            do {
+                __atomic_store_n(&timer->message, head, __ATOMIC_RELAXED);
+            } while (!__atomic_compare_exchange_n(&timer_wheel->cancelled, &head, LZR_PTR_ZIP(timer), true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        } else {
+            lzr_slab_free((void*) timer);
+        }
+    }
+
+    if (cancelled && message != NULL)
+        *message = armed_message;
+    return cancelled;
+}
+
+// the timer's fields are read before it's marked as fired since it can be freed right after.
+// `message` is overwritten if it was cancelled instead, which only matters if it did fire.
+// a cancelled timer is on (or about to be pushed onto) the `cancelled` stack so it's left for
+// lzr_timer_reap() to free, only noting that the wheel already unlinked it.
+void timer_fire(void* ctx, lzr_timer_t* timer) {
+    lzr_timer_wheel_t* wheel = (lzr_timer_wheel_t*) ctx;
+    lzr_actor_t* actor = (lzr_actor_t*) LZR_PTR_UNZIP(timer->actor);
+    lzr_message_t* message = (lzr_message_t*) LZR_PTR_UNZIP(__atomic_load_n(&timer->message, __ATOMIC_RELAXED));
+
+    uint32_t state = TIMER_ARMED;
+    if (__atomic_compare_exchange_n(&timer->state, &state, TIMER_FIRED, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+        __atomic_fetch_sub(&wheel->armed, 1, __ATOMIC_RELAXED);
+        lzr_actor_send(actor, message);
+    } else {
+        timer->slot = TIMER_DETACHED;
+    }
+}
+
+void lzr_timer_expire(lzr_timer_wheel_t* wheel, uint64_t now) {
+    lzr_timer_wheel_advance(wheel, now, timer_fire, wheel);
+}
+
+void lzr_timer_reap(lzr_timer_wheel_t* wheel) {
+    if (__atomic_load_n(&wheel->cancelled, __ATOMIC_RELAXED) == 0)
+        return;
+
+    uint32_t timer_ptr = __atomic_exchange_n(&wheel->cancelled, 0, __ATOMIC_ACQUIRE);
+    while (timer_ptr != 0) {
+        lzr_timer_t* timer = (lzr_timer_t*) LZR_PTR_UNZIP(timer_ptr);
+        timer_ptr = timer->message;
+        if (timer->slot != TIMER_DETACHED)
+            lzr_timer_wheel_remove(wheel, timer);
+        lzr_slab_free((void*) timer);
+    }
+}
+
+// nothing is running anymore so every timer cancelled remotely has been pushed by now
+void lzr_timer_purge(lzr_timer_wheel_t* wheel) {
+    assert(__atomic_load_n(&wheel->armed, __ATOMIC_RELAXED) == 0);
+    lzr_timer_reap(wheel);
+    assert(wheel->count == 0);
+    lzr_timer_wheel_init(wheel, 0);
+}
@@ -0,0 +1,94 @@
+#ifndef LZR_TIMER_H
+#define LZR_TIMER_H
+
+#include "actor.h"
+
+/*
+Timers send an actor a message after a delay, which is also how `receive ... after` times out:
+the actor arms a timer to send itself the timeout and cancels it if something else came first.
+So most timers are short lived and never fire, making arming and cancelling the hot paths.
+
+Each scheduler has its own hierarchical timing wheel (like the linux kernel's and tokio's)
+of LZR_TIMER_LEVELS levels with 64 slots each. Level 0 slots are one tick wide and each level's
+slots span a whole wheel of the level below. A timer goes into the level of the most significant
+6 bit digit in which its deadline differs from the wheel's current tick, so inserting and
+unlinking are O(1). Once the wheel reaches a slot it either fires its timers (level 0) or
+cascades them down into the levels below. Every level keeps a bitmap of its non-empty slots
+so finding the next deadline is a handful of bit scans however many timers are armed.
+
+Timers are slab allocated and linked by compressed pointers so they only take up 32 bytes.
+*/
+#define LZR_TIMER_LEVELS 6
+
+// a tick is 2^20ns (about a millisecond) so the wheel covers 2^36 ticks, or about 2 years
+#define LZR_TIMER_TICK_SHIFT 20
+#define LZR_TIMER_MAX_TICKS ((1ULL << (6 * LZR_TIMER_LEVELS)) - 1)
+
+typedef struct {
+    uint32_t next;
+    uint32_t prev;
+    uint32_t actor;
+    uint32_t message;
+    uint64_t deadline;
+    uint32_t state;
+    uint16_t slot;
+    uint16_t wheel; // 1 + the index of the scheduler whose wheel it's in
+} lzr_timer_t;
+
+// `count` is how many timers are linked into the wheel and only its scheduler uses it.
+// `armed` is how many of those can still fire and is read by the other schedulers.
+// `cancelled` is a stack of timers cancelled from other threads, waiting to be unlinked & freed.
+typedef struct {
+    uint64_t now;
+    size_t count;
+    size_t armed;
+    uint32_t cancelled;
+    uint64_t occupied[LZR_TIMER_LEVELS];
+    uint32_t slots[LZR_TIMER_LEVELS][64];
+} lzr_timer_wheel_t;
+
+// called with each timer whose deadline the wheel has passed
+typedef void (*lzr_timer_expire_t)(void* ctx, lzr_timer_t* timer);
+
+void lzr_timer_wheel_init(lzr_timer_wheel_t* self, uint64_t now);
+
+// `deadline` is in ticks. deadlines in the past expire on the next advance.
+void lzr_timer_wheel_insert(lzr_timer_wheel_t* self, lzr_timer_t* timer, uint64_t deadline);
+
+void lzr_timer_wheel_remove(lzr_timer_wheel_t* self, lzr_timer_t* timer);
+
+// the tick at which the wheel next needs to be advanced, UINT64_MAX when it's empty.
+// this can be earlier than the closest deadline when timers need to be cascaded.
+uint64_t lzr_timer_wheel_next(lzr_timer_wheel_t* self);
+
+// move the wheel up to tick `now`, unlinking every timer due by then and passing it to `expire`
+void lzr_timer_wheel_advance(lzr_timer_wheel_t* self, uint64_t now, lzr_timer_expire_t expire, void* ctx);
+
+// convert from the nanoseconds of lzr_time_now(), rounding up so a timer never fires early
+uint64_t lzr_timer_ticks(uint64_t nanos);
+
+/*
+Sending messages later. Timers are armed on the wheel of the scheduler running the caller
+and every timer has to be passed to lzr_timer_cancel() exactly once, even after it fired,
+which is what frees it. Cancelling from the scheduler which armed it unlinks it right away.
+From any other thread it's marked as cancelled and pushed onto its wheel's `cancelled` stack,
+which the scheduler drains with lzr_timer_reap() whenever it polls or parks.
+*/
+
+// only from a scheduler thread. `delay` is in nanoseconds.
+lzr_timer_t* lzr_timer_send_after(lzr_actor_t* actor, lzr_message_t* message, uint64_t delay);
+
+// returns true if the timer was cancelled before it fired, handing the message back
+// to the caller through `message` (if not NULL). Otherwise the message was or is being sent.
+bool lzr_timer_cancel(lzr_timer_t* timer, lzr_message_t** message);
+
+// fire the timers due by tick `now` on a scheduler's wheel
+void lzr_timer_expire(lzr_timer_wheel_t* wheel, uint64_t now);
+
+// unlink and free the timers cancelled from other threads since the last call
+void lzr_timer_reap(lzr_timer_wheel_t* wheel);
+
+// free a scheduler's timers once all that's left are ones cancelled from elsewhere
+void lzr_timer_purge(lzr_timer_wheel_t* wheel);
+
+#endif // LZR_TIMER_H
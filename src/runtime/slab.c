@@ -0,0 +1,254 @@
+#include "slab.h"
+#include "os/lock.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SLAB_SIZE (256 * 1024)
+#define SLAB_HEADER_SIZE 64
+#define SLABS_PER_CHUNK (LZR_HEAP_CHUNK_SIZE / SLAB_SIZE)
+#define SLAB_CLASSES 44
+#define SLAB_CHUNKS ((LZR_HEAP_END - LZR_HEAP_BEGIN) / LZR_HEAP_CHUNK_SIZE)
+
+#define SLAB_OF(ptr) ((slab_t*) (((size_t) (ptr)) & ~((size_t) SLAB_SIZE - 1)))
+#define SLAB_CHUNK_INDEX(slab) ((((size_t) (slab)) - LZR_HEAP_BEGIN) / LZR_HEAP_CHUNK_SIZE)
+#define SLAB_NEXT(ptr) (*((uint32_t*) (ptr)))
+
+typedef struct slab_cache_t slab_cache_t;
+
+// all the links are compressed heap pointers with 0 meaning none.
+// `live` is only touched by the owner and counts the objects not known to be freed.
+// `remote_frees` counts the remote frees the owner hasn't subtracted from `live` yet.
+// Orphaning a slab rebases the counter so that it lands exactly on SLAB_ORPHANED once
+// every live object was freed, which only one thread can observe.
+#define SLAB_ORPHANED (1U << 31)
+
+typedef struct {
+    uint32_t next;
+    uint32_t prev;
+    uint32_t free;
+    uint32_t bump;
+    uint32_t live;
+    uint32_t object_size;
+    uint16_t size_class;
+    _Atomic(uint32_t) remote_free;
+    _Atomic(uint32_t) remote_frees;
+    _Atomic(slab_cache_t*) owner;
+} slab_t;
+
+// the slab objects are currently being allocated from for each size class
+// as well as the rest of the slabs owned by this thread (doubly linked)
+struct slab_cache_t {
+    slab_t* active[SLAB_CLASSES];
+    uint32_t partial[SLAB_CLASSES];
+};
+
+typedef struct {
+    lzr_mutex_t lock;
+    uint32_t free;
+    uint8_t chunk_used[SLAB_CHUNKS];
+} slab_pool_t;
+
+static slab_pool_t slab_pool = { { 0 }, 0, { 0 } };
+static _Thread_local slab_cache_t slab_cache;
+
+// classes go up by 8 bytes until 64 and then by 4 steps per power of two up to 32kb
+uint16_t slab_size_class(size_t size) {
+    if (size <= 64)
+        return (uint16_t) ((size + 7) / 8) - 1;
+    uint16_t log2 = 63 - __builtin_clzl(size - 1);
+    return 8 + ((log2 - 6) * 4) + (uint16_t) ((size - 1) >> (log2 - 2)) - 4;
+}
+
+uint32_t slab_class_size(uint16_t size_class) {
+    if (size_class < 8)
+        return (size_class + 1) * 8;
+    uint16_t log2 = 6 + ((size_class - 8) / 4);
+    return (1U << log2) + (((size_class - 8) % 4) + 1) * (1U << (log2 - 2));
+}
+
+void slab_list_push(uint32_t* head, slab_t* slab) {
+    uint32_t slab_ptr = LZR_PTR_ZIP(slab);
+    slab->prev = 0;
+    slab->next = *head;
+    if (*head != 0)
+        ((slab_t*) LZR_PTR_UNZIP(*head))->prev = slab_ptr;
+    *head = slab_ptr;
+}
+
+void slab_list_remove(uint32_t* head, slab_t* slab) {
+    if (slab->prev != 0)
+        ((slab_t*) LZR_PTR_UNZIP(slab->prev))->next = slab->next;
+    if (slab->next != 0)
+        ((slab_t*) LZR_PTR_UNZIP(slab->next))->prev = slab->prev;
+    if (*head == LZR_PTR_ZIP(slab))
+        *head = slab->next;
+}
+
+// get an unused slab from the pool, carving up a new chunk from the heap if there are none
+slab_t* slab_pool_acquire() {
+    slab_pool_t* pool = &slab_pool;
+    lzr_mutex_lock(&pool->lock);
+
+    // every caller of lzr_slab_alloc() relies on it succeeding, so running out is fatal
+    if (pool->free == 0) {
+        char* chunk = (char*) lzr_heap_alloc_committed(1);
+        if (chunk == NULL) {
+            fprintf(stderr, "lazer: out of heap for slabs\n");
+            abort();
+        }
+        for (size_t offset = 0; offset < LZR_HEAP_CHUNK_SIZE; offset += SLAB_SIZE)
+            slab_list_push(&pool->free, (slab_t*) (chunk + offset));
+    }
+
+    slab_t* slab = (slab_t*) LZR_PTR_UNZIP(pool->free);
+    slab_list_remove(&pool->free, slab);
+    pool->chunk_used[SLAB_CHUNK_INDEX(slab)]++;
+
+    lzr_mutex_unlock(&pool->lock);
+    return slab;
+}
+
+// return an empty slab to the pool. once all of a chunk's slabs are back,
+// the chunk is retained by the heap until it decays.
+void slab_pool_release(slab_t* slab) {
+    slab_pool_t* pool = &slab_pool;
+    size_t chunk_index = SLAB_CHUNK_INDEX(slab);
+    char* chunk = (char*) (((size_t) slab) & ~((size_t) LZR_HEAP_CHUNK_SIZE - 1));
+    lzr_mutex_lock(&pool->lock);
+
+    if (--pool->chunk_used[chunk_index] == 0) {
+        for (size_t offset = 0; offset < LZR_HEAP_CHUNK_SIZE; offset += SLAB_SIZE)
+            if ((slab_t*) (chunk + offset) != slab)
+                slab_list_remove(&pool->free, (slab_t*) (chunk + offset));
+        lzr_heap_retain((void*) chunk);
+
+    } else {
+        slab_list_push(&pool->free, slab);
+    }
+
+    lzr_mutex_unlock(&pool->lock);
+}
+
+slab_t* slab_create(slab_cache_t* cache, uint16_t size_class) {
+    slab_t* slab = slab_pool_acquire();
+    slab->free = 0;
+    slab->bump = SLAB_HEADER_SIZE;
+    slab->live = 0;
+    slab->size_class = size_class;
+    slab->object_size = slab_class_size(size_class);
+    atomic_init(&slab->remote_free, 0);
+    atomic_init(&slab->remote_frees, 0);
+    atomic_init(&slab->owner, cache);
+    return slab;
+}
+
+// only called by the owner
+bool slab_is_empty(slab_t* slab) {
+    slab->live -= atomic_exchange_explicit(&slab->remote_frees, 0, memory_order_acquire);
+    return slab->live == 0;
+}
+
+// check if the slab has an object to allocate, taking over the remotely freed objects if need be.
+// only called by the owner
+bool slab_has_free(slab_t* slab) {
+    if (slab->free != 0 || slab->bump + slab->object_size <= SLAB_SIZE)
+        return true;
+    slab->free = atomic_exchange_explicit(&slab->remote_free, 0, memory_order_acquire);
+    slab->live -= atomic_exchange_explicit(&slab->remote_frees, 0, memory_order_acquire);
+    return slab->free != 0;
+}
+
+// the active slab ran out of objects: look through the other owned slabs for one which
+// has some (likely from remote frees) before falling back to a new one from the pool.
+slab_t* slab_refill(slab_cache_t* cache, uint16_t size_class) {
+    slab_t* slab = cache->active[size_class];
+    if (slab != NULL)
+        slab_list_push(&cache->partial[size_class], slab);
+
+    for (uint32_t slab_ptr = cache->partial[size_class]; slab_ptr != 0; slab_ptr = slab->next) {
+        slab = (slab_t*) LZR_PTR_UNZIP(slab_ptr);
+        if (slab_has_free(slab)) {
+            slab_list_remove(&cache->partial[size_class], slab);
+            return cache->active[size_class] = slab;
+        }
+    }
+
+    return cache->active[size_class] = slab_create(cache, size_class);
+}
+
+void* lzr_slab_alloc(size_t size) {
+    assert(size > 0 && size <= LZR_SLAB_MAX_SIZE);
+    uint16_t size_class = slab_size_class(size);
+    slab_cache_t* cache = &slab_cache;
+
+    slab_t* slab = cache->active[size_class];
+    if (slab == NULL || !slab_has_free(slab))
+        slab = slab_refill(cache, size_class);
+
+    void* ptr;
+    if (slab->free != 0) {
+        ptr = LZR_PTR_UNZIP(slab->free);
+        slab->free = SLAB_NEXT(ptr);
+    } else {
+        ptr = (void*) (((char*) slab) + slab->bump);
+        slab->bump += slab->object_size;
+    }
+
+    slab->live++;
+    return ptr;
+}
+
+void lzr_slab_free(void* ptr) {
+    assert((size_t) ptr > LZR_HEAP_BEGIN && (size_t) ptr < LZR_HEAP_END);
+    slab_t* slab = SLAB_OF(ptr);
+    slab_cache_t* cache = &slab_cache;
+
+    // freeing an object from a slab this thread owns
+    if (atomic_load_explicit(&slab->owner, memory_order_relaxed) == cache) {
+        SLAB_NEXT(ptr) = slab->free;
+        slab->free = LZR_PTR_ZIP(ptr);
+        slab->live--;
+
+        // the active slab is kept around even when empty to avoid ping-ponging with the pool
+        if (slab != cache->active[slab->size_class] && slab_is_empty(slab)) {
+            slab_list_remove(&cache->partial[slab->size_class], slab);
+            slab_pool_release(slab);
+        }
+        return;
+    }
+
+    // freeing an object from a slab owned by another thread (or no thread)
+    uint32_t head = atomic_load_explicit(&slab->remote_free, memory_order_relaxed);
+    do {
+        SLAB_NEXT(ptr) = head;
+    } while (!atomic_compare_exchange_weak_explicit(&slab->remote_free, &head, LZR_PTR_ZIP(ptr), memory_order_release, memory_order_relaxed));
+
+    // the free which brings an orphaned slab to empty is the one to release it
+    if (atomic_fetch_add_explicit(&slab->remote_frees, 1, memory_order_acq_rel) + 1 == SLAB_ORPHANED)
+        slab_pool_release(slab);
+}
+
+void slab_orphan(slab_t* slab) {
+    atomic_store_explicit(&slab->owner, NULL, memory_order_relaxed);
+    uint32_t rebase = SLAB_ORPHANED - slab->live;
+    if (atomic_fetch_add_explicit(&slab->remote_frees, rebase, memory_order_acq_rel) + rebase == SLAB_ORPHANED)
+        slab_pool_release(slab);
+}
+
+void lzr_slab_thread_flush() {
+    slab_cache_t* cache = &slab_cache;
+
+    for (uint16_t size_class = 0; size_class < SLAB_CLASSES; size_class++) {
+        while (cache->partial[size_class] != 0) {
+            slab_t* slab = (slab_t*) LZR_PTR_UNZIP(cache->partial[size_class]);
+            slab_list_remove(&cache->partial[size_class], slab);
+            slab_orphan(slab);
+        }
+
+        if (cache->active[size_class] != NULL) {
+            slab_orphan(cache->active[size_class]);
+            cache->active[size_class] = NULL;
+        }
+    }
+}
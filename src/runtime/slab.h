@@ -0,0 +1,24 @@
+#ifndef LZR_SLAB_H
+#define LZR_SLAB_H
+
+#include "os/heap.h"
+
+/*
+Small objects (8b to 32kb) are allocated from slabs carved out of 2mb heap chunks.
+Every object lives inside the lazer heap and is 8-byte aligned so it's always valid
+for LZR_PTR_ZIP. Each thread allocates from its own slabs without any locking and
+frees from other threads go through a lock-free remote free list on the slab.
+Slabs which become empty go back to a shared pool and chunks which have all their
+slabs returned are retained by the heap until they decay.
+*/
+#define LZR_SLAB_MAX_SIZE (32 * 1024)
+
+void* lzr_slab_alloc(size_t size);
+
+void lzr_slab_free(void* ptr);
+
+// give up ownership of the thread's slabs. should be called before a thread exits (before lzr_heap_cache_flush).
+// slabs with live objects are orphaned and released by whichever thread frees their last object.
+void lzr_slab_thread_flush();
+
+#endif // LZR_SLAB_H
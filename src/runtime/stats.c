@@ -0,0 +1,158 @@
+#include "stats.h"
+#include "atom.h"
+#include "os/heap.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+#if defined(LZR_STATS)
+    /*
+    The first STATS_STRIPES threads to count something each get a stripe of counters to themselves
+    which they bump with plain (relaxed) loads and stores. Any threads after that share the last
+    stripe and have to use atomic adds. Reads sum every stripe, so threads never touch each
+    others cache lines on the hot path and stripes outlive the threads which wrote them.
+    */
+    #define STATS_STRIPES 256
+
+    typedef struct {
+        _Alignas(64) uint64_t counters[LZR_STAT_COUNT];
+    } stats_stripe_t;
+
+    static stats_stripe_t stats_stripes[STATS_STRIPES];
+    static uint32_t stats_next_stripe = 0;
+    static _Thread_local stats_stripe_t* stats_stripe = NULL;
+    static _Thread_local bool stats_stripe_shared = false;
+
+    void lzr_stat_add(lzr_stat_t stat, uint64_t value) {
+        stats_stripe_t* stripe = stats_stripe;
+        if (stripe == NULL) {
+            uint32_t index = __atomic_fetch_add(&stats_next_stripe, 1, __ATOMIC_RELAXED);
+            stats_stripe_shared = index >= STATS_STRIPES - 1;
+            stripe = stats_stripe = &stats_stripes[stats_stripe_shared ? STATS_STRIPES - 1 : index];
+        }
+
+        uint64_t* counter = &stripe->counters[stat];
+        if (stats_stripe_shared) {
+            __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+        } else {
+            __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+        }
+    }
+
+    uint64_t lzr_stat_read(lzr_stat_t stat) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < STATS_STRIPES; i++)
+            value += __atomic_load_n(&stats_stripes[i].counters[stat], __ATOMIC_RELAXED);
+        return value;
+    }
+
+#else
+    void lzr_stat_add(lzr_stat_t stat, uint64_t value) {
+        // compiled without LZR_STATS
+    }
+
+    uint64_t lzr_stat_read(lzr_stat_t stat) {
+        return 0;
+    }
+
+#endif
+
+size_t lzr_stat_bucket(uint64_t value) {
+    size_t bucket = 63 - __builtin_clzll(value);
+    return bucket < LZR_STATS_BUCKETS ? bucket : LZR_STATS_BUCKETS - 1;
+}
+
+void lzr_stats_snapshot(lzr_stats_t* stats) {
+    lzr_heap_stats(&stats->heap);
+    lzr_atom_table_stats(&stats->atoms);
+}
+
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t len;
+} dump_t;
+
+void dump_printf(dump_t* self, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t offset = self->len < self->size ? self->len : self->size;
+    int written = vsnprintf(self->buffer + offset, self->size - offset, format, args);
+    va_end(args);
+    if (written > 0)
+        self->len += (size_t) written;
+}
+
+// every field is printed through these so the text and JSON dumps can't drift apart
+void dump_u64(dump_t* self, bool json, const char* name, uint64_t value) {
+    dump_printf(self, json ? "\"%s\":%llu," : "  %-18s %llu\n", name, (unsigned long long) value);
+}
+
+void dump_f64(dump_t* self, bool json, const char* name, double value) {
+    dump_printf(self, json ? "\"%s\":%.4f," : "  %-18s %.4f\n", name, value);
+}
+
+void dump_histogram(dump_t* self, bool json, const char* name, const uint64_t* buckets) {
+    dump_printf(self, json ? "\"%s\":[" : "  %-18s", name);
+    for (size_t i = 0; i < LZR_STATS_BUCKETS; i++)
+        dump_printf(self, (json && i > 0) ? ",%llu" : (json ? "%llu" : " %llu"), (unsigned long long) buckets[i]);
+    dump_printf(self, json ? "]," : "\n");
+}
+
+void dump_lock(dump_t* self, bool json, const lzr_stats_lock_t* lock) {
+    dump_u64(self, json, "lock_acquired", lock->acquired);
+    dump_u64(self, json, "lock_contended", lock->contended);
+    dump_u64(self, json, "lock_parked", lock->parked);
+}
+
+// JSON objects are closed by overwriting the trailing comma of their last field
+void dump_section(dump_t* self, bool json, const char* name, bool begin) {
+    if (begin) {
+        dump_printf(self, json ? "\"%s\":{" : "%s:\n", name);
+    } else if (json) {
+        if (self->len < self->size)
+            self->buffer[self->len - 1] = '}';
+        dump_printf(self, ",");
+    }
+}
+
+size_t lzr_stats_dump(const lzr_stats_t* stats, char* buffer, size_t size, bool json) {
+    dump_t dump = { buffer, size, 0 };
+    if (size > 0)
+        buffer[0] = '\0';
+    if (json)
+        dump_printf(&dump, "{");
+
+    const lzr_stats_heap_t* heap = &stats->heap;
+    dump_section(&dump, json, "heap", true);
+    dump_u64(&dump, json, "committed_bytes", heap->committed_bytes);
+    dump_u64(&dump, json, "top_chunks", heap->top_chunks);
+    dump_u64(&dump, json, "free_chunks", heap->free_chunks);
+    dump_u64(&dump, json, "free_runs", heap->free_runs);
+    dump_u64(&dump, json, "largest_free_run", heap->largest_free_run);
+    dump_u64(&dump, json, "retained_chunks", heap->retained_chunks);
+    dump_f64(&dump, json, "fragmentation", heap->fragmentation);
+    dump_u64(&dump, json, "allocs", heap->allocs);
+    dump_u64(&dump, json, "frees", heap->frees);
+    dump_u64(&dump, json, "cache_hits", heap->cache_hits);
+    dump_lock(&dump, json, &heap->lock);
+    dump_section(&dump, json, "heap", false);
+
+    const lzr_stats_atoms_t* atoms = &stats->atoms;
+    dump_section(&dump, json, "atoms", true);
+    dump_u64(&dump, json, "atoms", atoms->atoms);
+    dump_u64(&dump, json, "cells", atoms->cells);
+    dump_u64(&dump, json, "capacity", atoms->capacity);
+    dump_u64(&dump, json, "heap_bytes", atoms->heap_bytes);
+    dump_f64(&dump, json, "load_factor", atoms->load_factor);
+    dump_u64(&dump, json, "finds", atoms->finds);
+    dump_u64(&dump, json, "inserts", atoms->inserts);
+    dump_histogram(&dump, json, "probe_groups", atoms->probe_groups);
+    dump_histogram(&dump, json, "displacement", atoms->displacement);
+    dump_lock(&dump, json, &atoms->lock);
+    dump_section(&dump, json, "atoms", false);
+
+    // replace the comma after the last section with the closing brace
+    if (json && dump.len < dump.size)
+        buffer[dump.len - 1] = '}';
+    return dump.len;
+}
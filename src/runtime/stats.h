@@ -0,0 +1,33 @@
+#ifndef LZR_STATS_H
+#define LZR_STATS_H
+
+#include "system.h"
+
+// the event counters behind lzr_stats_t, each striped across threads (see stats.c)
+typedef enum {
+    LZR_STAT_MEMORY_COMMIT,
+    LZR_STAT_MEMORY_DECOMMIT,
+    LZR_STAT_HEAP_ALLOC,
+    LZR_STAT_HEAP_FREE,
+    LZR_STAT_HEAP_CACHE_HIT,
+    LZR_STAT_ATOM_FIND,
+    LZR_STAT_ATOM_INSERT,
+    LZR_STAT_ATOM_PROBE,
+    LZR_STAT_COUNT = LZR_STAT_ATOM_PROBE + LZR_STATS_BUCKETS,
+} lzr_stat_t;
+
+#if defined(LZR_STATS)
+    #define LZR_STAT_ADD(stat, value) lzr_stat_add((stat), (value))
+#else
+    #define LZR_STAT_ADD(stat, value) ((void) 0)
+#endif
+
+void lzr_stat_add(lzr_stat_t stat, uint64_t value);
+
+// sum of the counter across all threads. always 0 when compiled without LZR_STATS
+uint64_t lzr_stat_read(lzr_stat_t stat);
+
+// which LZR_STATS_BUCKETS histogram bucket a (non zero) value falls into
+size_t lzr_stat_bucket(uint64_t value);
+
+#endif // LZR_STATS_H
@@ -1,9 +1,6 @@
 #ifndef LZR_SYSTEM_H
 #define LZR_SYSTEM_H
 
-#include <lazer.h>
-#include <assert.h>
-
 #if defined(_WIN32) || defined(__WIN32__) || defined(_WIN64)
     #define LZR_WINDOWS
     #define _WIN32_LEAN_AND_MEAN
@@ -26,4 +23,8 @@
     #error "Architecture not supported"
 #endif
 
+// after the platform detection so _GNU_SOURCE is defined before any libc header
+#include <lazer.h>
+#include <assert.h>
+
 #endif // LZR_SYSTEM_H
\ No newline at end of file
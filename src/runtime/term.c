@@ -0,0 +1,22 @@
+#include "term.h"
+#include <string.h>
+
+lzr_term_t lzr_tuple_new(lzr_arena_t* arena, uint16_t arity) {
+    size_t size = arity * sizeof(lzr_term_t);
+    lzr_object_t* tuple = lzr_arena_alloc(arena, size, arity, LZR_TYPE_TUPLE);
+    if (tuple == NULL)
+        return LZR_NIL;
+
+    memset(lzr_object_body(tuple), 0, size);
+    return lzr_term_from_object(tuple);
+}
+
+lzr_term_t lzr_cons_new(lzr_arena_t* arena, lzr_term_t head, lzr_term_t tail) {
+    lzr_object_t* cons = lzr_arena_alloc(arena, 2 * sizeof(lzr_term_t), 2, LZR_TYPE_CONS);
+    if (cons == NULL)
+        return LZR_NIL;
+
+    lzr_object_fields(cons)[0] = head;
+    lzr_object_fields(cons)[1] = tail;
+    return lzr_term_from_object(cons);
+}
@@ -0,0 +1,68 @@
+#ifndef LZR_TERM_H
+#define LZR_TERM_H
+
+#include "atom.h"
+#include "arena.h"
+
+/*
+Terms are 32 bits. Everything the runtime points to is 16-byte aligned inside the lazer heap
+so a compressed pointer (see LZR_PTR_ZIP) always has its low bit clear, leaving it as the tag:
+
+    xxxxxxxx...xxxxxxx1  small integer (31 bit, signed)
+    00000000...00000000  nil / the empty list
+    pppppppp...ppppppp0  a pointer: to an atom if it's below LZR_ATOM_ZIP_END (the fixed
+                         atom heap), otherwise to an lzr_object_t (tuple, cons cell, ...)
+
+This is also exactly what an arena traces as a reference, so terms can be stored in
+object fields as is. Compared to 64-bit pointer terms, tuples and lists take half the space.
+*/
+typedef uint32_t lzr_term_t;
+
+#define LZR_NIL ((lzr_term_t) 0)
+
+#define LZR_SMALL_MIN (-(1 << 30))
+#define LZR_SMALL_MAX ((1 << 30) - 1)
+
+// object types (lzr_object_t.type) for boxed terms
+#define LZR_TYPE_TUPLE 1
+#define LZR_TYPE_CONS 2
+#define LZR_TYPE_BINARY 3 // see binary.h
+#define LZR_TYPE_MAP 4 // see map.h
+#define LZR_TYPE_MAP_NODE 5
+#define LZR_TYPE_MAP_COLLISION 6
+
+#define lzr_term_is_nil(term) ((term) == LZR_NIL)
+#define lzr_term_is_small(term) (((term) & 1) != 0)
+#define lzr_term_is_atom(term) (((term) & 1) == 0 && (term) != LZR_NIL && (term) < LZR_ATOM_ZIP_END)
+#define lzr_term_is_boxed(term) (((term) & 1) == 0 && (term) >= LZR_ATOM_ZIP_END)
+#define lzr_term_is_type(term, object_type) \
+    (lzr_term_is_boxed(term) && lzr_term_to_object(term)->type == (object_type))
+#define lzr_term_is_tuple(term) lzr_term_is_type(term, LZR_TYPE_TUPLE)
+#define lzr_term_is_cons(term) lzr_term_is_type(term, LZR_TYPE_CONS)
+#define lzr_term_is_binary(term) lzr_term_is_type(term, LZR_TYPE_BINARY)
+#define lzr_term_is_list(term) (lzr_term_is_nil(term) || lzr_term_is_cons(term))
+
+#define lzr_term_from_small(value) ((lzr_term_t) ((((uint32_t) (value)) << 1) | 1))
+#define lzr_term_to_small(term) (((int32_t) (term)) >> 1)
+
+// the built-in atoms' terms are known ahead of time, see LZR_ATOM_* in atom.h
+#define lzr_term_from_atom(atom) ((lzr_term_t) LZR_PTR_ZIP(atom))
+#define lzr_term_to_atom(term) ((lzr_atom_t*) LZR_PTR_UNZIP(term))
+
+#define lzr_term_from_object(object) ((lzr_term_t) LZR_PTR_ZIP(object))
+#define lzr_term_to_object(term) ((lzr_object_t*) LZR_PTR_UNZIP(term))
+
+// tuples are objects where every field is an element
+#define lzr_tuple_arity(term) (lzr_term_to_object(term)->refs)
+#define lzr_tuple_elements(term) ((lzr_term_t*) lzr_object_fields(lzr_term_to_object(term)))
+
+#define lzr_cons_head(term) (lzr_object_fields(lzr_term_to_object(term))[0])
+#define lzr_cons_tail(term) (lzr_object_fields(lzr_term_to_object(term))[1])
+
+// constructors for boxed terms return LZR_NIL when the arena is full (see lzr_arena_alloc).
+// the elements of a new tuple are all nil.
+lzr_term_t lzr_tuple_new(lzr_arena_t* arena, uint16_t arity);
+
+lzr_term_t lzr_cons_new(lzr_arena_t* arena, lzr_term_t head, lzr_term_t tail);
+
+#endif // LZR_TERM_H
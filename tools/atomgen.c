@@ -0,0 +1,158 @@
+#include "runtime/hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Generates lazer_atoms.h from src/runtime/atoms.def at build time.
+
+atom_heap_init() places the built-in atoms first thing in the atom heap in the order they're
+listed, so their addresses (and thus their compressed pointers and terms) are known here
+and can be emitted as constants. This has to mirror atom_heap_alloc(): the first atom comes
+after ATOM_ALIGN bytes of padding and each takes up its header, a length byte and its text,
+rounded up to ATOM_ALIGN. atom_heap_init() checks that the addresses match.
+
+To skip the atom table when looking them up by name, it also searches for a multiplier which
+perfectly hashes the atoms' lzr_hash_bytes() into a table at most half full.
+*/
+#define ATOM_ALIGN 16
+#define ATOM_HEADER_SIZE 12
+#define ALIGN(value, alignment) ((((value) + (alignment) - 1) / (alignment)) * (alignment))
+
+#define MAX_SEED_ATTEMPTS (1 << 20)
+
+typedef struct {
+    const char* name;
+    const char* text;
+    uint32_t hash;
+    uint32_t ptr;
+} builtin_t;
+
+static builtin_t builtins[] = {
+    #define LZR_BUILTIN_ATOM(name, text) { #name, text, 0, 0 },
+    #include "runtime/atoms.def"
+    #undef LZR_BUILTIN_ATOM
+};
+
+#define NUM_BUILTINS (sizeof(builtins) / sizeof(builtins[0]))
+
+// xorshift for the candidate seeds so the output is the same every build
+uint32_t next_seed(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x | 1;
+}
+
+bool seed_is_perfect(uint32_t seed, uint32_t shift, uint8_t* used, size_t slots) {
+    memset(used, 0, slots);
+    for (size_t i = 0; i < NUM_BUILTINS; i++) {
+        size_t slot = (uint32_t) (builtins[i].hash * seed) >> shift;
+        if (used[slot]++)
+            return false;
+    }
+    return true;
+}
+
+// returns 0 if none of the candidates work for a table of 2^(32 - shift) slots
+uint32_t find_seed(uint32_t shift) {
+    size_t slots = 1ULL << (32 - shift);
+    uint8_t* used = (uint8_t*) malloc(slots);
+    uint32_t state = 0x2545f491u;
+    uint32_t seed = 0;
+    for (size_t attempt = 0; attempt < MAX_SEED_ATTEMPTS && seed == 0; attempt++) {
+        uint32_t candidate = next_seed(&state);
+        if (seed_is_perfect(candidate, shift, used, slots))
+            seed = candidate;
+    }
+    free(used);
+    return seed;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <lazer_atoms.h>\n", argv[0]);
+        return 1;
+    }
+
+    // the heap offsets and hashes, checking for duplicates which would get the same address
+    size_t offset = ATOM_ALIGN;
+    uint32_t check = 0;
+    for (size_t i = 0; i < NUM_BUILTINS; i++) {
+        size_t len = strlen(builtins[i].text);
+        if (len == 0 || len > 255) {
+            fprintf(stderr, "atomgen: bad length for built-in atom %s\n", builtins[i].name);
+            return 1;
+        }
+        for (size_t j = 0; j < i; j++) {
+            if (strcmp(builtins[i].text, builtins[j].text) == 0 || strcmp(builtins[i].name, builtins[j].name) == 0) {
+                fprintf(stderr, "atomgen: duplicate built-in atom %s\n", builtins[i].name);
+                return 1;
+            }
+        }
+
+        builtins[i].hash = lzr_hash_bytes(builtins[i].text, len);
+        builtins[i].ptr = (uint32_t) (offset >> 3);
+        offset += ALIGN(ATOM_HEADER_SIZE + 1 + len, ATOM_ALIGN);
+        check = (check ^ builtins[i].hash) * 0x9e3779b1u;
+    }
+
+    // grow the table if no multiplier turns up, though at half full one is found within a few tries
+    uint32_t shift = 32;
+    while ((1ULL << (32 - shift)) < NUM_BUILTINS * 2)
+        shift--;
+
+    uint32_t seed = 0;
+    while (seed == 0 && shift > 16)
+        if ((seed = find_seed(shift)) == 0)
+            shift--;
+    if (seed == 0) {
+        fprintf(stderr, "atomgen: no perfect hash found for the built-in atoms\n");
+        return 1;
+    }
+
+    size_t num_slots = 1ULL << (32 - shift);
+    builtin_t** table = (builtin_t**) calloc(num_slots, sizeof(builtin_t*));
+    for (size_t i = 0; i < NUM_BUILTINS; i++)
+        table[(uint32_t) (builtins[i].hash * seed) >> shift] = &builtins[i];
+
+    FILE* out = fopen(argv[1], "w");
+    if (out == NULL) {
+        fprintf(stderr, "atomgen: couldn't open %s\n", argv[1]);
+        return 1;
+    }
+
+    fprintf(out, "// generated by tools/atomgen.c from src/runtime/atoms.def, don't edit\n");
+    fprintf(out, "#ifndef LAZER_ATOMS_H\n#define LAZER_ATOMS_H\n\n");
+    fprintf(out, "#define LZR_ATOM_BUILTIN_COUNT %zu\n", NUM_BUILTINS);
+    fprintf(out, "#define LZR_ATOM_BUILTIN_HEADER_SIZE %d\n", ATOM_HEADER_SIZE);
+    fprintf(out, "#define LZR_ATOM_BUILTIN_ALIGN %d\n", ATOM_ALIGN);
+    fprintf(out, "#define LZR_ATOM_BUILTIN_HEAP_BYTES %zu\n", offset);
+    fprintf(out, "#define LZR_ATOM_BUILTIN_CHECK 0x%08xu\n", check);
+    fprintf(out, "#define LZR_ATOM_BUILTIN_SEED 0x%08xu\n", seed);
+    fprintf(out, "#define LZR_ATOM_BUILTIN_SHIFT %u\n", shift);
+    fprintf(out, "#define LZR_ATOM_BUILTIN_SLOTS %zu\n\n", num_slots);
+
+    for (size_t i = 0; i < NUM_BUILTINS; i++)
+        fprintf(out, "#define LZR_ATOM_%s 0x%xu // %s\n", builtins[i].name, builtins[i].ptr, builtins[i].text);
+
+    fprintf(out, "\n// X(name, text, hash) in heap order\n#define LZR_ATOM_BUILTINS(X)");
+    for (size_t i = 0; i < NUM_BUILTINS; i++)
+        fprintf(out, " \\\n    X(%s, \"%s\", 0x%08xu)", builtins[i].name, builtins[i].text, builtins[i].hash);
+
+    fprintf(out, "\n\n// { hash, compressed pointer } indexed by (hash * SEED) >> SHIFT, empty slots are zero\n");
+    fprintf(out, "#define LZR_ATOM_BUILTIN_TABLE");
+    for (size_t slot = 0; slot < num_slots; slot++) {
+        if (table[slot] != NULL)
+            fprintf(out, " \\\n    { 0x%08xu, LZR_ATOM_%s },", table[slot]->hash, table[slot]->name);
+        else
+            fprintf(out, " \\\n    { 0, 0 },");
+    }
+
+    fprintf(out, "\n\n#endif // LAZER_ATOMS_H\n");
+    fclose(out);
+    free(table);
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "runtime/etf.h"
+#include "runtime/os/heap.h"
+#include "runtime/os/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Replays a captured byte stream of the external term format (like the payloads of a
+distribution connection, one after another) through a single lzr_etf_decoder_t.
+
+The stream is fed in pieces of `chunk` bytes, or of random sizes when it's 0 so that terms,
+headers and atoms get split everywhere across runs. With -p every decoded term is printed
+so captures can be diffed against what the sending node encoded. Exits with 1 and the offset
+where it failed if the stream doesn't decode.
+*/
+#define REPLAY_MAX_ATOMS (1 << 20)
+#define REPLAY_MAX_CHUNK 4096
+
+static lzr_atom_table_t replay_atoms;
+
+uint64_t replay_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+void replay_print(lzr_term_t term) {
+    if (lzr_term_is_nil(term)) {
+        printf("[]");
+    } else if (lzr_term_is_small(term)) {
+        printf("%d", lzr_term_to_small(term));
+    } else if (lzr_term_is_atom(term)) {
+        lzr_atom_t* atom = lzr_term_to_atom(term);
+        printf("'%.*s'", (int) lzr_atom_len(atom), lzr_atom_text_ptr(atom));
+    } else if (lzr_term_is_tuple(term)) {
+        printf("{");
+        for (uint32_t i = 0; i < lzr_tuple_arity(term); i++) {
+            if (i > 0)
+                printf(",");
+            replay_print(lzr_tuple_elements(term)[i]);
+        }
+        printf("}");
+    } else if (lzr_term_is_cons(term)) {
+        printf("[");
+        for (; lzr_term_is_cons(term); term = lzr_cons_tail(term)) {
+            replay_print(lzr_cons_head(term));
+            if (lzr_term_is_cons(lzr_cons_tail(term)))
+                printf(",");
+        }
+        if (!lzr_term_is_nil(term)) {
+            printf("|");
+            replay_print(term);
+        }
+        printf("]");
+    } else if (lzr_term_is_binary(term)) {
+        printf("<<%u bytes>>", lzr_binary_term_size(term));
+    } else if (lzr_term_is_map(term)) {
+        printf("#{%zu keys}", lzr_map_size(term));
+    } else {
+        printf("?");
+    }
+}
+
+int main(int argc, char** argv) {
+    bool print = argc > 1 && strcmp(argv[1], "-p") == 0;
+    if (argc < 2 + print || argc > 3 + print) {
+        fprintf(stderr, "usage: %s [-p] <capture> [chunk]\n", argv[0]);
+        return 1;
+    }
+    size_t chunk = argc == 3 + print ? (size_t) atoi(argv[2 + print]) : 0;
+
+    FILE* file = fopen(argv[1 + print], "rb");
+    if (file == NULL) {
+        fprintf(stderr, "etfreplay: can't open %s\n", argv[1 + print]);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    size_t len = (size_t) ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* bytes = (uint8_t*) malloc(len);
+    size_t read = fread(bytes, 1, len, file);
+    fclose(file);
+    assert(read == len);
+    (void) read;
+
+    lzr_heap_init();
+    lzr_atom_table_init(&replay_atoms, REPLAY_MAX_ATOMS);
+    lzr_heap_commit();
+
+    lzr_arena_t arena;
+    lzr_arena_init(&arena);
+    lzr_etf_decoder_t* decoder = (lzr_etf_decoder_t*) malloc(sizeof(lzr_etf_decoder_t));
+    lzr_etf_decoder_init(decoder, &replay_atoms, &arena);
+
+    uint64_t seed = 0x2545f4914f6cdd1dULL;
+    size_t terms = 0;
+    size_t at = 0;
+    int status = LZR_ETF_MORE;
+    uint64_t start = lzr_time_now();
+
+    while (at < len) {
+        size_t piece = chunk > 0 ? chunk : 1 + replay_random(&seed) % REPLAY_MAX_CHUNK;
+        size_t end = len - at < piece ? len : at + piece;
+        while (at < end) {
+            size_t consumed;
+            lzr_term_t term;
+            status = lzr_etf_decode(decoder, bytes + at, end - at, &consumed, &term);
+            at += consumed;
+
+            if (status == LZR_ETF_ERROR) {
+                fprintf(stderr, "etfreplay: bad term before offset %zu\n", at);
+                return 1;
+            } else if (status == LZR_ETF_FULL) {
+                uint32_t* roots[LZR_ETF_MAX_ROOTS];
+                size_t num_roots = lzr_etf_roots(decoder, roots);
+                if (!lzr_arena_collect(&arena, roots, num_roots, decoder->reserve)) {
+                    fprintf(stderr, "etfreplay: out of memory before offset %zu\n", at);
+                    return 1;
+                }
+            } else if (status == LZR_ETF_TERM) {
+                terms++;
+                if (print) {
+                    replay_print(term);
+                    printf("\n");
+                }
+            }
+        }
+    }
+
+    double elapsed = (double) (lzr_time_now() - start);
+    if (status != LZR_ETF_TERM && len > 0) {
+        fprintf(stderr, "etfreplay: stream ends in the middle of a term\n");
+        return 1;
+    }
+
+    fprintf(stderr, "%zu terms in %zu bytes, %.2f mb/s, %u collections\n",
+        terms, len, ((double) len / (1024.0 * 1024.0)) * 1e9 / elapsed, arena.collections);
+    lzr_etf_decoder_destroy(decoder);
+    lzr_arena_destroy(&arena);
+    free(decoder);
+    free(bytes);
+    return 0;
+}